@@ -55,6 +55,22 @@ void AES_init_ctx_iv(struct AES_ctx* ctx, const uint8_t* key, const uint8_t* iv)
 void AES_ctx_set_iv(struct AES_ctx* ctx, const uint8_t* iv);
 #endif
 
+// Encrypt/decrypt exactly one AES_BLOCKLEN block in place.
+// These are the raw building blocks the parallel and batch kernels are made of:
+// unlike AES_ECB_encrypt()/AES_ECB_decrypt() they do no statistics or tracing
+// and are available whatever modes are enabled (decryption needs CBC or ECB).
+void AES_block_encrypt(const struct AES_ctx* ctx, uint8_t* buf);
+#if (defined(CBC) && (CBC == 1)) || (defined(ECB) && (ECB == 1))
+void AES_block_decrypt(const struct AES_ctx* ctx, uint8_t* buf);
+#endif
+
+// One encryption round on a block in place, for constructions built from AES
+// rounds rather than the whole cipher: SubBytes, ShiftRows, MixColumns, then
+// XOR with the 16-byte round_key (the AESENC step). The last-round form leaves
+// out MixColumns (AESENCLAST).
+void AES_block_round(uint8_t* buf, const uint8_t* round_key);
+void AES_block_last_round(uint8_t* buf, const uint8_t* round_key);
+
 #if defined(ECB) && (ECB == 1)
 // buffer size is exactly AES_BLOCKLEN bytes; 
 // you need only AES_init_ctx as IV is not used in ECB 
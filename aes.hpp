@@ -7,6 +7,1768 @@
 
 extern "C" {
 #include "aes.h"
+#include "aes_stats.h"
+#include "aes_trace.h"
+#include "aes_backend.h"
+#include "aes_batch.h"
+#include "aes_drbg.h"
+#include "aes_rng.h"
+#include "aes_hash.h"
+#include "aes_fused.h"
+#include "aes_gcm.h"
+#include "aes_stream.h"
+#include "aes_mac.h"
+#include "aes_kw.h"
 }
 
+// Header-only C++ layer (C++17 and later).
+//
+// The C API above is fixed to the one key size aes.h was compiled with. The
+// templates below carry the key size in the type instead, so Aes<128>, Aes<192>
+// and Aes<256> (and the modes built on them) can be used side by side in one
+// program. Round counts are compile-time constants and the round loop is
+// expanded at compile time, so there is no per-call dispatch on the key size.
+// They share the lookup tables with aes.c (aes_tables.h) and produce the same
+// output as the C functions for the same key size.
+#if (__cplusplus >= 201703L) || (defined(_MSVC_LANG) && (_MSVC_LANG >= 201703L))
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <streambuf>
+#include <type_traits>
+#include <utility>
+
+#if (__cplusplus >= 202002L) && __has_include(<span>)
+  #include <concepts>
+  #include <ranges>
+  #include <span>
+  #define AES_HPP_RANGES 1
+#else
+  #define AES_HPP_RANGES 0
+#endif
+
+#if AES_HPP_RANGES && __has_include(<coroutine>) && defined(__cpp_impl_coroutine)
+  #include <condition_variable>
+  #include <coroutine>
+  #include <deque>
+  #include <functional>
+  #include <mutex>
+  #include <thread>
+  #include <vector>
+  #define AES_HPP_COROUTINES 1
+#else
+  #define AES_HPP_COROUTINES 0
+#endif
+
+#if AES_HPP_COROUTINES && __has_include(<unistd.h>)
+  #include <cerrno>
+  #include <sys/types.h>
+  #include <unistd.h>
+  #define AES_HPP_FD_IO 1
+#else
+  #define AES_HPP_FD_IO 0
+#endif
+
+#include "aes_tables.h"
+
+// With C++20 the block cipher, the key expansion and the ECB/CBC/CTR classes
+// are constexpr, so constants can be encrypted by the compiler, e.g.
+//
+//   constexpr auto blob = tiny_aes::ctr_encrypt_constant(key, iv, plaintext);
+//
+// puts only the ciphertext in the binary. At run time the same code takes the
+// usual memcpy/word-wise paths.
+#if (__cplusplus >= 202002L) && defined(__cpp_lib_is_constant_evaluated)
+  #define AES_HPP_CONSTEXPR constexpr
+  #define AES_HPP_CONSTANT_EVALUATED() std::is_constant_evaluated()
+#else
+  #define AES_HPP_CONSTEXPR inline
+  #define AES_HPP_CONSTANT_EVALUATED() false
+#endif
+
+// #define AES_HPP_OPENMP to 1 when the program links aes_openmp.o (with
+// -fopenmp). The range overloads for struct AES_ctx then hand CTR buffers of
+// AES_HPP_PARALLEL_MIN bytes or more to AES_CTR_xcrypt_buffer_openmp();
+// below that the cost of starting the parallel region outweighs the gain.
+#ifndef AES_HPP_OPENMP
+  #define AES_HPP_OPENMP 0
+#endif
+
+#ifndef AES_HPP_PARALLEL_MIN
+  #define AES_HPP_PARALLEL_MIN (64 * 1024)
+#endif
+
+#if AES_HPP_OPENMP
+extern "C" {
+#include "aes_openmp.h"
+}
+#endif
+
+// #define AES_HPP_PARALLEL_STL to 1 for parallel ECB, CBC decryption and CTR
+// on a struct AES_ctx through the standard parallel algorithms
+// (std::execution::par_unseq and friends), for builds without OpenMP. With
+// libstdc++ these run on TBB, so link with -ltbb. Each task covers
+// AES_HPP_PARALLEL_STL_CHUNK blocks.
+#ifndef AES_HPP_PARALLEL_STL
+  #define AES_HPP_PARALLEL_STL 0
+#endif
+
+#ifndef AES_HPP_PARALLEL_STL_CHUNK
+  #define AES_HPP_PARALLEL_STL_CHUNK 4096
+#endif
+
+#if AES_HPP_PARALLEL_STL
+  #include <execution>
+  #include <iterator>
+  #include <vector>
+#endif
+
+namespace tiny_aes
+{
+
+// Where the classes that allocate (stream buffers, views, scratch space) get
+// their memory from. Defaults to std::pmr::get_default_resource(); pass a
+// request's monotonic or pool resource to keep its allocations in the arena.
+// Aes, Ecb, Cbc, Ctr and CtrContext never allocate.
+using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+namespace detail
+{
+
+// Calls f(integral_constant<0>), f(integral_constant<1>), ... as straight-line code
+template <typename F, std::size_t... I>
+AES_HPP_CONSTEXPR void unroll(F&& f, std::index_sequence<I...>)
+{
+  (f(std::integral_constant<std::size_t, I>()), ...);
+}
+
+AES_HPP_CONSTEXPR uint8_t xtime(uint8_t x)
+{
+  return (uint8_t)((x << 1) ^ (((x >> 7) & 1) * 0x1b));
+}
+
+AES_HPP_CONSTEXPR uint8_t multiply(uint8_t x, uint8_t y)
+{
+  return (uint8_t)(((y & 1) * x) ^
+                   ((y >> 1 & 1) * xtime(x)) ^
+                   ((y >> 2 & 1) * xtime(xtime(x))) ^
+                   ((y >> 3 & 1) * xtime(xtime(xtime(x)))));
+}
+
+AES_HPP_CONSTEXPR void copy_bytes(uint8_t* dst, const uint8_t* src, std::size_t length)
+{
+  if (AES_HPP_CONSTANT_EVALUATED())
+  {
+    for (std::size_t i = 0; i < length; ++i)
+    {
+      dst[i] = src[i];
+    }
+  }
+  else
+  {
+    std::memcpy(dst, src, length);
+  }
+}
+
+// The state is 16 bytes in input order, i.e. column c, row r is s[4 * c + r],
+// the same layout aes.c uses through state_t.
+AES_HPP_CONSTEXPR void add_round_key(uint8_t* s, const uint8_t* round_key)
+{
+  for (std::size_t i = 0; i < AES_BLOCKLEN; ++i)
+  {
+    s[i] ^= round_key[i];
+  }
+}
+
+// SubBytes and ShiftRows in one pass
+AES_HPP_CONSTEXPR void sub_shift_rows(uint8_t* s)
+{
+  uint8_t t[AES_BLOCKLEN];
+  for (std::size_t c = 0; c < 4; ++c)
+  {
+    for (std::size_t r = 0; r < 4; ++r)
+    {
+      t[4 * c + r] = aes_sbox[s[4 * ((c + r) & 3) + r]];
+    }
+  }
+  copy_bytes(s, t, AES_BLOCKLEN);
+}
+
+AES_HPP_CONSTEXPR void inv_shift_sub_rows(uint8_t* s)
+{
+  uint8_t t[AES_BLOCKLEN];
+  for (std::size_t c = 0; c < 4; ++c)
+  {
+    for (std::size_t r = 0; r < 4; ++r)
+    {
+      t[4 * ((c + r) & 3) + r] = aes_rsbox[s[4 * c + r]];
+    }
+  }
+  copy_bytes(s, t, AES_BLOCKLEN);
+}
+
+AES_HPP_CONSTEXPR void mix_columns(uint8_t* s)
+{
+  for (std::size_t c = 0; c < 4; ++c)
+  {
+    uint8_t* col = s + 4 * c;
+    const uint8_t t = col[0];
+    const uint8_t all = (uint8_t)(col[0] ^ col[1] ^ col[2] ^ col[3]);
+    col[0] ^= (uint8_t)(xtime((uint8_t)(col[0] ^ col[1])) ^ all);
+    col[1] ^= (uint8_t)(xtime((uint8_t)(col[1] ^ col[2])) ^ all);
+    col[2] ^= (uint8_t)(xtime((uint8_t)(col[2] ^ col[3])) ^ all);
+    col[3] ^= (uint8_t)(xtime((uint8_t)(col[3] ^ t)) ^ all);
+  }
+}
+
+AES_HPP_CONSTEXPR void inv_mix_columns(uint8_t* s)
+{
+  for (std::size_t c = 0; c < 4; ++c)
+  {
+    uint8_t* col = s + 4 * c;
+    const uint8_t a = col[0], b = col[1], d = col[2], e = col[3];
+    col[0] = (uint8_t)(multiply(a, 0x0e) ^ multiply(b, 0x0b) ^ multiply(d, 0x0d) ^ multiply(e, 0x09));
+    col[1] = (uint8_t)(multiply(a, 0x09) ^ multiply(b, 0x0e) ^ multiply(d, 0x0b) ^ multiply(e, 0x0d));
+    col[2] = (uint8_t)(multiply(a, 0x0d) ^ multiply(b, 0x09) ^ multiply(d, 0x0e) ^ multiply(e, 0x0b));
+    col[3] = (uint8_t)(multiply(a, 0x0b) ^ multiply(b, 0x0d) ^ multiply(d, 0x09) ^ multiply(e, 0x0e));
+  }
+}
+
+// out = in ^ key over length bytes; out may be the same buffer as in
+AES_HPP_CONSTEXPR void xor_bytes(uint8_t* out, const uint8_t* in, const uint8_t* key, std::size_t length)
+{
+  std::size_t i = 0;
+  for (; !AES_HPP_CONSTANT_EVALUATED() && i + sizeof(uint64_t) <= length; i += sizeof(uint64_t))
+  {
+    uint64_t a, b;
+    std::memcpy(&a, in + i, sizeof(a));
+    std::memcpy(&b, key + i, sizeof(b));
+    a ^= b;
+    std::memcpy(out + i, &a, sizeof(a));
+  }
+  for (; i < length; ++i)
+  {
+    out[i] = (uint8_t)(in[i] ^ key[i]);
+  }
+}
+
+AES_HPP_CONSTEXPR void xor_bytes(uint8_t* dst, const uint8_t* src, std::size_t length)
+{
+  xor_bytes(dst, dst, src, length);
+}
+
+// Adds one to a 16-byte big-endian counter
+AES_HPP_CONSTEXPR void increment_counter(uint8_t* counter)
+{
+  for (int i = AES_BLOCKLEN - 1; i >= 0; --i)
+  {
+    if (++counter[i] != 0)
+    {
+      break;
+    }
+  }
+}
+
+// Adds n to a 16-byte big-endian counter
+AES_HPP_CONSTEXPR void add_counter(uint8_t* counter, uint64_t n)
+{
+  unsigned carry = 0;
+  for (int i = AES_BLOCKLEN - 1; i >= 0; --i)
+  {
+    const unsigned sum = counter[i] + (unsigned)(n & 0xff) + carry;
+    counter[i] = (uint8_t)sum;
+    carry = sum >> 8;
+    n >>= 8;
+  }
+}
+
+// Counter blocks encrypted per block-kernel call in the CTR loops
+constexpr std::size_t tile_blocks = 8;
+
+} // namespace detail
+
+
+#if AES_HPP_RANGES
+// With C++20 every buffer argument can also be given as a contiguous range of
+// bytes - std::vector<uint8_t>, std::array<std::byte, N>, std::span, a
+// std::string - which is used in place, without a copy.
+namespace detail
+{
+template <typename T>
+concept byte_like = std::same_as<std::remove_cv_t<T>, unsigned char> ||
+                    std::same_as<std::remove_cv_t<T>, char> ||
+                    std::same_as<std::remove_cv_t<T>, std::byte>;
+} // namespace detail
+
+template <typename R>
+concept byte_range = std::ranges::contiguous_range<R> && std::ranges::sized_range<R> &&
+                     detail::byte_like<std::ranges::range_value_t<R>>;
+
+template <typename R>
+concept writable_byte_range = byte_range<R> &&
+                              !std::is_const_v<std::remove_reference_t<std::ranges::range_reference_t<R>>>;
+
+namespace detail
+{
+template <byte_range R>
+inline const uint8_t* bytes_of(R& r) noexcept
+{
+  return reinterpret_cast<const uint8_t*>(std::ranges::data(r));
+}
+
+template <writable_byte_range R>
+inline uint8_t* writable_bytes_of(R& r) noexcept
+{
+  return reinterpret_cast<uint8_t*>(std::ranges::data(r));
+}
+} // namespace detail
+#endif // AES_HPP_RANGES
+
+
+// An expanded AES key. KeyBits is 128, 192 or 256.
+template <unsigned KeyBits>
+class Aes
+{
+  static_assert(KeyBits == 128 || KeyBits == 192 || KeyBits == 256, "AES key size must be 128, 192 or 256 bits");
+
+public:
+  static constexpr unsigned key_bits = KeyBits;
+  static constexpr std::size_t key_size = KeyBits / 8;
+  static constexpr std::size_t block_size = AES_BLOCKLEN;
+  static constexpr unsigned rounds = (KeyBits / 32) + 6;
+  static constexpr std::size_t schedule_size = block_size * (rounds + 1);
+
+  using key_type = std::array<uint8_t, key_size>;
+
+  AES_HPP_CONSTEXPR Aes() noexcept = default;
+  explicit AES_HPP_CONSTEXPR Aes(const uint8_t* key) noexcept { rekey(key); }
+  explicit AES_HPP_CONSTEXPR Aes(const key_type& key) noexcept { rekey(key.data()); }
+
+  AES_HPP_CONSTEXPR void rekey(const uint8_t* key) noexcept;
+
+  // One block in place
+  AES_HPP_CONSTEXPR void encrypt_block(uint8_t* block) const noexcept;
+  AES_HPP_CONSTEXPR void decrypt_block(uint8_t* block) const noexcept;
+
+  // nblocks independent blocks in place
+  AES_HPP_CONSTEXPR void encrypt_blocks(uint8_t* blocks, std::size_t nblocks) const noexcept
+  {
+    for (std::size_t i = 0; i < nblocks; ++i)
+    {
+      encrypt_block(blocks + i * block_size);
+    }
+  }
+
+  // The key schedule, laid out like struct AES_ctx::RoundKey
+  AES_HPP_CONSTEXPR const uint8_t* round_keys() const noexcept { return round_keys_; }
+
+private:
+  static constexpr unsigned Nk = KeyBits / 32;
+
+  uint8_t round_keys_[schedule_size] = {};
+};
+
+template <unsigned KeyBits>
+AES_HPP_CONSTEXPR void Aes<KeyBits>::rekey(const uint8_t* key) noexcept
+{
+  detail::copy_bytes(round_keys_, key, key_size);
+
+  for (unsigned i = Nk; i < 4 * (rounds + 1); ++i)
+  {
+    uint8_t t[4];
+    detail::copy_bytes(t, round_keys_ + 4 * (i - 1), 4);
+
+    if (i % Nk == 0)
+    {
+      // RotWord, SubWord and Rcon
+      const uint8_t u = t[0];
+      t[0] = (uint8_t)(aes_sbox[t[1]] ^ aes_rcon[i / Nk]);
+      t[1] = aes_sbox[t[2]];
+      t[2] = aes_sbox[t[3]];
+      t[3] = aes_sbox[u];
+    }
+    else if constexpr (Nk == 8)
+    {
+      if (i % Nk == 4)
+      {
+        for (uint8_t& b : t)
+        {
+          b = aes_sbox[b];
+        }
+      }
+    }
+
+    for (unsigned j = 0; j < 4; ++j)
+    {
+      round_keys_[4 * i + j] = (uint8_t)(round_keys_[4 * (i - Nk) + j] ^ t[j]);
+    }
+  }
+}
+
+template <unsigned KeyBits>
+AES_HPP_CONSTEXPR void Aes<KeyBits>::encrypt_block(uint8_t* block) const noexcept
+{
+  detail::add_round_key(block, round_keys_);
+  detail::unroll([&](auto round) {
+    detail::sub_shift_rows(block);
+    detail::mix_columns(block);
+    detail::add_round_key(block, round_keys_ + block_size * (round + 1));
+  }, std::make_index_sequence<rounds - 1>());
+  detail::sub_shift_rows(block);
+  detail::add_round_key(block, round_keys_ + block_size * rounds);
+}
+
+template <unsigned KeyBits>
+AES_HPP_CONSTEXPR void Aes<KeyBits>::decrypt_block(uint8_t* block) const noexcept
+{
+  detail::add_round_key(block, round_keys_ + block_size * rounds);
+  detail::unroll([&](auto step) {
+    detail::inv_shift_sub_rows(block);
+    detail::add_round_key(block, round_keys_ + block_size * (rounds - 1 - step));
+    detail::inv_mix_columns(block);
+  }, std::make_index_sequence<rounds - 1>());
+  detail::inv_shift_sub_rows(block);
+  detail::add_round_key(block, round_keys_);
+}
+
+
+// ECB: independent blocks. length must be a multiple of the block size.
+// NB: ECB is considered insecure for most uses
+template <unsigned KeyBits>
+class Ecb
+{
+public:
+  using cipher_type = Aes<KeyBits>;
+
+  explicit AES_HPP_CONSTEXPR Ecb(const uint8_t* key) noexcept : cipher_(key) {}
+  explicit AES_HPP_CONSTEXPR Ecb(const cipher_type& cipher) noexcept : cipher_(cipher) {}
+
+  AES_HPP_CONSTEXPR void encrypt(uint8_t* buf, std::size_t length) const noexcept
+  {
+    cipher_.encrypt_blocks(buf, length / AES_BLOCKLEN);
+  }
+
+  AES_HPP_CONSTEXPR void decrypt(uint8_t* buf, std::size_t length) const noexcept
+  {
+    for (std::size_t i = 0; i + AES_BLOCKLEN <= length; i += AES_BLOCKLEN)
+    {
+      cipher_.decrypt_block(buf + i);
+    }
+  }
+
+#if AES_HPP_RANGES
+  template <writable_byte_range R>
+  void encrypt(R&& buf) const noexcept { encrypt(detail::writable_bytes_of(buf), std::ranges::size(buf)); }
+
+  template <writable_byte_range R>
+  void decrypt(R&& buf) const noexcept { decrypt(detail::writable_bytes_of(buf), std::ranges::size(buf)); }
+#endif
+
+  AES_HPP_CONSTEXPR const cipher_type& cipher() const noexcept { return cipher_; }
+
+private:
+  cipher_type cipher_;
+};
+
+
+// CBC: length must be a multiple of the block size. Like the C API the IV
+// carries over, so consecutive calls continue one chain.
+template <unsigned KeyBits>
+class Cbc
+{
+public:
+  using cipher_type = Aes<KeyBits>;
+
+  AES_HPP_CONSTEXPR Cbc(const uint8_t* key, const uint8_t* iv) noexcept : cipher_(key) { set_iv(iv); }
+  AES_HPP_CONSTEXPR Cbc(const cipher_type& cipher, const uint8_t* iv) noexcept : cipher_(cipher) { set_iv(iv); }
+
+  AES_HPP_CONSTEXPR void set_iv(const uint8_t* iv) noexcept { detail::copy_bytes(iv_, iv, AES_BLOCKLEN); }
+  AES_HPP_CONSTEXPR const uint8_t* iv() const noexcept { return iv_; }
+
+  AES_HPP_CONSTEXPR void encrypt(uint8_t* buf, std::size_t length) noexcept
+  {
+    for (std::size_t i = 0; i + AES_BLOCKLEN <= length; i += AES_BLOCKLEN)
+    {
+      detail::xor_bytes(buf + i, iv_, AES_BLOCKLEN);
+      cipher_.encrypt_block(buf + i);
+      detail::copy_bytes(iv_, buf + i, AES_BLOCKLEN);
+    }
+  }
+
+  AES_HPP_CONSTEXPR void decrypt(uint8_t* buf, std::size_t length) noexcept
+  {
+    uint8_t next_iv[AES_BLOCKLEN];
+    for (std::size_t i = 0; i + AES_BLOCKLEN <= length; i += AES_BLOCKLEN)
+    {
+      detail::copy_bytes(next_iv, buf + i, AES_BLOCKLEN);
+      cipher_.decrypt_block(buf + i);
+      detail::xor_bytes(buf + i, iv_, AES_BLOCKLEN);
+      detail::copy_bytes(iv_, next_iv, AES_BLOCKLEN);
+    }
+  }
+
+#if AES_HPP_RANGES
+  template <writable_byte_range R>
+  void encrypt(R&& buf) noexcept { encrypt(detail::writable_bytes_of(buf), std::ranges::size(buf)); }
+
+  template <writable_byte_range R>
+  void decrypt(R&& buf) noexcept { decrypt(detail::writable_bytes_of(buf), std::ranges::size(buf)); }
+#endif
+
+  AES_HPP_CONSTEXPR const cipher_type& cipher() const noexcept { return cipher_; }
+
+private:
+  cipher_type cipher_;
+  uint8_t iv_[AES_BLOCKLEN] = {};
+};
+
+
+// CTR: the same function encrypts and decrypts. Full blocks are processed in
+// tiles of tile_blocks counters per encrypt_blocks() call.
+//
+// A single call gives the same output as AES_CTR_xcrypt_buffer(). Unlike the
+// C function, an unused tail of the last keystream block is kept for the next
+// call, so splitting a message over several calls at any byte boundary gives
+// the same result as one call.
+template <unsigned KeyBits>
+class Ctr
+{
+public:
+  using cipher_type = Aes<KeyBits>;
+  static constexpr std::size_t tile_blocks = detail::tile_blocks;
+
+  AES_HPP_CONSTEXPR Ctr(const uint8_t* key, const uint8_t* iv) noexcept : cipher_(key) { set_iv(iv); }
+  AES_HPP_CONSTEXPR Ctr(const cipher_type& cipher, const uint8_t* iv) noexcept : cipher_(cipher) { set_iv(iv); }
+
+  // Restart the keystream at a new counter block
+  AES_HPP_CONSTEXPR void set_iv(const uint8_t* iv) noexcept
+  {
+    detail::copy_bytes(counter_, iv, AES_BLOCKLEN);
+    used_ = AES_BLOCKLEN;
+  }
+
+  // The next counter block that will be encrypted
+  AES_HPP_CONSTEXPR const uint8_t* iv() const noexcept { return counter_; }
+
+  // Skips n bytes of keystream, as if that many bytes had been processed
+  AES_HPP_CONSTEXPR void discard(std::size_t n) noexcept
+  {
+    const std::size_t left = AES_BLOCKLEN - used_;
+    if (n <= left)
+    {
+      used_ += n;
+      return;
+    }
+    n -= left;
+    detail::add_counter(counter_, n / AES_BLOCKLEN);
+    used_ = AES_BLOCKLEN;
+    if (n % AES_BLOCKLEN != 0)
+    {
+      detail::copy_bytes(keystream_, counter_, AES_BLOCKLEN);
+      detail::increment_counter(counter_);
+      cipher_.encrypt_block(keystream_);
+      used_ = n % AES_BLOCKLEN;
+    }
+  }
+
+  AES_HPP_CONSTEXPR void xcrypt(uint8_t* buf, std::size_t length) noexcept { xcrypt(buf, buf, length); }
+
+  // Out of place: out receives in ^ keystream. out may equal in but must not
+  // otherwise overlap it.
+  AES_HPP_CONSTEXPR void xcrypt(const uint8_t* in, uint8_t* out, std::size_t length) noexcept;
+
+#if AES_HPP_RANGES
+  template <writable_byte_range R>
+  void xcrypt(R&& buf) noexcept { xcrypt(detail::writable_bytes_of(buf), std::ranges::size(buf)); }
+
+  // Processes the first min(in.size(), out.size()) bytes and returns that count
+  template <byte_range In, writable_byte_range Out>
+  std::size_t xcrypt(In&& in, Out&& out) noexcept
+  {
+    const std::size_t length = std::min<std::size_t>(std::ranges::size(in), std::ranges::size(out));
+    xcrypt(detail::bytes_of(in), detail::writable_bytes_of(out), length);
+    return length;
+  }
+#endif
+
+  AES_HPP_CONSTEXPR const cipher_type& cipher() const noexcept { return cipher_; }
+
+private:
+  cipher_type cipher_;
+  uint8_t counter_[AES_BLOCKLEN] = {};
+  uint8_t keystream_[AES_BLOCKLEN] = {};
+  std::size_t used_ = AES_BLOCKLEN;  // bytes of keystream_ already consumed
+};
+
+template <unsigned KeyBits>
+AES_HPP_CONSTEXPR void Ctr<KeyBits>::xcrypt(const uint8_t* in, uint8_t* out, std::size_t length) noexcept
+{
+  // Finish the keystream block left over from the previous call
+  if (used_ < AES_BLOCKLEN && length > 0)
+  {
+    std::size_t n = AES_BLOCKLEN - used_;
+    if (n > length)
+    {
+      n = length;
+    }
+    detail::xor_bytes(out, in, keystream_ + used_, n);
+    used_ += n;
+    in += n;
+    out += n;
+    length -= n;
+  }
+
+  // Whole blocks, a tile at a time
+  uint8_t tile[tile_blocks * AES_BLOCKLEN];
+  while (length >= AES_BLOCKLEN)
+  {
+    std::size_t blocks = length / AES_BLOCKLEN;
+    if (blocks > tile_blocks)
+    {
+      blocks = tile_blocks;
+    }
+    for (std::size_t i = 0; i < blocks; ++i)
+    {
+      detail::copy_bytes(tile + i * AES_BLOCKLEN, counter_, AES_BLOCKLEN);
+      detail::increment_counter(counter_);
+    }
+    cipher_.encrypt_blocks(tile, blocks);
+    detail::xor_bytes(out, in, tile, blocks * AES_BLOCKLEN);
+    in += blocks * AES_BLOCKLEN;
+    out += blocks * AES_BLOCKLEN;
+    length -= blocks * AES_BLOCKLEN;
+  }
+
+  // Partial last block; keep the rest of its keystream
+  if (length > 0)
+  {
+    detail::copy_bytes(keystream_, counter_, AES_BLOCKLEN);
+    detail::increment_counter(counter_);
+    cipher_.encrypt_block(keystream_);
+    detail::xor_bytes(out, in, keystream_, length);
+    used_ = length;
+  }
+}
+
+using Aes128 = Aes<128>;
+using Aes192 = Aes<192>;
+using Aes256 = Aes<256>;
+
+using Ecb128 = Ecb<128>;
+using Ecb192 = Ecb<192>;
+using Ecb256 = Ecb<256>;
+
+using Cbc128 = Cbc<128>;
+using Cbc192 = Cbc<192>;
+using Cbc256 = Cbc<256>;
+
+using Ctr128 = Ctr<128>;
+using Ctr192 = Ctr<192>;
+using Ctr256 = Ctr<256>;
+
+
+// Move-only owners of key material in 64-byte aligned storage. The object
+// lives at a fixed address, so moving a Unique<T> only moves a pointer, and
+// round keys (the first member of Aes and of struct AES_ctx) start on a cache
+// line for the vector kernels. On destruction the storage is wiped before it
+// is released.
+//
+// The storage comes from the heap, or from a Pool<T> given at construction:
+// a fixed set of slots handed out through a lock-free free list, so taking and
+// returning a key costs two compare-and-swaps instead of a heap allocation.
+// When the pool is empty the heap is used instead. A pool has to outlive the
+// objects taken from it.
+//
+//   tiny_aes::Pool<tiny_aes::Aes128> keys(1024);
+//   tiny_aes::UniqueAes<128> key(keys, raw_key);
+//   key->encrypt_block(block);
+constexpr std::size_t storage_alignment = 64;
+
+namespace detail
+{
+inline void secure_zero(void* p, std::size_t n) noexcept
+{
+  volatile unsigned char* b = static_cast<volatile unsigned char*>(p);
+  while (n-- > 0)
+  {
+    *b++ = 0;
+  }
+}
+} // namespace detail
+
+template <typename T>
+class Pool
+{
+public:
+  explicit Pool(std::size_t capacity)
+    : capacity_((uint32_t)capacity),
+      slots_(static_cast<slot*>(::operator new[](sizeof(slot) * capacity, std::align_val_t(storage_alignment)))),
+      next_(new std::atomic<uint32_t>[capacity])
+  {
+    // Chain every slot into the free list; a link of 0 ends the list
+    for (uint32_t i = 0; i < capacity_; ++i)
+    {
+      next_[i].store((i + 1 < capacity_) ? i + 2 : 0, std::memory_order_relaxed);
+    }
+    head_.store((capacity_ > 0) ? 1 : 0, std::memory_order_release);
+  }
+
+  ~Pool()
+  {
+    ::operator delete[](slots_, std::align_val_t(storage_alignment));
+  }
+
+  Pool(const Pool&) = delete;
+  Pool& operator=(const Pool&) = delete;
+
+  std::size_t capacity() const noexcept { return capacity_; }
+
+  // Free slots; a snapshot when other threads use the pool
+  std::size_t available() const noexcept
+  {
+    std::size_t n = 0;
+    for (uint32_t i = (uint32_t)head_.load(std::memory_order_acquire); i != 0; i = next_[i - 1].load(std::memory_order_relaxed))
+    {
+      ++n;
+    }
+    return n;
+  }
+
+  // Uninitialized storage for one T, or nullptr if every slot is taken
+  void* acquire() noexcept
+  {
+    uint64_t head = head_.load(std::memory_order_acquire);
+    for (;;)
+    {
+      const uint32_t index = (uint32_t)head;
+      if (index == 0)
+      {
+        return nullptr;
+      }
+      // The tag in the upper half changes on every update, so a head that was
+      // popped and pushed back in between (ABA) fails the exchange
+      const uint64_t next = ((head >> 32) + 1) << 32 | next_[index - 1].load(std::memory_order_relaxed);
+      if (head_.compare_exchange_weak(head, next, std::memory_order_acquire, std::memory_order_acquire))
+      {
+        return &slots_[index - 1];
+      }
+    }
+  }
+
+  void release(void* p) noexcept
+  {
+    const uint32_t index = (uint32_t)(static_cast<slot*>(p) - slots_) + 1;
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      next_[index - 1].store((uint32_t)head, std::memory_order_relaxed);
+      const uint64_t next = ((head >> 32) + 1) << 32 | index;
+      if (head_.compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_relaxed))
+      {
+        return;
+      }
+    }
+  }
+
+  bool owns(const void* p) const noexcept
+  {
+    const slot* s = static_cast<const slot*>(p);
+    return s >= slots_ && s < slots_ + capacity_;
+  }
+
+private:
+  struct alignas(storage_alignment) slot
+  {
+    unsigned char bytes[sizeof(T)];
+  };
+
+  uint32_t capacity_;
+  slot* slots_;
+  std::unique_ptr<std::atomic<uint32_t>[]> next_;  // 1-based index of the next free slot
+  alignas(storage_alignment) std::atomic<uint64_t> head_{0};  // tag << 32 | 1-based index of the first free slot
+};
+
+template <typename T>
+class Unique
+{
+public:
+  Unique() noexcept = default;
+
+  // Constructs T(args...) on the heap
+  template <typename... Args>
+  explicit Unique(std::in_place_t, Args&&... args)
+    : object_(construct(::operator new(sizeof(T), std::align_val_t(storage_alignment)), std::forward<Args>(args)...))
+  {
+  }
+
+  // Constructs T(args...) in a slot of pool, or on the heap if the pool is empty
+  template <typename... Args>
+  explicit Unique(Pool<T>& pool, Args&&... args)
+  {
+    void* p = pool.acquire();
+    if (p != nullptr)
+    {
+      pool_ = &pool;
+    }
+    else
+    {
+      p = ::operator new(sizeof(T), std::align_val_t(storage_alignment));
+    }
+    object_ = construct(p, std::forward<Args>(args)...);
+  }
+
+  Unique(Unique&& other) noexcept
+    : object_(std::exchange(other.object_, nullptr)), pool_(std::exchange(other.pool_, nullptr))
+  {
+  }
+
+  Unique& operator=(Unique&& other) noexcept
+  {
+    Unique(std::move(other)).swap(*this);
+    return *this;
+  }
+
+  Unique(const Unique&) = delete;
+  Unique& operator=(const Unique&) = delete;
+
+  ~Unique() { reset(); }
+
+  void reset() noexcept
+  {
+    if (object_ != nullptr)
+    {
+      object_->~T();
+      detail::secure_zero(object_, sizeof(T));
+      if (pool_ != nullptr)
+      {
+        pool_->release(object_);
+      }
+      else
+      {
+        ::operator delete(static_cast<void*>(object_), std::align_val_t(storage_alignment));
+      }
+      object_ = nullptr;
+      pool_ = nullptr;
+    }
+  }
+
+  void swap(Unique& other) noexcept
+  {
+    std::swap(object_, other.object_);
+    std::swap(pool_, other.pool_);
+  }
+
+  T* get() const noexcept { return object_; }
+  T& operator*() const noexcept { return *object_; }
+  T* operator->() const noexcept { return object_; }
+  explicit operator bool() const noexcept { return object_ != nullptr; }
+
+  // Whether the object sits in a pool slot rather than on the heap
+  bool pooled() const noexcept { return pool_ != nullptr; }
+
+private:
+  template <typename... Args>
+  static T* construct(void* p, Args&&... args)
+  {
+    if constexpr (std::is_aggregate_v<T>)
+    {
+      return ::new (p) T{ std::forward<Args>(args)... };
+    }
+    else
+    {
+      static_assert(std::is_nothrow_constructible_v<T, Args...>, "a throwing constructor would leak the storage");
+      return ::new (p) T(std::forward<Args>(args)...);
+    }
+  }
+
+  T* object_ = nullptr;
+  Pool<T>* pool_ = nullptr;
+};
+
+template <unsigned KeyBits> using UniqueAes = Unique<Aes<KeyBits>>;
+template <unsigned KeyBits> using UniqueCtr = Unique<Ctr<KeyBits>>;
+using UniqueContext = Unique<AES_ctx>;  // value-initialized; set up with AES_init_ctx()/AES_init_ctx_iv()
+
+
+// CTR-encrypts a constant. With C++20 this runs in constant expressions:
+//
+//   constexpr std::array<uint8_t, 16> key = { ... }, iv = { ... };
+//   constexpr auto blob = tiny_aes::ctr_encrypt_constant(key, iv, std::array<uint8_t, 4>{ 1, 2, 3, 4 });
+//
+// Decrypt at run time with Ctr<8 * KeySize> or AES_CTR_xcrypt_buffer() and the same key and IV.
+template <std::size_t KeySize, std::size_t N>
+AES_HPP_CONSTEXPR std::array<uint8_t, N> ctr_encrypt_constant(const std::array<uint8_t, KeySize>& key,
+                                                              const std::array<uint8_t, AES_BLOCKLEN>& iv,
+                                                              const std::array<uint8_t, N>& data) noexcept
+{
+  std::array<uint8_t, N> out = data;
+  Ctr<8 * KeySize> ctr(key.data(), iv.data());
+  ctr.xcrypt(out.data(), N);
+  return out;
+}
+
+
+#if AES_HPP_RANGES
+// Read-only random-access view of the plaintext of a CTR ciphertext. Nothing
+// is decrypted up front: dereferencing an iterator decrypts the tile of
+// view_tile_blocks blocks it points into, and the counter for any position is
+// the IV plus its block number, so iterators jump anywhere without decrypting
+// what lies between. read() decrypts an arbitrary byte range the same way.
+//
+//   auto plain = tiny_aes::ctr_view(tiny_aes::Aes128(key), iv, file_bytes);
+//   uint32_t magic = plain[0] | plain[1] << 8 | ...;
+//
+// The ciphertext is referenced, not copied. The view caches one tile, so a
+// view (and its iterators) must not be used from several threads at once.
+template <unsigned KeyBits>
+class CtrView : public std::ranges::view_interface<CtrView<KeyBits>>
+{
+public:
+  using cipher_type = Aes<KeyBits>;
+  static constexpr std::size_t view_tile_blocks = 64;
+
+  class iterator;
+
+  using allocator_type = tiny_aes::allocator_type;
+
+  CtrView() = default;
+  CtrView(const cipher_type& cipher, const uint8_t* iv, std::span<const uint8_t> ciphertext,
+          const allocator_type& alloc = {})
+    : state_(std::allocate_shared<state>(alloc, cipher, iv, ciphertext)), resource_(alloc.resource())
+  {
+  }
+
+  // Uses-allocator copy, so pmr containers of views keep them in their arena
+  CtrView(std::allocator_arg_t, const allocator_type& alloc, const CtrView& other)
+    : state_(other.state_ ? std::allocate_shared<state>(alloc, *other.state_) : nullptr), resource_(alloc.resource())
+  {
+  }
+
+  allocator_type get_allocator() const noexcept { return allocator_type(resource_); }
+
+  iterator begin() const noexcept { return iterator(state_.get(), 0); }
+  iterator end() const noexcept { return iterator(state_.get(), size()); }
+  std::size_t size() const noexcept { return state_ ? state_->ciphertext.size() : 0; }
+
+  // Decrypts the bytes from offset on into out; returns how many there were
+  std::size_t read(std::size_t offset, std::span<uint8_t> out) const noexcept
+  {
+    if (offset >= size())
+    {
+      return 0;
+    }
+    const std::size_t n = std::min(out.size(), size() - offset);
+    state_->xcrypt(offset, out.data(), n);
+    return n;
+  }
+
+private:
+  struct state
+  {
+    state(const cipher_type& c, const uint8_t* iv_, std::span<const uint8_t> ct) : cipher(c), ciphertext(ct)
+    {
+      detail::copy_bytes(iv, iv_, AES_BLOCKLEN);
+    }
+
+    // Seek: start the keystream at offset's block and drop the bytes before it
+    void xcrypt(std::size_t offset, uint8_t* out, std::size_t length) const noexcept
+    {
+      uint8_t counter[AES_BLOCKLEN];
+      detail::copy_bytes(counter, iv, AES_BLOCKLEN);
+      detail::add_counter(counter, offset / AES_BLOCKLEN);
+      Ctr<KeyBits> ctr(cipher, counter);
+      ctr.discard(offset % AES_BLOCKLEN);
+      ctr.xcrypt(ciphertext.data() + offset, out, length);
+    }
+
+    uint8_t at(std::size_t pos)
+    {
+      const std::size_t t = pos / sizeof(tile);
+      if (t != tile_index)
+      {
+        const std::size_t first = t * sizeof(tile);
+        xcrypt(first, tile, std::min(sizeof(tile), ciphertext.size() - first));
+        tile_index = t;
+      }
+      return tile[pos % sizeof(tile)];
+    }
+
+    cipher_type cipher;
+    std::span<const uint8_t> ciphertext;
+    uint8_t iv[AES_BLOCKLEN];
+    std::size_t tile_index = (std::size_t)-1;
+    alignas(64) uint8_t tile[view_tile_blocks * AES_BLOCKLEN];
+  };
+
+  // Shared, so that copies of the view and their iterators stay valid and cheap
+  std::shared_ptr<state> state_;
+  std::pmr::memory_resource* resource_ = std::pmr::get_default_resource();  // not the allocator: views must stay assignable
+
+public:
+  class iterator
+  {
+  public:
+    using iterator_concept = std::random_access_iterator_tag;
+    using iterator_category = std::input_iterator_tag;  // dereferencing yields a value, not a reference
+    using value_type = uint8_t;
+    using difference_type = std::ptrdiff_t;
+
+    iterator() noexcept = default;
+
+    uint8_t operator*() const noexcept { return state_->at(pos_); }
+    uint8_t operator[](difference_type n) const noexcept { return state_->at(pos_ + n); }
+
+    // Position in the plaintext
+    std::size_t offset() const noexcept { return pos_; }
+
+    iterator& operator++() noexcept { ++pos_; return *this; }
+    iterator operator++(int) noexcept { iterator t = *this; ++pos_; return t; }
+    iterator& operator--() noexcept { --pos_; return *this; }
+    iterator operator--(int) noexcept { iterator t = *this; --pos_; return t; }
+    iterator& operator+=(difference_type n) noexcept { pos_ += n; return *this; }
+    iterator& operator-=(difference_type n) noexcept { pos_ -= n; return *this; }
+
+    friend iterator operator+(iterator a, difference_type n) noexcept { return a += n; }
+    friend iterator operator+(difference_type n, iterator a) noexcept { return a += n; }
+    friend iterator operator-(iterator a, difference_type n) noexcept { return a -= n; }
+    friend difference_type operator-(const iterator& a, const iterator& b) noexcept { return (difference_type)(a.pos_ - b.pos_); }
+    friend bool operator==(const iterator& a, const iterator& b) noexcept { return a.pos_ == b.pos_; }
+    friend auto operator<=>(const iterator& a, const iterator& b) noexcept { return a.pos_ <=> b.pos_; }
+
+  private:
+    friend class CtrView;
+    iterator(state* s, std::size_t pos) noexcept : state_(s), pos_(pos) {}
+
+    state* state_ = nullptr;
+    std::size_t pos_ = 0;
+  };
+};
+
+template <unsigned KeyBits, byte_range R>
+CtrView<KeyBits> ctr_view(const Aes<KeyBits>& cipher, const uint8_t* iv, R&& ciphertext, const allocator_type& alloc = {})
+{
+  return CtrView<KeyBits>(cipher, iv, std::span<const uint8_t>(detail::bytes_of(ciphertext), std::ranges::size(ciphertext)), alloc);
+}
+#endif // AES_HPP_RANGES
+
+
+#if defined(CTR) && (CTR == 1)
+namespace detail
+{
+// The C CTR kernel for a buffer; the OpenMP one for large buffers when enabled
+inline void ctr_xcrypt(AES_ctx& ctx, uint8_t* buf, std::size_t length) noexcept
+{
+#if AES_HPP_OPENMP
+  if (length >= AES_HPP_PARALLEL_MIN)
+  {
+    AES_CTR_xcrypt_buffer_openmp(&ctx, buf, length);
+    return;
+  }
+#endif
+  AES_CTR_xcrypt_buffer(&ctx, buf, length);
+}
+} // namespace detail
+
+// CTR over a C struct AES_ctx, with the same interface as Ctr: the unused tail
+// of the last keystream block is kept for the next call. Whole blocks go
+// through the C kernels (OpenMP for large buffers with AES_HPP_OPENMP), so
+// the key size is the one the C library was built with.
+class CtrContext
+{
+public:
+  explicit CtrContext(const AES_ctx& ctx) noexcept : ctx_(ctx) {}
+  CtrContext(const uint8_t* key, const uint8_t* iv) noexcept { AES_init_ctx_iv(&ctx_, key, iv); }
+
+  void set_iv(const uint8_t* iv) noexcept
+  {
+    AES_ctx_set_iv(&ctx_, iv);
+    used_ = AES_BLOCKLEN;
+  }
+
+  void xcrypt(uint8_t* buf, std::size_t length) noexcept
+  {
+    std::size_t n = std::min(AES_BLOCKLEN - used_, length);
+    detail::xor_bytes(buf, keystream_ + used_, n);
+    used_ += n;
+    buf += n;
+    length -= n;
+
+    n = length & ~(std::size_t)(AES_BLOCKLEN - 1);
+    if (n > 0)
+    {
+      detail::ctr_xcrypt(ctx_, buf, n);
+      buf += n;
+      length -= n;
+    }
+
+    if (length > 0)
+    {
+      // Encrypting zeros yields the keystream block and advances the counter
+      std::memset(keystream_, 0, AES_BLOCKLEN);
+      AES_CTR_xcrypt_buffer(&ctx_, keystream_, AES_BLOCKLEN);
+      detail::xor_bytes(buf, keystream_, length);
+      used_ = length;
+    }
+  }
+
+  const AES_ctx& context() const noexcept { return ctx_; }
+
+private:
+  AES_ctx ctx_;
+  uint8_t keystream_[AES_BLOCKLEN] = {};
+  std::size_t used_ = AES_BLOCKLEN;
+};
+#endif
+
+
+#if AES_HPP_RANGES
+// Range overloads of the C mode functions, for a struct AES_ctx set up with
+// AES_init_ctx()/AES_init_ctx_iv(). They run the same code as the C calls, so
+// statistics, traces and probes see them like any other call.
+#if defined(ECB) && (ECB == 1)
+template <writable_byte_range R>
+inline void ecb_encrypt(const AES_ctx& ctx, R&& buf) noexcept
+{
+  uint8_t* p = detail::writable_bytes_of(buf);
+  for (std::size_t i = 0; i + AES_BLOCKLEN <= std::ranges::size(buf); i += AES_BLOCKLEN)
+  {
+    AES_ECB_encrypt(&ctx, p + i);
+  }
+}
+
+template <writable_byte_range R>
+inline void ecb_decrypt(const AES_ctx& ctx, R&& buf) noexcept
+{
+  uint8_t* p = detail::writable_bytes_of(buf);
+  for (std::size_t i = 0; i + AES_BLOCKLEN <= std::ranges::size(buf); i += AES_BLOCKLEN)
+  {
+    AES_ECB_decrypt(&ctx, p + i);
+  }
+}
+#endif
+
+#if defined(CBC) && (CBC == 1)
+template <writable_byte_range R>
+inline void cbc_encrypt(AES_ctx& ctx, R&& buf) noexcept
+{
+  AES_CBC_encrypt_buffer(&ctx, detail::writable_bytes_of(buf), std::ranges::size(buf) & ~(std::size_t)(AES_BLOCKLEN - 1));
+}
+
+template <writable_byte_range R>
+inline void cbc_decrypt(AES_ctx& ctx, R&& buf) noexcept
+{
+  AES_CBC_decrypt_buffer(&ctx, detail::writable_bytes_of(buf), std::ranges::size(buf) & ~(std::size_t)(AES_BLOCKLEN - 1));
+}
+#endif
+
+#if defined(CTR) && (CTR == 1)
+template <writable_byte_range R>
+inline void ctr_xcrypt(AES_ctx& ctx, R&& buf) noexcept
+{
+  detail::ctr_xcrypt(ctx, detail::writable_bytes_of(buf), std::ranges::size(buf));
+}
+
+// Out of place: out receives in ^ keystream. The C kernels work in place, so
+// in is first copied to out (skipped when they are the same buffer).
+// Processes the first min(in.size(), out.size()) bytes and returns that count.
+template <byte_range In, writable_byte_range Out>
+inline std::size_t ctr_xcrypt(AES_ctx& ctx, In&& in, Out&& out) noexcept
+{
+  const std::size_t length = std::min<std::size_t>(std::ranges::size(in), std::ranges::size(out));
+  uint8_t* dst = detail::writable_bytes_of(out);
+  const uint8_t* src = detail::bytes_of(in);
+  if (dst != src)
+  {
+    std::memmove(dst, src, length);
+  }
+  detail::ctr_xcrypt(ctx, dst, length);
+  return length;
+}
+#endif
+#endif // AES_HPP_RANGES
+
+#if AES_HPP_RANGES && AES_HPP_PARALLEL_STL
+// Overloads of the struct AES_ctx range functions that take an execution
+// policy first, like the standard algorithms:
+//
+//   tiny_aes::ctr_xcrypt(std::execution::par_unseq, ctx, buffer);
+//
+// The buffer is cut into chunks of AES_HPP_PARALLEL_STL_CHUNK blocks that are
+// processed independently by std::for_each under the given policy. The
+// output, and the IV left in ctx, are the same as from the C functions. The
+// chunks run on the selected block and XOR backends (aes_backend.h) rather
+// than through the C mode functions, so statistics and traces do not see them.
+namespace detail
+{
+// 0, 1, 2, ... as a random-access iterator; the parallel algorithms need
+// forward iterators, which std::views::iota does not provide
+class index_iterator
+{
+public:
+  using iterator_category = std::random_access_iterator_tag;
+  using value_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const std::size_t*;
+  using reference = std::size_t;
+
+  index_iterator() noexcept = default;
+  explicit index_iterator(std::size_t i) noexcept : i_(i) {}
+
+  std::size_t operator*() const noexcept { return i_; }
+  std::size_t operator[](difference_type n) const noexcept { return i_ + n; }
+
+  index_iterator& operator++() noexcept { ++i_; return *this; }
+  index_iterator operator++(int) noexcept { index_iterator t = *this; ++i_; return t; }
+  index_iterator& operator--() noexcept { --i_; return *this; }
+  index_iterator operator--(int) noexcept { index_iterator t = *this; --i_; return t; }
+  index_iterator& operator+=(difference_type n) noexcept { i_ += n; return *this; }
+  index_iterator& operator-=(difference_type n) noexcept { i_ -= n; return *this; }
+
+  friend index_iterator operator+(index_iterator a, difference_type n) noexcept { return a += n; }
+  friend index_iterator operator+(difference_type n, index_iterator a) noexcept { return a += n; }
+  friend index_iterator operator-(index_iterator a, difference_type n) noexcept { return a -= n; }
+  friend difference_type operator-(index_iterator a, index_iterator b) noexcept { return (difference_type)(a.i_ - b.i_); }
+  friend auto operator<=>(index_iterator a, index_iterator b) noexcept = default;
+
+private:
+  std::size_t i_ = 0;
+};
+
+template <typename Policy, typename F>
+void for_each_chunk(Policy&& policy, std::size_t nchunks, F f)
+{
+  std::for_each(std::forward<Policy>(policy), index_iterator(0), index_iterator(nchunks), f);
+}
+
+template <typename Policy>
+concept execution_policy = std::is_execution_policy_v<std::remove_cvref_t<Policy>>;
+} // namespace detail
+
+#if defined(ECB) && (ECB == 1)
+template <detail::execution_policy Policy, writable_byte_range R>
+void ecb_encrypt(Policy&& policy, const AES_ctx& ctx, R&& buf)
+{
+  uint8_t* p = detail::writable_bytes_of(buf);
+  const std::size_t nblocks = std::ranges::size(buf) / AES_BLOCKLEN;
+  const AES_block_fn block = AES_backend_block();
+
+  detail::for_each_chunk(std::forward<Policy>(policy), (nblocks + AES_HPP_PARALLEL_STL_CHUNK - 1) / AES_HPP_PARALLEL_STL_CHUNK,
+                         [=, &ctx](std::size_t c) {
+    const std::size_t first = c * AES_HPP_PARALLEL_STL_CHUNK;
+    block(&ctx, p + first * AES_BLOCKLEN, std::min<std::size_t>(AES_HPP_PARALLEL_STL_CHUNK, nblocks - first));
+  });
+}
+
+template <detail::execution_policy Policy, writable_byte_range R>
+void ecb_decrypt(Policy&& policy, const AES_ctx& ctx, R&& buf)
+{
+  uint8_t* p = detail::writable_bytes_of(buf);
+  const std::size_t nblocks = std::ranges::size(buf) / AES_BLOCKLEN;
+
+  detail::for_each_chunk(std::forward<Policy>(policy), (nblocks + AES_HPP_PARALLEL_STL_CHUNK - 1) / AES_HPP_PARALLEL_STL_CHUNK,
+                         [=, &ctx](std::size_t c) {
+    const std::size_t first = c * AES_HPP_PARALLEL_STL_CHUNK;
+    const std::size_t last = std::min<std::size_t>(first + AES_HPP_PARALLEL_STL_CHUNK, nblocks);
+    for (std::size_t i = first; i < last; ++i)
+    {
+      AES_block_decrypt(&ctx, p + i * AES_BLOCKLEN);
+    }
+  });
+}
+#endif
+
+#if defined(CBC) && (CBC == 1)
+// CBC encryption is inherently serial; decryption of each block only needs
+// the ciphertext block before it. Those are saved for every chunk boundary
+// first, since the chunk before may already have decrypted them in place.
+template <detail::execution_policy Policy, writable_byte_range R>
+void cbc_decrypt(Policy&& policy, AES_ctx& ctx, R&& buf, const allocator_type& alloc = {})
+{
+  uint8_t* p = detail::writable_bytes_of(buf);
+  const std::size_t nblocks = std::ranges::size(buf) / AES_BLOCKLEN;
+  const std::size_t nchunks = (nblocks + AES_HPP_PARALLEL_STL_CHUNK - 1) / AES_HPP_PARALLEL_STL_CHUNK;
+  if (nblocks == 0)
+  {
+    return;
+  }
+
+  std::pmr::vector<uint8_t> chain(nchunks * AES_BLOCKLEN, alloc);
+  std::memcpy(chain.data(), ctx.Iv, AES_BLOCKLEN);
+  for (std::size_t c = 1; c < nchunks; ++c)
+  {
+    std::memcpy(chain.data() + c * AES_BLOCKLEN, p + (c * AES_HPP_PARALLEL_STL_CHUNK - 1) * AES_BLOCKLEN, AES_BLOCKLEN);
+  }
+  std::memcpy(ctx.Iv, p + (nblocks - 1) * AES_BLOCKLEN, AES_BLOCKLEN);
+
+  const uint8_t* previous = chain.data();
+  const AES_ctx* key = &ctx;
+  detail::for_each_chunk(std::forward<Policy>(policy), nchunks, [=](std::size_t c) {
+    const std::size_t first = c * AES_HPP_PARALLEL_STL_CHUNK;
+    const std::size_t last = std::min<std::size_t>(first + AES_HPP_PARALLEL_STL_CHUNK, nblocks);
+    uint8_t chain_block[AES_BLOCKLEN], cipher_block[AES_BLOCKLEN];
+    std::memcpy(chain_block, previous + c * AES_BLOCKLEN, AES_BLOCKLEN);
+    for (std::size_t i = first; i < last; ++i)
+    {
+      uint8_t* b = p + i * AES_BLOCKLEN;
+      std::memcpy(cipher_block, b, AES_BLOCKLEN);
+      AES_block_decrypt(key, b);
+      detail::xor_bytes(b, chain_block, AES_BLOCKLEN);
+      std::memcpy(chain_block, cipher_block, AES_BLOCKLEN);
+    }
+  });
+}
+#endif
+
+#if defined(CTR) && (CTR == 1)
+template <detail::execution_policy Policy, writable_byte_range R>
+void ctr_xcrypt(Policy&& policy, AES_ctx& ctx, R&& buf)
+{
+  uint8_t* p = detail::writable_bytes_of(buf);
+  const std::size_t length = std::ranges::size(buf);
+  const std::size_t nblocks = (length + AES_BLOCKLEN - 1) / AES_BLOCKLEN;
+  const AES_block_fn block = AES_backend_block();
+  const AES_xor_fn xor_fn = AES_backend_xor();
+  const AES_ctx* key = &ctx;
+  uint8_t iv[AES_BLOCKLEN];
+  std::memcpy(iv, ctx.Iv, AES_BLOCKLEN);
+
+  detail::for_each_chunk(std::forward<Policy>(policy), (nblocks + AES_HPP_PARALLEL_STL_CHUNK - 1) / AES_HPP_PARALLEL_STL_CHUNK,
+                         [=, &iv](std::size_t c) {
+    const std::size_t end = std::min<std::size_t>(length, (c + 1) * AES_HPP_PARALLEL_STL_CHUNK * AES_BLOCKLEN);
+    uint8_t counter[AES_BLOCKLEN], tile[detail::tile_blocks * AES_BLOCKLEN];
+    std::memcpy(counter, iv, AES_BLOCKLEN);
+    detail::add_counter(counter, (uint64_t)c * AES_HPP_PARALLEL_STL_CHUNK);
+
+    for (std::size_t offset = c * AES_HPP_PARALLEL_STL_CHUNK * AES_BLOCKLEN; offset < end; offset += sizeof(tile))
+    {
+      const std::size_t bytes = std::min(sizeof(tile), end - offset);
+      const std::size_t blocks = (bytes + AES_BLOCKLEN - 1) / AES_BLOCKLEN;
+      for (std::size_t i = 0; i < blocks; ++i)
+      {
+        std::memcpy(tile + i * AES_BLOCKLEN, counter, AES_BLOCKLEN);
+        detail::increment_counter(counter);
+      }
+      block(key, tile, blocks);
+      xor_fn(p + offset, tile, bytes);
+    }
+  });
+
+  // The C function also moves past the counter of a partial last block
+  detail::add_counter(ctx.Iv, nblocks);
+}
+#endif
+#endif // AES_HPP_RANGES && AES_HPP_PARALLEL_STL
+
+
+// std::streambuf filters. Stream is Ctr<Bits>, CtrContext or anything else
+// with xcrypt(uint8_t*, size_t) that carries its position across calls.
+//
+// EncryptingStreambuf collects what is written to it in one aligned buffer and
+// encrypts and forwards it to the sink when the buffer is full, on flush and
+// on destruction. DecryptingStreambuf reads a buffer's worth from the source
+// at a time and decrypts it. With a large buffer every xcrypt() call covers
+// many blocks, so std::ostream/std::istream code gets bulk-call throughput.
+// CTR is symmetric, so either one also works the other way round.
+//
+//   std::ofstream file("out.bin", std::ios::binary);
+//   tiny_aes::EncryptingStreambuf buf(file.rdbuf(), tiny_aes::Ctr128(key, iv));
+//   std::ostream out(&buf);
+#ifndef AES_HPP_STREAM_BUFFER
+  #define AES_HPP_STREAM_BUFFER (256 * 1024)
+#endif
+
+namespace detail
+{
+// Cache-line aligned bytes from a memory resource; the size is rounded up to
+// whole blocks and is at least one block
+class aligned_buffer
+{
+public:
+  aligned_buffer(std::size_t size, const allocator_type& alloc)
+    : alloc_(alloc),
+      size_((std::max<std::size_t>(size, AES_BLOCKLEN) + AES_BLOCKLEN - 1) & ~(std::size_t)(AES_BLOCKLEN - 1)),
+      data_(static_cast<uint8_t*>(alloc_.resource()->allocate(size_, 64)))
+  {
+  }
+
+  ~aligned_buffer() { alloc_.resource()->deallocate(data_, size_, 64); }
+
+  aligned_buffer(const aligned_buffer&) = delete;
+  aligned_buffer& operator=(const aligned_buffer&) = delete;
+
+  uint8_t* data() const noexcept { return data_; }
+  std::size_t size() const noexcept { return size_; }
+  allocator_type get_allocator() const noexcept { return alloc_; }
+
+private:
+  allocator_type alloc_;
+  std::size_t size_;
+  uint8_t* data_;
+};
+} // namespace detail
+
+template <typename Stream>
+class EncryptingStreambuf : public std::streambuf
+{
+public:
+  using allocator_type = tiny_aes::allocator_type;
+
+  EncryptingStreambuf(std::streambuf* sink, Stream stream, std::size_t buffer_size = AES_HPP_STREAM_BUFFER,
+                      const allocator_type& alloc = {})
+    : sink_(sink), stream_(std::move(stream)), buffer_(buffer_size, alloc)
+  {
+    char* p = reinterpret_cast<char*>(buffer_.data());
+    setp(p, p + buffer_.size());
+  }
+
+  ~EncryptingStreambuf() override { flush_buffer(); }
+
+  EncryptingStreambuf(const EncryptingStreambuf&) = delete;
+  EncryptingStreambuf& operator=(const EncryptingStreambuf&) = delete;
+
+  Stream& stream() noexcept { return stream_; }
+  allocator_type get_allocator() const noexcept { return buffer_.get_allocator(); }
+
+protected:
+  int_type overflow(int_type ch) override
+  {
+    if (!flush_buffer())
+    {
+      return traits_type::eof();
+    }
+    if (!traits_type::eq_int_type(ch, traits_type::eof()))
+    {
+      *pptr() = traits_type::to_char_type(ch);
+      pbump(1);
+    }
+    return traits_type::not_eof(ch);
+  }
+
+  int sync() override
+  {
+    return (flush_buffer() && sink_->pubsync() == 0) ? 0 : -1;
+  }
+
+private:
+  // Encrypts what is buffered and hands it to the sink
+  bool flush_buffer()
+  {
+    const std::streamsize n = pptr() - pbase();
+    if (n > 0)
+    {
+      stream_.xcrypt(buffer_.data(), (std::size_t)n);
+      setp(pbase(), epptr());
+      return sink_->sputn(reinterpret_cast<const char*>(buffer_.data()), n) == n;
+    }
+    return true;
+  }
+
+  std::streambuf* sink_;
+  Stream stream_;
+  detail::aligned_buffer buffer_;
+};
+
+template <typename Stream>
+class DecryptingStreambuf : public std::streambuf
+{
+public:
+  using allocator_type = tiny_aes::allocator_type;
+
+  DecryptingStreambuf(std::streambuf* source, Stream stream, std::size_t buffer_size = AES_HPP_STREAM_BUFFER,
+                      const allocator_type& alloc = {})
+    : source_(source), stream_(std::move(stream)), buffer_(buffer_size, alloc)
+  {
+    char* p = reinterpret_cast<char*>(buffer_.data());
+    setg(p, p, p);
+  }
+
+  DecryptingStreambuf(const DecryptingStreambuf&) = delete;
+  DecryptingStreambuf& operator=(const DecryptingStreambuf&) = delete;
+
+  Stream& stream() noexcept { return stream_; }
+  allocator_type get_allocator() const noexcept { return buffer_.get_allocator(); }
+
+protected:
+  int_type underflow() override
+  {
+    if (gptr() < egptr())
+    {
+      return traits_type::to_int_type(*gptr());
+    }
+    char* p = reinterpret_cast<char*>(buffer_.data());
+    const std::streamsize n = source_->sgetn(p, (std::streamsize)buffer_.size());
+    if (n <= 0)
+    {
+      return traits_type::eof();
+    }
+    stream_.xcrypt(buffer_.data(), (std::size_t)n);
+    setg(p, p, p + n);
+    return traits_type::to_int_type(*p);
+  }
+
+private:
+  std::streambuf* source_;
+  Stream stream_;
+  detail::aligned_buffer buffer_;
+};
+
+
+#if AES_HPP_COROUTINES
+// C++20 coroutine support: co_await an encryption (or a read/write) and the
+// coroutine is suspended while a thread of a WorkerPool does the work, then
+// resumed on that worker thread. Works with any coroutine type; nothing here
+// depends on the caller's promise.
+//
+//   tiny_aes::FdSource in(in_fd);
+//   tiny_aes::FdSink out(out_fd);
+//   std::vector<uint8_t> chunk(1 << 20);
+//   for (ssize_t n; (n = co_await in.read(chunk)) > 0; )
+//   {
+//     std::span<uint8_t> data(chunk.data(), (size_t)n);
+//     co_await tiny_aes::async_xcrypt(pool, ctr, data);
+//     co_await out.write(data);
+//   }
+//
+// Keep one operation in flight per stream (CTR position) and per buffer.
+
+// A fixed set of threads taking jobs from one queue. The destructor runs the
+// jobs still queued, then joins the threads.
+class WorkerPool
+{
+public:
+  explicit WorkerPool(unsigned threads = 0)
+  {
+    if (threads == 0)
+    {
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned i = 0; i < threads; ++i)
+    {
+      workers_.emplace_back([this] { run(); });
+    }
+  }
+
+  ~WorkerPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    ready_.notify_all();
+    for (std::thread& t : workers_)
+    {
+      t.join();
+    }
+  }
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  void post(std::function<void()> job)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      jobs_.push_back(std::move(job));
+    }
+    ready_.notify_one();
+  }
+
+  std::size_t size() const noexcept { return workers_.size(); }
+
+  // One pool per process with a thread per core, started on first use
+  static WorkerPool& shared()
+  {
+    static WorkerPool pool;
+    return pool;
+  }
+
+private:
+  void run()
+  {
+    for (;;)
+    {
+      std::function<void()> job;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        ready_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+        if (jobs_.empty())
+        {
+          return;
+        }
+        job = std::move(jobs_.front());
+        jobs_.pop_front();
+      }
+      job();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  std::deque<std::function<void()>> jobs_;
+  bool stopping_ = false;
+  std::vector<std::thread> workers_;  // last, so the members above exist before a thread starts
+};
+
+// Awaitable that runs f() on a pool thread and resumes the coroutine there
+// with f's result. f must not throw.
+template <typename F>
+class PoolAwaiter
+{
+public:
+  using result_type = std::invoke_result_t<F&>;
+
+  PoolAwaiter(WorkerPool& pool, F f) : pool_(pool), f_(std::move(f)) {}
+
+  bool await_ready() const noexcept { return false; }
+
+  void await_suspend(std::coroutine_handle<> caller)
+  {
+    pool_.post([this, caller] {
+      if constexpr (std::is_void_v<result_type>)
+      {
+        f_();
+      }
+      else
+      {
+        result_ = f_();
+      }
+      caller.resume();
+    });
+  }
+
+  result_type await_resume() noexcept
+  {
+    if constexpr (!std::is_void_v<result_type>)
+    {
+      return std::move(result_);
+    }
+  }
+
+private:
+  struct none {};
+
+  WorkerPool& pool_;
+  F f_;
+  std::conditional_t<std::is_void_v<result_type>, none, result_type> result_{};
+};
+
+template <typename F>
+PoolAwaiter<F> run_on(WorkerPool& pool, F f)
+{
+  return PoolAwaiter<F>(pool, std::move(f));
+}
+
+// co_await async_xcrypt(pool, stream, buf) runs stream.xcrypt() over buf on the
+// pool and yields the number of bytes processed. buf's storage has to outlive
+// the co_await.
+template <typename Stream, writable_byte_range R>
+auto async_xcrypt(WorkerPool& pool, Stream& stream, R&& buf)
+{
+  uint8_t* data = detail::writable_bytes_of(buf);
+  const std::size_t length = std::ranges::size(buf);
+  return run_on(pool, [&stream, data, length] {
+    stream.xcrypt(data, length);
+    return length;
+  });
+}
+#endif // AES_HPP_COROUTINES
+
+
+#if AES_HPP_FD_IO
+// Chunked reads and writes on a POSIX file descriptor (file, pipe or socket)
+// for coroutines. The blocking read()/write() calls run on the pool, so the
+// awaiting coroutine's thread is free meanwhile; use blocking descriptors.
+// Both yield the byte count, or -errno on an error before anything was
+// transferred.
+class FdSource
+{
+public:
+  explicit FdSource(int fd, WorkerPool& pool = WorkerPool::shared()) noexcept : fd_(fd), pool_(&pool) {}
+
+  // Fills buf, short only at end of file; 0 once the end is reached
+  template <writable_byte_range R>
+  auto read(R&& buf)
+  {
+    uint8_t* data = detail::writable_bytes_of(buf);
+    const std::size_t length = std::ranges::size(buf);
+    return run_on(*pool_, [fd = fd_, data, length]() -> ssize_t {
+      std::size_t done = 0;
+      while (done < length)
+      {
+        const ssize_t n = ::read(fd, data + done, length - done);
+        if (n < 0 && errno == EINTR)
+        {
+          continue;
+        }
+        if (n < 0)
+        {
+          return (done > 0) ? (ssize_t)done : -errno;
+        }
+        if (n == 0)
+        {
+          break;
+        }
+        done += (std::size_t)n;
+      }
+      return (ssize_t)done;
+    });
+  }
+
+  int fd() const noexcept { return fd_; }
+
+private:
+  int fd_;
+  WorkerPool* pool_;
+};
+
+class FdSink
+{
+public:
+  explicit FdSink(int fd, WorkerPool& pool = WorkerPool::shared()) noexcept : fd_(fd), pool_(&pool) {}
+
+  // Writes all of buf
+  template <byte_range R>
+  auto write(R&& buf)
+  {
+    const uint8_t* data = detail::bytes_of(buf);
+    const std::size_t length = std::ranges::size(buf);
+    return run_on(*pool_, [fd = fd_, data, length]() -> ssize_t {
+      std::size_t done = 0;
+      while (done < length)
+      {
+        const ssize_t n = ::write(fd, data + done, length - done);
+        if (n < 0 && errno == EINTR)
+        {
+          continue;
+        }
+        if (n < 0)
+        {
+          return (done > 0) ? (ssize_t)done : -errno;
+        }
+        done += (std::size_t)n;
+      }
+      return (ssize_t)done;
+    });
+  }
+
+  int fd() const noexcept { return fd_; }
+
+private:
+  int fd_;
+  WorkerPool* pool_;
+};
+#endif // AES_HPP_FD_IO
+
+
+} // namespace tiny_aes
+
+#endif // C++17
+
 #endif //_AES_HPP_
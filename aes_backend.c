@@ -0,0 +1,449 @@
+/*
+
+Backend registry: the kernels available for each primitive, which one is
+selected, and the API/environment override.
+
+The selection is an index into a per-primitive table, read with a relaxed
+atomic load by the dispatching code. The environment variable is parsed once,
+on the first call into this file; an AES_backend_select() afterwards wins over it.
+Kernels that need a CPU feature say so with an availability check; the default
+is the first available one, and the others cannot be selected.
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "aes.h"
+#include "aes_backend.h"
+#include "aes_util.h"
+
+// The PCLMULQDQ GHASH kernel, where the compiler can build it
+#ifndef AES_BACKEND_PCLMUL
+  #if defined(__x86_64__) && defined(__GNUC__)
+    #define AES_BACKEND_PCLMUL 1
+  #else
+    #define AES_BACKEND_PCLMUL 0
+  #endif
+#endif
+
+// The AES-NI block kernel, where the compiler can build it
+#ifndef AES_BACKEND_AESNI
+  #if defined(__x86_64__) && defined(__GNUC__)
+    #define AES_BACKEND_AESNI 1
+  #else
+    #define AES_BACKEND_AESNI 0
+  #endif
+#endif
+
+#if AES_BACKEND_PCLMUL || AES_BACKEND_AESNI
+  #include <wmmintrin.h>
+  #include <tmmintrin.h>
+#endif
+
+
+/*****************************************************************************/
+/* Kernels:                                                                  */
+/*****************************************************************************/
+// The table-driven cipher from aes.c, one block after the other
+static void BlockPortable(const struct AES_ctx* ctx, uint8_t* blocks, size_t nblocks)
+{
+  size_t i;
+  for (i = 0; i < nblocks; ++i)
+  {
+    AES_block_encrypt(ctx, blocks + (i * AES_BLOCKLEN));
+  }
+}
+
+#if AES_BACKEND_AESNI
+#define AESNI __attribute__((target("sse2,aes")))
+#define AESNI_ROUNDS (AES_keyExpSize / AES_BLOCKLEN - 1)
+#define AESNI_LANES 8
+
+static int HaveAesni(void)
+{
+  return __builtin_cpu_supports("aes");
+}
+
+// The expanded key in ctx is in the byte order aesenc takes. Eight blocks go
+// through each round together, so the AES unit always has independent work.
+AESNI static void BlockAesni(const struct AES_ctx* ctx, uint8_t* blocks, size_t nblocks)
+{
+  __m128i rk[AESNI_ROUNDS + 1];
+  size_t i;
+  int r, j;
+
+  for (r = 0; r <= AESNI_ROUNDS; ++r)
+  {
+    rk[r] = _mm_loadu_si128((const __m128i*)(ctx->RoundKey + r * AES_BLOCKLEN));
+  }
+  for (i = 0; i + AESNI_LANES <= nblocks; i += AESNI_LANES)
+  {
+    __m128i b[AESNI_LANES];
+    for (j = 0; j < AESNI_LANES; ++j)
+    {
+      b[j] = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(blocks + (i + j) * AES_BLOCKLEN)), rk[0]);
+    }
+    for (r = 1; r < AESNI_ROUNDS; ++r)
+    {
+      for (j = 0; j < AESNI_LANES; ++j)
+      {
+        b[j] = _mm_aesenc_si128(b[j], rk[r]);
+      }
+    }
+    for (j = 0; j < AESNI_LANES; ++j)
+    {
+      _mm_storeu_si128((__m128i*)(blocks + (i + j) * AES_BLOCKLEN), _mm_aesenclast_si128(b[j], rk[AESNI_ROUNDS]));
+    }
+  }
+  for (; i < nblocks; ++i)
+  {
+    __m128i b = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(blocks + i * AES_BLOCKLEN)), rk[0]);
+    for (r = 1; r < AESNI_ROUNDS; ++r)
+    {
+      b = _mm_aesenc_si128(b, rk[r]);
+    }
+    _mm_storeu_si128((__m128i*)(blocks + i * AES_BLOCKLEN), _mm_aesenclast_si128(b, rk[AESNI_ROUNDS]));
+  }
+}
+#endif // #if AES_BACKEND_AESNI
+
+// 8 bytes per step; memcpy keeps the loads and stores legal on unaligned
+// buffers and compiles to plain moves
+static void XorWord(uint8_t* dst, const uint8_t* src, size_t length)
+{
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t))
+  {
+    uint64_t a, b;
+    memcpy(&a, dst + i, sizeof(a));
+    memcpy(&b, src + i, sizeof(b));
+    a ^= b;
+    memcpy(dst + i, &a, sizeof(a));
+  }
+  for (; i < length; ++i)
+  {
+    dst[i] ^= src[i];
+  }
+}
+
+// What the mode functions in aes.c do
+static void XorBytewise(uint8_t* dst, const uint8_t* src, size_t length)
+{
+  size_t i;
+  for (i = 0; i < length; ++i)
+  {
+    dst[i] ^= src[i];
+  }
+}
+
+// The bit-serial multiplication of SP 800-38D, algorithm 1. The data-dependent
+// choices are masks, so the time does not depend on Y or H.
+static void GhashPortable(uint8_t* Y, const uint8_t* H, const uint8_t* data, size_t nblocks)
+{
+  const uint64_t h_hi = Load64Be(H), h_lo = Load64Be(H + 8);
+  uint64_t y_hi = Load64Be(Y), y_lo = Load64Be(Y + 8);
+  size_t i;
+  int bit;
+
+  for (i = 0; i < nblocks; ++i, data += AES_BLOCKLEN)
+  {
+    uint64_t z_hi = 0, z_lo = 0, v_hi = h_hi, v_lo = h_lo;
+    y_hi ^= Load64Be(data);
+    y_lo ^= Load64Be(data + 8);
+
+    for (bit = 0; bit < 128; ++bit)
+    {
+      const uint64_t x = (bit < 64) ? (y_hi >> (63 - bit)) : (y_lo >> (127 - bit));
+      const uint64_t take = (uint64_t)0 - (x & 1);
+      const uint64_t reduce = (uint64_t)0 - (v_lo & 1);
+      z_hi ^= v_hi & take;
+      z_lo ^= v_lo & take;
+      v_lo = (v_lo >> 1) | (v_hi << 63);
+      v_hi = (v_hi >> 1) ^ (0xe100000000000000ULL & reduce);
+    }
+    y_hi = z_hi;
+    y_lo = z_lo;
+  }
+  Store64Be(Y, y_hi);
+  Store64Be(Y + 8, y_lo);
+}
+
+#if AES_BACKEND_PCLMUL
+#define PCLMUL __attribute__((target("sse2,ssse3,pclmul")))
+
+static int HavePclmul(void)
+{
+  return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3");
+}
+
+// The GF(2^128) product for GCM on byte-reversed operands, from the Intel
+// carry-less multiplication white paper (algorithm 5): a 256-bit carry-less
+// product, shifted left by one for the bit-reflected order, then reduced
+PCLMUL static __m128i GfMul(__m128i a, __m128i b)
+{
+  __m128i lo = _mm_clmulepi64_si128(a, b, 0x00);
+  __m128i mid = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10), _mm_clmulepi64_si128(a, b, 0x01));
+  __m128i hi = _mm_clmulepi64_si128(a, b, 0x11);
+  __m128i t7, t8, t9, t2;
+
+  lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+  hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+
+  // Shift the product left by one bit
+  t7 = _mm_srli_epi32(lo, 31);
+  t8 = _mm_srli_epi32(hi, 31);
+  lo = _mm_slli_epi32(lo, 1);
+  hi = _mm_slli_epi32(hi, 1);
+  t9 = _mm_srli_si128(t7, 12);
+  t8 = _mm_slli_si128(t8, 4);
+  t7 = _mm_slli_si128(t7, 4);
+  lo = _mm_or_si128(lo, t7);
+  hi = _mm_or_si128(_mm_or_si128(hi, t8), t9);
+
+  // Reduce modulo x^128 + x^7 + x^2 + x + 1
+  t7 = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)), _mm_slli_epi32(lo, 25));
+  t8 = _mm_srli_si128(t7, 4);
+  lo = _mm_xor_si128(lo, _mm_slli_si128(t7, 12));
+  t2 = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)), _mm_srli_epi32(lo, 7));
+  t2 = _mm_xor_si128(t2, t8);
+  lo = _mm_xor_si128(lo, t2);
+  return _mm_xor_si128(hi, lo);
+}
+
+PCLMUL static void GhashPclmul(uint8_t* Y, const uint8_t* H, const uint8_t* data, size_t nblocks)
+{
+  const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+  const __m128i h = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)H), bswap);
+  __m128i y = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)Y), bswap);
+  size_t i;
+
+  for (i = 0; i < nblocks; ++i, data += AES_BLOCKLEN)
+  {
+    y = _mm_xor_si128(y, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)data), bswap));
+    y = GfMul(y, h);
+  }
+  _mm_storeu_si128((__m128i*)Y, _mm_shuffle_epi8(y, bswap));
+}
+#endif // #if AES_BACKEND_PCLMUL
+
+
+/*****************************************************************************/
+/* Registry:                                                                 */
+/*****************************************************************************/
+union kernel
+{
+  AES_block_fn block;
+  AES_xor_fn xor_bytes;
+  AES_ghash_fn ghash;
+};
+
+struct backend
+{
+  const char* name;
+  union kernel fn;
+  int (*available)(void);  // NULL if the kernel runs everywhere
+};
+
+// Best first; each list ends with a NULL name
+static const struct backend block_backends[] = {
+#if AES_BACKEND_AESNI
+  { "aesni", { .block = BlockAesni }, HaveAesni },
+#endif
+  { "portable", { .block = BlockPortable } },
+  { NULL, { NULL } } };
+
+static const struct backend xor_backends[] = {
+  { "word", { .xor_bytes = XorWord } },
+  { "bytewise", { .xor_bytes = XorBytewise } },
+  { NULL, { NULL } } };
+
+static const struct backend ghash_backends[] = {
+#if AES_BACKEND_PCLMUL
+  { "pclmul", { .ghash = GhashPclmul }, HavePclmul },
+#endif
+  { "portable", { .ghash = GhashPortable } },
+  { NULL, { NULL } } };
+
+static const struct backend* const backends[AES_PRIMITIVE_COUNT] = {
+  block_backends, xor_backends, ghash_backends };
+
+static const char* const primitive_names[AES_PRIMITIVE_COUNT] = { "block", "xor", "ghash" };
+
+static atomic_int selected[AES_PRIMITIVE_COUNT];
+
+// 0 = environment not read yet, 1 = being read, 2 = done
+static atomic_int env_state;
+
+static int Available(const struct backend* b)
+{
+  return (b->available == NULL) || b->available();
+}
+
+// Index of the named backend, or -1 if there is none or this CPU cannot run it
+static int FindBackend(enum AES_primitive primitive, const char* name, size_t name_len)
+{
+  int i;
+  for (i = 0; backends[primitive][i].name != NULL; ++i)
+  {
+    if (strlen(backends[primitive][i].name) == name_len &&
+        0 == memcmp(backends[primitive][i].name, name, name_len))
+    {
+      return Available(&backends[primitive][i]) ? i : -1;
+    }
+  }
+  return -1;
+}
+
+// The first backend this CPU can run; the last entry of a non-empty list
+// always can
+static int DefaultBackend(enum AES_primitive primitive)
+{
+  int i = 0;
+  while (backends[primitive][i].name != NULL && !Available(&backends[primitive][i]))
+  {
+    ++i;
+  }
+  return i;
+}
+
+// Parses "primitive=backend[,primitive=backend...]"; unknown entries are ignored
+static void ApplyEnvironment(const char* spec)
+{
+  while (*spec != '\0')
+  {
+    const char* end = strchr(spec, ',');
+    const char* eq = strchr(spec, '=');
+    size_t len = (end != NULL) ? (size_t)(end - spec) : strlen(spec);
+    int p;
+
+    if (eq != NULL && (size_t)(eq - spec) < len)
+    {
+      for (p = 0; p < AES_PRIMITIVE_COUNT; ++p)
+      {
+        if (strlen(primitive_names[p]) == (size_t)(eq - spec) &&
+            0 == memcmp(primitive_names[p], spec, (size_t)(eq - spec)))
+        {
+          int idx = FindBackend((enum AES_primitive)p, eq + 1, len - (size_t)(eq - spec) - 1);
+          if (idx >= 0)
+          {
+            atomic_store_explicit(&selected[p], idx, memory_order_relaxed);
+          }
+        }
+      }
+    }
+    spec += len;
+    if (*spec == ',')
+    {
+      ++spec;
+    }
+  }
+}
+
+static void InitOnce(void)
+{
+  int state = atomic_load_explicit(&env_state, memory_order_acquire);
+  if (state == 2)
+  {
+    return;
+  }
+  state = 0;
+  if (atomic_compare_exchange_strong(&env_state, &state, 1))
+  {
+    const char* spec = getenv(AES_BACKEND_ENV);
+    int p;
+    for (p = 0; p < AES_PRIMITIVE_COUNT; ++p)
+    {
+      atomic_store_explicit(&selected[p], DefaultBackend((enum AES_primitive)p), memory_order_relaxed);
+    }
+    if (spec != NULL)
+    {
+      ApplyEnvironment(spec);
+    }
+    atomic_store_explicit(&env_state, 2, memory_order_release);
+  }
+  else
+  {
+    while (atomic_load_explicit(&env_state, memory_order_acquire) != 2)
+    {
+    }
+  }
+}
+
+static const struct backend* Current(enum AES_primitive primitive)
+{
+  InitOnce();
+  const struct backend* b = &backends[primitive][atomic_load_explicit(&selected[primitive], memory_order_relaxed)];
+  return (b->name != NULL) ? b : NULL;
+}
+
+
+/*****************************************************************************/
+/* Public functions:                                                         */
+/*****************************************************************************/
+const char* AES_primitive_name(enum AES_primitive primitive)
+{
+  return ((unsigned)primitive < AES_PRIMITIVE_COUNT) ? primitive_names[primitive] : "unknown";
+}
+
+size_t AES_backend_count(enum AES_primitive primitive)
+{
+  size_t n = 0;
+  if ((unsigned)primitive < AES_PRIMITIVE_COUNT)
+  {
+    while (backends[primitive][n].name != NULL)
+    {
+      ++n;
+    }
+  }
+  return n;
+}
+
+const char* AES_backend_name(enum AES_primitive primitive, size_t index)
+{
+  return (index < AES_backend_count(primitive)) ? backends[primitive][index].name : NULL;
+}
+
+const char* AES_backend_selected(enum AES_primitive primitive)
+{
+  const struct backend* b;
+  if ((unsigned)primitive >= AES_PRIMITIVE_COUNT)
+  {
+    return NULL;
+  }
+  b = Current(primitive);
+  return (b != NULL) ? b->name : NULL;
+}
+
+int AES_backend_select(enum AES_primitive primitive, const char* name)
+{
+  int idx;
+
+  if ((unsigned)primitive >= AES_PRIMITIVE_COUNT)
+  {
+    return -1;
+  }
+  InitOnce();
+  idx = (name != NULL) ? FindBackend(primitive, name, strlen(name)) : DefaultBackend(primitive);
+  if (idx < 0)
+  {
+    return -1;
+  }
+  atomic_store_explicit(&selected[primitive], idx, memory_order_relaxed);
+  return 0;
+}
+
+AES_block_fn AES_backend_block(void)
+{
+  return Current(AES_PRIMITIVE_BLOCK)->fn.block;
+}
+
+AES_xor_fn AES_backend_xor(void)
+{
+  return Current(AES_PRIMITIVE_XOR)->fn.xor_bytes;
+}
+
+AES_ghash_fn AES_backend_ghash(void)
+{
+  return Current(AES_PRIMITIVE_GHASH)->fn.ghash;
+}
@@ -0,0 +1,57 @@
+#ifndef _AES_BACKEND_H_
+#define _AES_BACKEND_H_
+
+#include "aes.h"
+
+// Kernel selection for the primitives the bulk code paths are built from.
+//
+// Every primitive has a list of backends, best first. By default the first one
+// the CPU can run is used (the "aesni" block kernel needs AES-NI, the "pclmul"
+// GHASH needs PCLMULQDQ). A backend can be forced with AES_backend_select() or,
+// before the first use, through the environment:
+//
+//   TINY_AES_BACKEND="xor=bytewise,block=portable"
+//
+// The selection applies to the kernels built on these primitives
+// (aes_openmp.c and the batch/AEAD code). The mode functions in aes.c are the
+// portable reference implementation and always run as they are.
+
+#define AES_BACKEND_ENV "TINY_AES_BACKEND"
+
+enum AES_primitive
+{
+  AES_PRIMITIVE_BLOCK,  // encrypt a run of independent blocks in place
+  AES_PRIMITIVE_XOR,    // dst ^= src over a byte range (keystream application)
+  AES_PRIMITIVE_GHASH,  // GF(2^128) multiply-accumulate for GCM
+  AES_PRIMITIVE_COUNT
+};
+
+typedef void (*AES_block_fn)(const struct AES_ctx* ctx, uint8_t* blocks, size_t nblocks);
+typedef void (*AES_xor_fn)(uint8_t* dst, const uint8_t* src, size_t length);
+// Y = (Y ^ data[0]) * H, then the same for every following block
+typedef void (*AES_ghash_fn)(uint8_t* Y, const uint8_t* H, const uint8_t* data, size_t nblocks);
+
+// Short lower-case name of a primitive ("block", "xor", "ghash"), as used in the environment variable
+const char* AES_primitive_name(enum AES_primitive primitive);
+
+// Number of backends built in for a primitive, and their names; some may need
+// a CPU feature this machine lacks
+size_t AES_backend_count(enum AES_primitive primitive);
+const char* AES_backend_name(enum AES_primitive primitive, size_t index);  // NULL if index is out of range
+
+// Name of the backend currently in use; NULL if the primitive has no backend in this build
+const char* AES_backend_selected(enum AES_primitive primitive);
+
+// Force a backend by name, or pass NULL to go back to the default.
+// Returns 0 on success, -1 if there is no backend of that name or the CPU
+// cannot run it.
+int AES_backend_select(enum AES_primitive primitive, const char* name);
+
+// The selected kernels, for the code paths that dispatch through them.
+// Fetch once per call, not once per block.
+AES_block_fn AES_backend_block(void);
+AES_xor_fn AES_backend_xor(void);
+AES_ghash_fn AES_backend_ghash(void);
+
+
+#endif // _AES_BACKEND_H_
@@ -0,0 +1,315 @@
+/*
+
+Structure-of-arrays context table and the batch kernels over it.
+
+The state of AES_BATCH_LANES contexts is held byte-sliced, s[j][l] being byte
+j of lane l, so every step of a round is a loop over the lanes of one byte
+position: SubBytes is a table lookup per lane, MixColumns and AddRoundKey are
+element-wise and vectorize, and ShiftRows only changes which byte position is
+read.
+
+*/
+
+#include <string.h>
+#include "aes.h"
+#include "aes_batch.h"
+#include "aes_tables.h"
+#include "aes_instrument.h"
+#include "aes_util.h"
+
+typedef uint8_t lanes_t[AES_BLOCKLEN][AES_BATCH_LANES];
+
+static size_t Stride(size_t capacity)
+{
+  return (capacity + AES_BATCH_LANES - 1) / AES_BATCH_LANES * AES_BATCH_LANES;
+}
+
+static uint8_t xtime(uint8_t x)
+{
+  return (uint8_t)((x << 1) ^ (((x >> 7) & 1) * 0x1b));
+}
+
+static void AddRoundKey(lanes_t s, const uint8_t* rk, size_t stride, size_t n)
+{
+  size_t j, l;
+  for (j = 0; j < AES_BLOCKLEN; ++j)
+  {
+    for (l = 0; l < n; ++l)
+    {
+      s[j][l] ^= rk[j * stride + l];
+    }
+  }
+}
+
+// Encrypts the n lane states in s; lane l uses the round keys at rk + l, byte
+// j of round key r being stride * (r * AES_BLOCKLEN + j) further on
+static void EncryptLanes(const uint8_t* rk, size_t stride, size_t n, lanes_t s)
+{
+  lanes_t u;
+  size_t r, j, c, l;
+
+  AddRoundKey(s, rk, stride, n);
+  for (r = 1; r < AES_BATCH_ROUND_KEYS; ++r)
+  {
+    // SubBytes and ShiftRows: row j % 4 of a column comes from the column j % 4 further on
+    for (j = 0; j < AES_BLOCKLEN; ++j)
+    {
+      const uint8_t* src = s[(j + 4 * (j & 3)) & 15];
+      for (l = 0; l < n; ++l)
+      {
+        u[j][l] = aes_sbox[src[l]];
+      }
+    }
+
+    if (r + 1 < AES_BATCH_ROUND_KEYS)
+    {
+      for (c = 0; c < 4; ++c)
+      {
+        uint8_t* a0 = u[4 * c];
+        uint8_t* a1 = u[4 * c + 1];
+        uint8_t* a2 = u[4 * c + 2];
+        uint8_t* a3 = u[4 * c + 3];
+        for (l = 0; l < n; ++l)
+        {
+          const uint8_t all = a0[l] ^ a1[l] ^ a2[l] ^ a3[l];
+          s[4 * c][l]     = a0[l] ^ all ^ xtime(a0[l] ^ a1[l]);
+          s[4 * c + 1][l] = a1[l] ^ all ^ xtime(a1[l] ^ a2[l]);
+          s[4 * c + 2][l] = a2[l] ^ all ^ xtime(a2[l] ^ a3[l]);
+          s[4 * c + 3][l] = a3[l] ^ all ^ xtime(a3[l] ^ a0[l]);
+        }
+      }
+    }
+    else
+    {
+      memcpy(s, u, sizeof(lanes_t));
+    }
+
+    AddRoundKey(s, rk + r * AES_BLOCKLEN * stride, stride, n);
+  }
+}
+
+
+/*****************************************************************************/
+/* Public functions:                                                         */
+/*****************************************************************************/
+size_t AES_batch_size(size_t capacity)
+{
+  return (AES_BATCH_ROUND_KEYS + 1) * AES_BLOCKLEN * Stride(capacity);
+}
+
+void AES_batch_init(struct AES_batch* table, void* memory, size_t capacity)
+{
+  table->capacity = capacity;
+  table->stride = Stride(capacity);
+  table->round_keys = (uint8_t*)memory;
+  table->iv = table->round_keys + AES_BATCH_ROUND_KEYS * AES_BLOCKLEN * table->stride;
+  memset(memory, 0, AES_batch_size(capacity));
+}
+
+void AES_batch_load(struct AES_batch* table, size_t index, const struct AES_ctx* ctx)
+{
+  size_t k;
+  for (k = 0; k < AES_BATCH_ROUND_KEYS * AES_BLOCKLEN; ++k)
+  {
+    table->round_keys[k * table->stride + index] = ctx->RoundKey[k];
+  }
+#if (defined(CBC) && (CBC == 1)) || (defined(CTR) && (CTR == 1))
+  AES_batch_set_iv(table, index, ctx->Iv);
+#endif
+}
+
+void AES_batch_store(const struct AES_batch* table, size_t index, struct AES_ctx* ctx)
+{
+  size_t k;
+  for (k = 0; k < AES_BATCH_ROUND_KEYS * AES_BLOCKLEN; ++k)
+  {
+    ctx->RoundKey[k] = table->round_keys[k * table->stride + index];
+  }
+#if (defined(CBC) && (CBC == 1)) || (defined(CTR) && (CTR == 1))
+  for (k = 0; k < AES_BLOCKLEN; ++k)
+  {
+    ctx->Iv[k] = table->iv[k * table->stride + index];
+  }
+#endif
+}
+
+void AES_batch_set_key(struct AES_batch* table, size_t index, const uint8_t* key)
+{
+  struct AES_ctx ctx;
+  size_t k;
+  AES_init_ctx(&ctx, key);
+  for (k = 0; k < AES_BATCH_ROUND_KEYS * AES_BLOCKLEN; ++k)
+  {
+    table->round_keys[k * table->stride + index] = ctx.RoundKey[k];
+  }
+  Wipe(&ctx, sizeof(ctx));
+}
+
+void AES_batch_set_iv(struct AES_batch* table, size_t index, const uint8_t* iv)
+{
+  size_t j;
+  for (j = 0; j < AES_BLOCKLEN; ++j)
+  {
+    table->iv[j * table->stride + index] = iv[j];
+  }
+}
+
+void AES_batch_ECB_encrypt(const struct AES_batch* table, size_t first, size_t count, uint8_t* blocks)
+{
+  lanes_t s;
+  size_t g, j, l;
+
+  AES_KERNEL_ENTER(batch_ecb_encrypt, count * AES_BLOCKLEN, 0, AES_STATS_BATCH);
+  for (g = 0; g < count; g += AES_BATCH_LANES)
+  {
+    const size_t n = (count - g < AES_BATCH_LANES) ? (count - g) : AES_BATCH_LANES;
+    uint8_t* b = blocks + g * AES_BLOCKLEN;
+
+    for (l = 0; l < n; ++l)
+    {
+      for (j = 0; j < AES_BLOCKLEN; ++j)
+      {
+        s[j][l] = b[l * AES_BLOCKLEN + j];
+      }
+    }
+    EncryptLanes(table->round_keys + first + g, table->stride, n, s);
+    for (l = 0; l < n; ++l)
+    {
+      for (j = 0; j < AES_BLOCKLEN; ++j)
+      {
+        b[l * AES_BLOCKLEN + j] = s[j][l];
+      }
+    }
+  }
+  AES_KERNEL_EXIT(batch_ecb_encrypt, AES_STATS_ECB_ENCRYPT, count * AES_BLOCKLEN, 0, AES_STATS_BATCH);
+}
+
+void AES_batch_CTR_xcrypt(struct AES_batch* table, size_t first, size_t count, uint8_t* const* bufs, const size_t* lengths)
+{
+  const size_t stride = table->stride;
+  lanes_t counter, s;
+  size_t g, j, l, offset, total = 0;
+
+  for (l = 0; l < count; ++l)
+  {
+    total += lengths[l];
+  }
+
+  AES_KERNEL_ENTER(batch_ctr, total, 0, AES_STATS_BATCH);
+  for (g = 0; g < count; g += AES_BATCH_LANES)
+  {
+    const size_t n = (count - g < AES_BATCH_LANES) ? (count - g) : AES_BATCH_LANES;
+    size_t longest = 0;
+
+    for (j = 0; j < AES_BLOCKLEN; ++j)
+    {
+      memcpy(counter[j], table->iv + j * stride + first + g, n);
+    }
+    for (l = 0; l < n; ++l)
+    {
+      longest = (lengths[g + l] > longest) ? lengths[g + l] : longest;
+    }
+
+    // One counter block of every lane per step; lanes whose buffer has ended
+    // are encrypted along but neither applied nor advanced
+    for (offset = 0; offset < longest; offset += AES_BLOCKLEN)
+    {
+      memcpy(s, counter, sizeof(lanes_t));
+      EncryptLanes(table->round_keys + first + g, stride, n, s);
+
+      for (l = 0; l < n; ++l)
+      {
+        if (offset < lengths[g + l])
+        {
+          uint8_t* buf = bufs[g + l] + offset;
+          const size_t m = (lengths[g + l] - offset < AES_BLOCKLEN) ? (lengths[g + l] - offset) : AES_BLOCKLEN;
+          int bi;
+
+          for (j = 0; j < m; ++j)
+          {
+            buf[j] ^= s[j][l];
+          }
+          for (bi = AES_BLOCKLEN - 1; bi >= 0 && ++counter[bi][l] == 0; --bi)
+          {
+          }
+        }
+      }
+    }
+
+    for (j = 0; j < AES_BLOCKLEN; ++j)
+    {
+      memcpy(table->iv + j * stride + first + g, counter[j], n);
+    }
+  }
+  AES_KERNEL_EXIT(batch_ctr, AES_STATS_CTR, total, 0, AES_STATS_BATCH);
+}
+
+// Encrypts n counter blocks under the broadcast key rk and XORs them into dst
+static void ApplyKeystream(const uint8_t* rk, size_t n, lanes_t s, uint8_t* const* dst, const size_t* len)
+{
+  size_t j, l;
+  EncryptLanes(rk, AES_BATCH_LANES, n, s);
+  for (l = 0; l < n; ++l)
+  {
+    for (j = 0; j < len[l]; ++j)
+    {
+      dst[l][j] ^= s[j][l];
+    }
+  }
+}
+
+void AES_batch_CTR_packets(const struct AES_ctx* ctx, size_t count, const uint8_t* const* ivs, uint8_t* const* bufs, const size_t* lengths)
+{
+  // The one key broadcast to every lane, in the table layout with stride AES_BATCH_LANES
+  uint8_t rk[AES_BATCH_ROUND_KEYS * AES_BLOCKLEN][AES_BATCH_LANES];
+  uint8_t counter[AES_BLOCKLEN];
+  uint8_t* dst[AES_BATCH_LANES];
+  size_t len[AES_BATCH_LANES];
+  lanes_t s;
+  size_t i, j, n = 0, total = 0;
+
+  for (i = 0; i < count; ++i)
+  {
+    total += lengths[i];
+  }
+
+  AES_KERNEL_ENTER(batch_ctr_packets, total, 0, AES_STATS_BATCH);
+  for (j = 0; j < AES_BATCH_ROUND_KEYS * AES_BLOCKLEN; ++j)
+  {
+    memset(rk[j], ctx->RoundKey[j], AES_BATCH_LANES);
+  }
+
+  // Counter blocks of consecutive packets share a lane group, so a group only
+  // waits for AES_BATCH_LANES blocks, not for a packet boundary
+  for (i = 0; i < count; ++i)
+  {
+    size_t offset;
+    int bi;
+
+    memcpy(counter, ivs[i], AES_BLOCKLEN);
+    for (offset = 0; offset < lengths[i]; offset += AES_BLOCKLEN)
+    {
+      for (j = 0; j < AES_BLOCKLEN; ++j)
+      {
+        s[j][n] = counter[j];
+      }
+      dst[n] = bufs[i] + offset;
+      len[n] = (lengths[i] - offset < AES_BLOCKLEN) ? (lengths[i] - offset) : AES_BLOCKLEN;
+      for (bi = AES_BLOCKLEN - 1; bi >= 0 && ++counter[bi] == 0; --bi)
+      {
+      }
+
+      if (++n == AES_BATCH_LANES)
+      {
+        ApplyKeystream(&rk[0][0], n, s, dst, len);
+        n = 0;
+      }
+    }
+  }
+  if (n > 0)
+  {
+    ApplyKeystream(&rk[0][0], n, s, dst, len);
+  }
+  Wipe(rk, sizeof(rk));
+  AES_KERNEL_EXIT(batch_ctr_packets, AES_STATS_CTR, total, 0, AES_STATS_BATCH);
+}
@@ -0,0 +1,73 @@
+#ifndef _AES_BATCH_H_
+#define _AES_BATCH_H_
+
+#include "aes.h"
+
+// Structure-of-arrays table of many contexts, for workloads that encrypt a
+// little under each of a large number of keys.
+//
+// An array of struct AES_ctx interleaves every context's round keys and IV, so
+// an operation over many keys touches scattered cache lines. The table stores
+// byte j of round key r of all contexts next to each other:
+//
+//   round_keys[(r * AES_BLOCKLEN + j) * stride + i]    context i
+//   iv[j * stride + i]
+//
+// The batch kernels run AES_BATCH_LANES contexts side by side through the
+// rounds, one byte position at a time, so every round-key load is one
+// contiguous run over the lanes that the compiler can vectorize, and the next
+// group of contexts can be prefetched as a unit.
+//
+// The table does not allocate: AES_batch_size() says how much memory it needs
+// and the caller passes that in (64-byte aligned memory is best).
+
+// Contexts processed side by side by the batch kernels
+#ifndef AES_BATCH_LANES
+  #define AES_BATCH_LANES 16
+#endif
+
+// Round keys per context, the initial AddRoundKey included
+#define AES_BATCH_ROUND_KEYS (AES_keyExpSize / AES_BLOCKLEN)
+
+struct AES_batch
+{
+  size_t capacity;      // contexts the table holds
+  size_t stride;        // distance between byte j of consecutive round keys; capacity rounded up
+  uint8_t* round_keys;  // AES_BATCH_ROUND_KEYS * AES_BLOCKLEN * stride bytes
+  uint8_t* iv;          // AES_BLOCKLEN * stride bytes
+};
+
+// Bytes of memory AES_batch_init() needs for capacity contexts
+size_t AES_batch_size(size_t capacity);
+
+// Lays the table out in memory (AES_batch_size(capacity) bytes), which the
+// table uses until the caller frees it. All contexts start zeroed.
+void AES_batch_init(struct AES_batch* table, void* memory, size_t capacity);
+
+// Set up context index like AES_init_ctx()/AES_ctx_set_iv() would
+void AES_batch_set_key(struct AES_batch* table, size_t index, const uint8_t* key);
+void AES_batch_set_iv(struct AES_batch* table, size_t index, const uint8_t* iv);
+
+// Copy a context in from, or out to, a struct AES_ctx
+void AES_batch_load(struct AES_batch* table, size_t index, const struct AES_ctx* ctx);
+void AES_batch_store(const struct AES_batch* table, size_t index, struct AES_ctx* ctx);
+
+// Encrypts blocks[i] (16 bytes each, back to back) under context first + i,
+// for i < count.
+void AES_batch_ECB_encrypt(const struct AES_batch* table, size_t first, size_t count, uint8_t* blocks);
+
+// For i < count, runs AES_CTR_xcrypt_buffer() on bufs[i] / lengths[i] with
+// context first + i: same output, and the context's IV is advanced the same
+// way. The counter blocks of up to AES_BATCH_LANES contexts are encrypted
+// together.
+void AES_batch_CTR_xcrypt(struct AES_batch* table, size_t first, size_t count, uint8_t* const* bufs, const size_t* lengths);
+
+// Packet-vector CTR under the one key in ctx: for i < count, encrypts bufs[i] /
+// lengths[i] as AES_CTR_xcrypt_buffer() would from the initial counter block
+// ivs[i]. The counter blocks of all the packets are queued into the lanes of
+// the batch kernel back to back, a packet's partial last block included, so a
+// short packet does not leave the other lanes idle. ctx and ivs are not changed.
+void AES_batch_CTR_packets(const struct AES_ctx* ctx, size_t count, const uint8_t* const* ivs, uint8_t* const* bufs, const size_t* lengths);
+
+
+#endif // _AES_BATCH_H_
@@ -0,0 +1,220 @@
+/*
+
+CTR_DRBG (NIST SP 800-90A, section 10.2.1) without the derivation function.
+
+Every generate request is: optional Update with the additional input, the
+keystream of V+1, V+2, ... under K as output, then Update. The keystream part
+only needs K and V, so AES_drbg_reserve() splits a request into a snapshot
+that produces the output and the state after the request - which is what lets
+aes_openmp.c produce many requests at once.
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "aes.h"
+#include "aes_drbg.h"
+#include "aes_backend.h"
+#include "aes_util.h"
+
+// CTR_DRBG_Update: (K, V) = leftmost/rightmost bits of the keystream after V,
+// XORed with provided (provided_len <= AES_DRBG_SEEDLEN, zero-padded)
+static void Update(struct AES_drbg* drbg, const uint8_t* provided, size_t provided_len)
+{
+  uint8_t temp[(AES_DRBG_SEEDLEN + AES_BLOCKLEN - 1) / AES_BLOCKLEN * AES_BLOCKLEN];
+  size_t i;
+
+  AES_drbg_output(drbg, temp, AES_DRBG_SEEDLEN);
+  for (i = 0; i < provided_len; ++i)
+  {
+    temp[i] ^= provided[i];
+  }
+  AES_init_ctx(&drbg->ctx, temp);
+  memcpy(drbg->V, temp + AES_KEYLEN, AES_BLOCKLEN);
+  Wipe(temp, sizeof(temp));
+}
+
+// seed, or AES_DRBG_SEEDLEN bytes from the source, XORed with extra
+static int SeedMaterial(const struct AES_drbg* drbg, uint8_t* material, const uint8_t* seed,
+                        const uint8_t* extra, size_t extra_len)
+{
+  size_t i;
+
+  if (extra_len > AES_DRBG_SEEDLEN || (extra_len > 0 && extra == NULL))
+  {
+    return -1;
+  }
+  if (seed != NULL)
+  {
+    memcpy(material, seed, AES_DRBG_SEEDLEN);
+  }
+  else if (drbg->entropy == NULL || drbg->entropy(drbg->entropy_arg, material, AES_DRBG_SEEDLEN) != 0)
+  {
+    return -1;
+  }
+  for (i = 0; i < extra_len; ++i)
+  {
+    material[i] ^= extra[i];
+  }
+  return 0;
+}
+
+// Whether a generate request may go ahead, reseeding from the source if one is due
+static int Ready(struct AES_drbg* drbg)
+{
+  if (drbg->reseed_counter > drbg->reseed_interval)
+  {
+    return AES_drbg_reseed(drbg, NULL, NULL, 0);
+  }
+  return 0;
+}
+
+
+/*****************************************************************************/
+/* Public functions:                                                         */
+/*****************************************************************************/
+int AES_drbg_system_entropy(void* arg, uint8_t* out, size_t length)
+{
+  FILE* f = fopen("/dev/urandom", "rb");
+  size_t got = 0;
+
+  (void)arg;
+  if (f != NULL)
+  {
+    got = fread(out, 1, length, f);
+    fclose(f);
+  }
+  return (got == length) ? 0 : -1;
+}
+
+int AES_drbg_instantiate(struct AES_drbg* drbg, AES_drbg_entropy_fn entropy, void* entropy_arg,
+                         const uint8_t* seed, const uint8_t* personalization, size_t personalization_len)
+{
+  uint8_t material[AES_DRBG_SEEDLEN];
+  static const uint8_t zero_key[AES_KEYLEN];
+
+  drbg->entropy = entropy;
+  drbg->entropy_arg = entropy_arg;
+  drbg->reseed_interval = AES_DRBG_RESEED_INTERVAL;
+  if (SeedMaterial(drbg, material, seed, personalization, personalization_len) != 0)
+  {
+    return -1;
+  }
+
+  AES_init_ctx(&drbg->ctx, zero_key);
+  memset(drbg->V, 0, AES_BLOCKLEN);
+  Update(drbg, material, AES_DRBG_SEEDLEN);
+  drbg->reseed_counter = 1;
+  Wipe(material, sizeof(material));
+  return 0;
+}
+
+int AES_drbg_reseed(struct AES_drbg* drbg, const uint8_t* seed, const uint8_t* additional, size_t additional_len)
+{
+  uint8_t material[AES_DRBG_SEEDLEN];
+
+  if (SeedMaterial(drbg, material, seed, additional, additional_len) != 0)
+  {
+    return -1;
+  }
+  Update(drbg, material, AES_DRBG_SEEDLEN);
+  drbg->reseed_counter = 1;
+  Wipe(material, sizeof(material));
+  return 0;
+}
+
+int AES_drbg_generate(struct AES_drbg* drbg, uint8_t* out, size_t length, const uint8_t* additional, size_t additional_len)
+{
+  if (length > AES_DRBG_MAX_REQUEST || additional_len > AES_DRBG_SEEDLEN ||
+      (additional_len > 0 && additional == NULL) || Ready(drbg) != 0)
+  {
+    return -1;
+  }
+
+  if (additional_len > 0)
+  {
+    Update(drbg, additional, additional_len);
+  }
+  AES_drbg_output(drbg, out, length);
+  IncrementBy(drbg->V, (length + AES_BLOCKLEN - 1) / AES_BLOCKLEN);
+  Update(drbg, additional, additional_len);
+  drbg->reseed_counter += 1;
+  return 0;
+}
+
+int AES_drbg_fill(struct AES_drbg* drbg, uint8_t* out, size_t length)
+{
+  while (length > 0)
+  {
+    const size_t n = (length < AES_DRBG_MAX_REQUEST) ? length : AES_DRBG_MAX_REQUEST;
+    if (AES_drbg_generate(drbg, out, n, NULL, 0) != 0)
+    {
+      return -1;
+    }
+    out += n;
+    length -= n;
+  }
+  return 0;
+}
+
+int AES_drbg_reserve(struct AES_drbg* drbg, struct AES_drbg* snapshot, size_t length)
+{
+  if (length > AES_DRBG_MAX_REQUEST || Ready(drbg) != 0)
+  {
+    return -1;
+  }
+
+  *snapshot = *drbg;
+  IncrementBy(drbg->V, (length + AES_BLOCKLEN - 1) / AES_BLOCKLEN);
+  Update(drbg, NULL, 0);
+  drbg->reseed_counter += 1;
+  return 0;
+}
+
+void AES_drbg_output(const struct AES_drbg* snapshot, uint8_t* out, size_t length)
+{
+  const AES_block_fn encrypt_blocks = AES_backend_block();
+  const size_t full = length / AES_BLOCKLEN;
+  uint8_t counter[AES_BLOCKLEN];
+  size_t i;
+
+  // The counter blocks go straight into out and are encrypted in place
+  memcpy(counter, snapshot->V, AES_BLOCKLEN);
+  for (i = 0; i < full; ++i)
+  {
+    Increment(counter);
+    memcpy(out + i * AES_BLOCKLEN, counter, AES_BLOCKLEN);
+  }
+  encrypt_blocks(&snapshot->ctx, out, full);
+
+  if (length % AES_BLOCKLEN)
+  {
+    uint8_t last[AES_BLOCKLEN];
+    Increment(counter);
+    memcpy(last, counter, AES_BLOCKLEN);
+    encrypt_blocks(&snapshot->ctx, last, 1);
+    memcpy(out + full * AES_BLOCKLEN, last, length % AES_BLOCKLEN);
+    Wipe(last, sizeof(last));
+  }
+}
+
+void AES_drbg_uninstantiate(struct AES_drbg* drbg)
+{
+  Wipe(drbg, sizeof(*drbg));
+}
+
+struct AES_drbg* AES_drbg_thread(void)
+{
+  static _Thread_local struct AES_drbg state;
+  static _Thread_local int ready;
+
+  if (!ready)
+  {
+    if (AES_drbg_instantiate(&state, AES_drbg_system_entropy, NULL, NULL, NULL, 0) != 0)
+    {
+      return NULL;
+    }
+    ready = 1;
+  }
+  return &state;
+}
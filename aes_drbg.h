@@ -0,0 +1,84 @@
+#ifndef _AES_DRBG_H_
+#define _AES_DRBG_H_
+
+#include <stdint.h>
+#include "aes.h"
+
+// CTR_DRBG from NIST SP 800-90A on the block cipher of this build (AES-128,
+// -192 or -256), without the derivation function: seed material is full
+// entropy of AES_DRBG_SEEDLEN bytes, and personalization strings and
+// additional input are at most that long.
+//
+// Output is the CTR keystream E(K, V+1), E(K, V+2), ..., so the blocks of one
+// request are independent. Generation lays the counter blocks out in the
+// output buffer and encrypts them in place with the selected block kernel
+// (aes_backend.h); AES_drbg_fill_openmp() in aes_openmp.h splits very large
+// fills over threads.
+//
+// A state is not thread-safe. AES_drbg_thread() gives each thread its own.
+
+// Key and V
+#define AES_DRBG_SEEDLEN (AES_KEYLEN + AES_BLOCKLEN)
+
+// Most bytes one AES_drbg_generate() may return: 2^19 bits
+#define AES_DRBG_MAX_REQUEST 65536
+
+// Generate requests between reseeds; SP 800-90A allows up to 2^48
+#ifndef AES_DRBG_RESEED_INTERVAL
+  #define AES_DRBG_RESEED_INTERVAL (1ULL << 32)
+#endif
+
+// Writes length bytes of full entropy to out; returns 0 on success
+typedef int (*AES_drbg_entropy_fn)(void* arg, uint8_t* out, size_t length);
+
+struct AES_drbg
+{
+  struct AES_ctx ctx;                // K, expanded
+  uint8_t V[AES_BLOCKLEN];
+  uint64_t reseed_counter;
+  uint64_t reseed_interval;          // reseed when reseed_counter exceeds this
+  AES_drbg_entropy_fn entropy;       // reseed source; NULL means reseed by hand
+  void* entropy_arg;
+};
+
+// Reads /dev/urandom; returns -1 where there is none
+int AES_drbg_system_entropy(void* arg, uint8_t* out, size_t length);
+
+// Instantiates from seed (AES_DRBG_SEEDLEN bytes), or from the entropy source
+// when seed is NULL. entropy is kept for reseeding and may be NULL, in which
+// case AES_drbg_generate() fails once the reseed interval has passed until
+// AES_drbg_reseed() is called with a seed. Returns 0, or -1 when the source
+// failed or the personalization string is too long.
+int AES_drbg_instantiate(struct AES_drbg* drbg, AES_drbg_entropy_fn entropy, void* entropy_arg,
+                         const uint8_t* seed, const uint8_t* personalization, size_t personalization_len);
+
+// Reseeds from seed, or from the entropy source when seed is NULL
+int AES_drbg_reseed(struct AES_drbg* drbg, const uint8_t* seed, const uint8_t* additional, size_t additional_len);
+
+// Writes length (at most AES_DRBG_MAX_REQUEST) random bytes to out, reseeding
+// from the entropy source when the interval has passed. Returns 0, or -1 when
+// a reseed was due and failed, or an argument is out of range.
+int AES_drbg_generate(struct AES_drbg* drbg, uint8_t* out, size_t length, const uint8_t* additional, size_t additional_len);
+
+// Any length, as consecutive AES_drbg_generate() calls of AES_DRBG_MAX_REQUEST
+// bytes (the last one shorter) without additional input
+int AES_drbg_fill(struct AES_drbg* drbg, uint8_t* out, size_t length);
+
+// The split of a generate request used by the parallel fill: copies the state
+// the request's output comes from to *snapshot and moves drbg past the request
+// as AES_drbg_generate() would, without producing output. The output is then
+// AES_drbg_output(snapshot, ...), from any thread and in any order.
+int AES_drbg_reserve(struct AES_drbg* drbg, struct AES_drbg* snapshot, size_t length);
+
+// Writes the length bytes of output that follow snapshot's V
+void AES_drbg_output(const struct AES_drbg* snapshot, uint8_t* out, size_t length);
+
+// Wipes the state
+void AES_drbg_uninstantiate(struct AES_drbg* drbg);
+
+// The calling thread's own state, instantiated from AES_drbg_system_entropy()
+// on first use; NULL if that failed
+struct AES_drbg* AES_drbg_thread(void);
+
+
+#endif // _AES_DRBG_H_
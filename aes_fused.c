@@ -0,0 +1,343 @@
+/*
+
+Fused passes over one buffer (aes_fused.h).
+
+The CTR re-encryption keeps a tile of AES_FUSED_TILE_BLOCKS keystream blocks
+per key in L1, XORs the two tiles and applies the result, so buf is read and
+written once where the two AES_CTR_xcrypt_buffer() calls it replaces sweep it
+twice.
+
+The checksumming kernels work the same way: a tile is encrypted or decrypted
+and its ciphertext run through CRC32C while it is still in L1.
+
+*/
+
+#include <string.h>
+#include <stdatomic.h>
+#include "aes.h"
+#include "aes_fused.h"
+#include "aes_backend.h"
+#include "aes_instrument.h"
+#include "aes_util.h"
+
+// CRC32C with the SSE4.2 crc32 instruction when the CPU has it
+#ifndef AES_FUSED_SSE42
+  #if defined(__x86_64__) && defined(__GNUC__)
+    #define AES_FUSED_SSE42 1
+  #else
+    #define AES_FUSED_SSE42 0
+  #endif
+#endif
+
+#if AES_FUSED_SSE42
+  #include <nmmintrin.h>
+#endif
+
+// Reflected Castagnoli polynomial
+#define CRC32C_POLY 0x82f63b78u
+
+// Slicing-by-8 tables: crc_table[k][n] is the CRC of byte n followed by k zero bytes
+static uint32_t crc_table[8][256];
+// 0 = not built, 1 = being built, 2 = done
+static atomic_int crc_table_state;
+
+static void CrcTableInit(void)
+{
+  int expected = 0;
+  uint32_t c;
+  int n, k;
+
+  if (atomic_load_explicit(&crc_table_state, memory_order_acquire) == 2)
+  {
+    return;
+  }
+  if (!atomic_compare_exchange_strong(&crc_table_state, &expected, 1))
+  {
+    while (atomic_load_explicit(&crc_table_state, memory_order_acquire) != 2)
+    {
+    }
+    return;
+  }
+
+  for (n = 0; n < 256; ++n)
+  {
+    c = (uint32_t)n;
+    for (k = 0; k < 8; ++k)
+    {
+      c = (c & 1) ? (c >> 1) ^ CRC32C_POLY : (c >> 1);
+    }
+    crc_table[0][n] = c;
+  }
+  for (n = 0; n < 256; ++n)
+  {
+    c = crc_table[0][n];
+    for (k = 1; k < 8; ++k)
+    {
+      c = crc_table[0][c & 0xff] ^ (c >> 8);
+      crc_table[k][n] = c;
+    }
+  }
+  atomic_store_explicit(&crc_table_state, 2, memory_order_release);
+}
+
+// c is the running CRC without the inversions
+static uint32_t CrcPortable(uint32_t c, const uint8_t* p, size_t length)
+{
+  CrcTableInit();
+  for (; length >= 8; p += 8, length -= 8)
+  {
+    const uint32_t lo = c ^ ((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+    const uint32_t hi = (uint32_t)p[4] | ((uint32_t)p[5] << 8) | ((uint32_t)p[6] << 16) | ((uint32_t)p[7] << 24);
+    c = crc_table[7][lo & 0xff] ^ crc_table[6][(lo >> 8) & 0xff] ^
+        crc_table[5][(lo >> 16) & 0xff] ^ crc_table[4][lo >> 24] ^
+        crc_table[3][hi & 0xff] ^ crc_table[2][(hi >> 8) & 0xff] ^
+        crc_table[1][(hi >> 16) & 0xff] ^ crc_table[0][hi >> 24];
+  }
+  for (; length > 0; --length)
+  {
+    c = crc_table[0][(c ^ *p++) & 0xff] ^ (c >> 8);
+  }
+  return c;
+}
+
+#if AES_FUSED_SSE42
+__attribute__((target("sse4.2")))
+static uint32_t CrcSse42(uint32_t c, const uint8_t* p, size_t length)
+{
+  uint64_t c64 = c;
+  for (; length >= 8; p += 8, length -= 8)
+  {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    c64 = _mm_crc32_u64(c64, v);
+  }
+  c = (uint32_t)c64;
+  for (; length > 0; --length)
+  {
+    c = _mm_crc32_u8(c, *p++);
+  }
+  return c;
+}
+#endif
+
+// a * b modulo the polynomial, bit-reflected (bit 31 is x^0)
+static uint32_t MultModP(uint32_t a, uint32_t b)
+{
+  uint32_t m = 1u << 31, p = 0;
+  for (;;)
+  {
+    if (a & m)
+    {
+      p ^= b;
+      if ((a & (m - 1)) == 0)
+      {
+        break;
+      }
+    }
+    m >>= 1;
+    b = (b & 1) ? (b >> 1) ^ CRC32C_POLY : (b >> 1);
+  }
+  return p;
+}
+
+// x^(8n) modulo the polynomial
+static uint32_t XPow8n(size_t n)
+{
+  uint32_t p = 1u << 31;   // x^0
+  uint32_t sq = 1u << 23;  // x^8
+  for (; n > 0; n >>= 1)
+  {
+    if (n & 1)
+    {
+      p = MultModP(sq, p);
+    }
+    sq = MultModP(sq, sq);
+  }
+  return p;
+}
+
+#if defined(CTR) && (CTR == 1)
+// The CTR pass, checksumming the output (encryption) or the input (decryption)
+static void CtrCrc32c(struct AES_ctx* ctx, uint8_t* buf, size_t length, uint32_t* crc, int of_output)
+{
+  const AES_block_fn encrypt_blocks = AES_backend_block();
+  const AES_xor_fn xor_bytes = AES_backend_xor();
+  uint8_t stream[AES_FUSED_TILE_BLOCKS * AES_BLOCKLEN];
+  uint32_t c = *crc;
+  size_t done, i;
+
+  AES_KERNEL_ENTER(ctr_crc32c, length, 0, AES_STATS_SEQUENTIAL);
+  for (done = 0; done < length; )
+  {
+    const size_t n = (length - done < sizeof(stream)) ? (length - done) : sizeof(stream);
+    const size_t blocks = (n + AES_BLOCKLEN - 1) / AES_BLOCKLEN;
+
+    for (i = 0; i < blocks; ++i)
+    {
+      memcpy(stream + i * AES_BLOCKLEN, ctx->Iv, AES_BLOCKLEN);
+      Increment(ctx->Iv);
+    }
+    encrypt_blocks(ctx, stream, blocks);
+
+    if (!of_output)
+    {
+      c = AES_crc32c(c, buf + done, n);
+    }
+    xor_bytes(buf + done, stream, n);
+    if (of_output)
+    {
+      c = AES_crc32c(c, buf + done, n);
+    }
+    done += n;
+  }
+  *crc = c;
+  Wipe(stream, sizeof(stream));
+  AES_KERNEL_EXIT(ctr_crc32c, AES_STATS_CTR, length, 0, AES_STATS_SEQUENTIAL);
+}
+#endif // #if defined(CTR) && (CTR == 1)
+
+
+/*****************************************************************************/
+/* Public functions:                                                         */
+/*****************************************************************************/
+#if defined(CTR) && (CTR == 1)
+void AES_CTR_reencrypt_buffer(struct AES_ctx* from, struct AES_ctx* to, uint8_t* buf, size_t length)
+{
+  const AES_block_fn encrypt_blocks = AES_backend_block();
+  const AES_xor_fn xor_bytes = AES_backend_xor();
+  uint8_t old_stream[AES_FUSED_TILE_BLOCKS * AES_BLOCKLEN];
+  uint8_t new_stream[AES_FUSED_TILE_BLOCKS * AES_BLOCKLEN];
+  size_t done, i;
+
+  AES_KERNEL_ENTER(ctr_reencrypt, length, 0, AES_STATS_SEQUENTIAL);
+  for (done = 0; done < length; )
+  {
+    const size_t n = (length - done < sizeof(old_stream)) ? (length - done) : sizeof(old_stream);
+    const size_t blocks = (n + AES_BLOCKLEN - 1) / AES_BLOCKLEN;
+
+    for (i = 0; i < blocks; ++i)
+    {
+      memcpy(old_stream + i * AES_BLOCKLEN, from->Iv, AES_BLOCKLEN);
+      memcpy(new_stream + i * AES_BLOCKLEN, to->Iv, AES_BLOCKLEN);
+      Increment(from->Iv);
+      Increment(to->Iv);
+    }
+    encrypt_blocks(from, old_stream, blocks);
+    encrypt_blocks(to, new_stream, blocks);
+
+    xor_bytes(old_stream, new_stream, n);
+    xor_bytes(buf + done, old_stream, n);
+    done += n;
+  }
+  Wipe(old_stream, sizeof(old_stream));
+  Wipe(new_stream, sizeof(new_stream));
+  AES_KERNEL_EXIT(ctr_reencrypt, AES_STATS_CTR, length, 0, AES_STATS_SEQUENTIAL);
+}
+#endif // #if defined(CTR) && (CTR == 1)
+
+#if defined(CBC) && (CBC == 1)
+void AES_CBC_reencrypt_buffer(struct AES_ctx* from, struct AES_ctx* to, uint8_t* buf, size_t length)
+{
+  uint8_t block[AES_BLOCKLEN];
+  size_t i, j;
+
+  AES_KERNEL_ENTER(cbc_reencrypt, length, 0, AES_STATS_SEQUENTIAL);
+  for (i = 0; i < length; i += AES_BLOCKLEN)
+  {
+    uint8_t* c = buf + i;
+
+    // Old ciphertext block: decrypt, chain from the old IV, chain into the new one
+    memcpy(block, c, AES_BLOCKLEN);
+    AES_block_decrypt(from, block);
+    for (j = 0; j < AES_BLOCKLEN; ++j)
+    {
+      block[j] ^= from->Iv[j] ^ to->Iv[j];
+    }
+    memcpy(from->Iv, c, AES_BLOCKLEN);
+    AES_block_encrypt(to, block);
+    memcpy(c, block, AES_BLOCKLEN);
+    memcpy(to->Iv, block, AES_BLOCKLEN);
+  }
+  Wipe(block, sizeof(block));
+  AES_KERNEL_EXIT(cbc_reencrypt, AES_STATS_CBC_ENCRYPT, length, 0, AES_STATS_SEQUENTIAL);
+}
+#endif // #if defined(CBC) && (CBC == 1)
+
+uint32_t AES_crc32c(uint32_t crc, const void* data, size_t length)
+{
+  const uint8_t* p = (const uint8_t*)data;
+#if AES_FUSED_SSE42
+  if (__builtin_cpu_supports("sse4.2"))
+  {
+    return ~CrcSse42(~crc, p, length);
+  }
+#endif
+  return ~CrcPortable(~crc, p, length);
+}
+
+uint32_t AES_crc32c_combine(uint32_t crc_a, uint32_t crc_b, size_t length_b)
+{
+  return MultModP(XPow8n(length_b), crc_a) ^ crc_b;
+}
+
+#if defined(CTR) && (CTR == 1)
+void AES_CTR_encrypt_buffer_crc32c(struct AES_ctx* ctx, uint8_t* buf, size_t length, uint32_t* crc)
+{
+  CtrCrc32c(ctx, buf, length, crc, 1);
+}
+
+void AES_CTR_decrypt_buffer_crc32c(struct AES_ctx* ctx, uint8_t* buf, size_t length, uint32_t* crc)
+{
+  CtrCrc32c(ctx, buf, length, crc, 0);
+}
+#endif // #if defined(CTR) && (CTR == 1)
+
+#if defined(CBC) && (CBC == 1)
+void AES_CBC_encrypt_buffer_crc32c(struct AES_ctx* ctx, uint8_t* buf, size_t length, uint32_t* crc)
+{
+  const size_t tile = AES_FUSED_TILE_BLOCKS * AES_BLOCKLEN;
+  size_t done, i, j;
+
+  AES_KERNEL_ENTER(cbc_encrypt_crc32c, length, 0, AES_STATS_SEQUENTIAL);
+  for (done = 0; done < length; done += tile)
+  {
+    const size_t n = (length - done < tile) ? (length - done) : tile;
+    for (i = done; i < done + n; i += AES_BLOCKLEN)
+    {
+      for (j = 0; j < AES_BLOCKLEN; ++j)
+      {
+        buf[i + j] ^= ctx->Iv[j];
+      }
+      AES_block_encrypt(ctx, buf + i);
+      memcpy(ctx->Iv, buf + i, AES_BLOCKLEN);
+    }
+    *crc = AES_crc32c(*crc, buf + done, n);
+  }
+  AES_KERNEL_EXIT(cbc_encrypt_crc32c, AES_STATS_CBC_ENCRYPT, length, 0, AES_STATS_SEQUENTIAL);
+}
+
+void AES_CBC_decrypt_buffer_crc32c(struct AES_ctx* ctx, uint8_t* buf, size_t length, uint32_t* crc)
+{
+  const size_t tile = AES_FUSED_TILE_BLOCKS * AES_BLOCKLEN;
+  uint8_t next_iv[AES_BLOCKLEN];
+  size_t done, i, j;
+
+  AES_KERNEL_ENTER(cbc_decrypt_crc32c, length, 0, AES_STATS_SEQUENTIAL);
+  for (done = 0; done < length; done += tile)
+  {
+    const size_t n = (length - done < tile) ? (length - done) : tile;
+    *crc = AES_crc32c(*crc, buf + done, n);
+    for (i = done; i < done + n; i += AES_BLOCKLEN)
+    {
+      memcpy(next_iv, buf + i, AES_BLOCKLEN);
+      AES_block_decrypt(ctx, buf + i);
+      for (j = 0; j < AES_BLOCKLEN; ++j)
+      {
+        buf[i + j] ^= ctx->Iv[j];
+      }
+      memcpy(ctx->Iv, next_iv, AES_BLOCKLEN);
+    }
+  }
+  AES_KERNEL_EXIT(cbc_decrypt_crc32c, AES_STATS_CBC_DECRYPT, length, 0, AES_STATS_SEQUENTIAL);
+}
+#endif // #if defined(CBC) && (CBC == 1)
@@ -0,0 +1,63 @@
+#ifndef _AES_FUSED_H_
+#define _AES_FUSED_H_
+
+#include "aes.h"
+
+// Fused passes: several operations over the same buffer done in one sweep, so
+// the data is read and written once instead of once per operation.
+
+// Blocks processed per step of a fused pass: the keystream tile of the CTR
+// re-encryption, and the span each checksum update covers while it is in L1
+#ifndef AES_FUSED_TILE_BLOCKS
+  #define AES_FUSED_TILE_BLOCKS 8
+#endif
+
+#if defined(CTR) && (CTR == 1)
+// Key rotation for CTR: the same as
+//
+//   AES_CTR_xcrypt_buffer(from, buf, length);   // decrypt under the old key
+//   AES_CTR_xcrypt_buffer(to, buf, length);     // encrypt under the new key
+//
+// in one pass: a tile of keystream under each key is generated, the two are
+// XORed together and the combined keystream applied to buf. Both IVs advance as
+// in the two calls. AES_CTR_reencrypt_buffer_openmp() in aes_openmp.h splits the
+// pass over threads.
+void AES_CTR_reencrypt_buffer(struct AES_ctx* from, struct AES_ctx* to, uint8_t* buf, size_t length);
+#endif
+
+#if defined(CBC) && (CBC == 1)
+// Key rotation for CBC, the same as AES_CBC_decrypt_buffer(from, ...) then
+// AES_CBC_encrypt_buffer(to, ...): each block is decrypted and re-encrypted
+// while it is in registers. length must be a multiple of AES_BLOCKLEN. CBC
+// encryption is a chain, so this is sequential; rotate many objects in
+// parallel instead.
+void AES_CBC_reencrypt_buffer(struct AES_ctx* from, struct AES_ctx* to, uint8_t* buf, size_t length);
+#endif
+
+
+// CRC32C (Castagnoli, as in iSCSI and ext4), with the pre- and post-inversion
+// of the usual API: AES_crc32c(0, "123456789", 9) == 0xe3069283, and
+// AES_crc32c(AES_crc32c(0, a, n), b, m) is the CRC of a followed by b. Uses the
+// SSE4.2 crc32 instruction on x86-64 CPUs that have it.
+uint32_t AES_crc32c(uint32_t crc, const void* data, size_t length);
+
+// The CRC of a followed by b from crc_a = AES_crc32c(0, a, ...) and
+// crc_b = AES_crc32c(0, b, length_b), in O(log length_b)
+uint32_t AES_crc32c_combine(uint32_t crc_a, uint32_t crc_b, size_t length_b);
+
+// Encrypt or decrypt and update *crc with the CRC32C of the ciphertext in the
+// same pass: the output when encrypting, the input when decrypting. Otherwise
+// these are AES_CTR_xcrypt_buffer() / AES_CBC_*_buffer(); *crc carries on
+// from call to call like the IV. The _openmp variants of the CTR pair in
+// aes_openmp.h combine per-thread partial CRCs.
+#if defined(CTR) && (CTR == 1)
+void AES_CTR_encrypt_buffer_crc32c(struct AES_ctx* ctx, uint8_t* buf, size_t length, uint32_t* crc);
+void AES_CTR_decrypt_buffer_crc32c(struct AES_ctx* ctx, uint8_t* buf, size_t length, uint32_t* crc);
+#endif
+#if defined(CBC) && (CBC == 1)
+void AES_CBC_encrypt_buffer_crc32c(struct AES_ctx* ctx, uint8_t* buf, size_t length, uint32_t* crc);
+void AES_CBC_decrypt_buffer_crc32c(struct AES_ctx* ctx, uint8_t* buf, size_t length, uint32_t* crc);
+#endif
+
+
+#endif // _AES_FUSED_H_
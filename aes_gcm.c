@@ -0,0 +1,341 @@
+/*
+
+AES-GCM (aes_gcm.h).
+
+  H       = E(0)
+  J0      = IV || 0^31 || 1 for a 12-byte IV, else GHASH(IV, [len(IV)])
+  C       = P ^ E(inc32(J0)), E(inc32(inc32(J0))), ...
+  tag     = E(J0) ^ GHASH(A, C, [len(A)] || [len(C)])
+
+The portable pass goes a tile of AES_GCM_TILE_BLOCKS at a time through the
+block, XOR and GHASH backends. The stitched kernel handles whole tiles of 8
+blocks: in each of the first 8 AES rounds of the new counter blocks it also
+does one carry-less multiplication, ciphertext block i times H^(8-i), and the
+8 products are reduced once at the end (aggregated reduction). When encrypting
+those are the ciphertext blocks of the previous tile, when decrypting the
+current tile's input, so in either case the two halves do not wait on each
+other.
+
+*/
+
+#include <string.h>
+#include "aes.h"
+#include "aes_gcm.h"
+#include "aes_backend.h"
+#include "aes_instrument.h"
+#include "aes_util.h"
+
+#ifndef AES_GCM_AESNI
+  #if defined(__x86_64__) && defined(__GNUC__)
+    #define AES_GCM_AESNI 1
+  #else
+    #define AES_GCM_AESNI 0
+  #endif
+#endif
+
+#if AES_GCM_AESNI
+  #include <wmmintrin.h>
+  #include <tmmintrin.h>
+#endif
+
+#define GCM_ROUNDS (AES_keyExpSize / AES_BLOCKLEN - 1)
+#define STITCH_BLOCKS 8
+
+// GHASH over length bytes, the last partial block padded with zeros
+static void GhashPadded(AES_ghash_fn ghash, uint8_t* Y, const uint8_t* H, const uint8_t* data, size_t length)
+{
+  const size_t full = length / AES_BLOCKLEN;
+
+  if (full > 0)
+  {
+    ghash(Y, H, data, full);
+  }
+  if (length % AES_BLOCKLEN != 0)
+  {
+    uint8_t last[AES_BLOCKLEN] = { 0 };
+    memcpy(last, data + full * AES_BLOCKLEN, length % AES_BLOCKLEN);
+    ghash(Y, H, last, 1);
+  }
+}
+
+// The counter-mode pass with the ciphertext hashed tile by tile
+static void CryptTiles(const struct AES_ctx* ctx, const uint8_t* H, uint8_t* Y, uint8_t* counter,
+                       uint8_t* buf, size_t length, int encrypt)
+{
+  const AES_block_fn encrypt_blocks = AES_backend_block();
+  const AES_xor_fn xor_bytes = AES_backend_xor();
+  const AES_ghash_fn ghash = AES_backend_ghash();
+  uint8_t stream[AES_GCM_TILE_BLOCKS * AES_BLOCKLEN];
+  size_t done, i;
+
+  for (done = 0; done < length; done += sizeof(stream))
+  {
+    const size_t n = (length - done < sizeof(stream)) ? (length - done) : sizeof(stream);
+    const size_t blocks = (n + AES_BLOCKLEN - 1) / AES_BLOCKLEN;
+
+    for (i = 0; i < blocks; ++i)
+    {
+      memcpy(stream + i * AES_BLOCKLEN, counter, AES_BLOCKLEN);
+      Inc32(counter);
+    }
+    encrypt_blocks(ctx, stream, blocks);
+
+    if (!encrypt)
+    {
+      GhashPadded(ghash, Y, H, buf + done, n);
+    }
+    xor_bytes(buf + done, stream, n);
+    if (encrypt)
+    {
+      GhashPadded(ghash, Y, H, buf + done, n);
+    }
+  }
+  Wipe(stream, sizeof(stream));
+}
+
+
+#if AES_GCM_AESNI
+#define STITCHED __attribute__((target("sse2,ssse3,aes,pclmul")))
+
+// Only while both halves are selected in the registry: the kernel is the
+// "aesni" block and the "pclmul" GHASH backends woven together, and selecting
+// either back to "portable" must take GCM with it. The registry only lets
+// those be selected on a CPU that has them.
+static int HaveStitched(void)
+{
+  const char* block = AES_backend_selected(AES_PRIMITIVE_BLOCK);
+  const char* ghash = AES_backend_selected(AES_PRIMITIVE_GHASH);
+  return block != NULL && 0 == strcmp(block, "aesni") && ghash != NULL && 0 == strcmp(ghash, "pclmul");
+}
+
+// Adds the unreduced carry-less product a * b to lo/mid/hi
+STITCHED static void ClmulAdd(__m128i a, __m128i b, __m128i* lo, __m128i* mid, __m128i* hi)
+{
+  *lo = _mm_xor_si128(*lo, _mm_clmulepi64_si128(a, b, 0x00));
+  *mid = _mm_xor_si128(*mid, _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10), _mm_clmulepi64_si128(a, b, 0x01)));
+  *hi = _mm_xor_si128(*hi, _mm_clmulepi64_si128(a, b, 0x11));
+}
+
+// The GF(2^128) element of a sum of products, on byte-reversed operands as in
+// GhashPclmul() of aes_backend.c. Shift and reduction are linear, so a sum
+// of products is reduced once.
+STITCHED static __m128i Reduce(__m128i lo, __m128i mid, __m128i hi)
+{
+  __m128i t7, t8, t9, t2;
+
+  lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+  hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+
+  t7 = _mm_srli_epi32(lo, 31);
+  t8 = _mm_srli_epi32(hi, 31);
+  lo = _mm_slli_epi32(lo, 1);
+  hi = _mm_slli_epi32(hi, 1);
+  t9 = _mm_srli_si128(t7, 12);
+  t8 = _mm_slli_si128(t8, 4);
+  t7 = _mm_slli_si128(t7, 4);
+  lo = _mm_or_si128(lo, t7);
+  hi = _mm_or_si128(_mm_or_si128(hi, t8), t9);
+
+  t7 = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)), _mm_slli_epi32(lo, 25));
+  t8 = _mm_srli_si128(t7, 4);
+  lo = _mm_xor_si128(lo, _mm_slli_si128(t7, 12));
+  t2 = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)), _mm_srli_epi32(lo, 7));
+  t2 = _mm_xor_si128(t2, t8);
+  lo = _mm_xor_si128(lo, t2);
+  return _mm_xor_si128(hi, lo);
+}
+
+STITCHED static __m128i Bswap(__m128i x)
+{
+  return _mm_shuffle_epi8(x, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+// y = (y ^ c[0]) * H^8 ^ c[1] * H^7 ^ ... ^ c[7] * H, for the last tile
+STITCHED static __m128i HashTile(__m128i y, const uint8_t* c, const __m128i* hpow)
+{
+  __m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+  int i;
+
+  for (i = 0; i < STITCH_BLOCKS; ++i)
+  {
+    __m128i x = Bswap(_mm_loadu_si128((const __m128i*)(c + i * AES_BLOCKLEN)));
+    if (i == 0)
+    {
+      x = _mm_xor_si128(x, y);
+    }
+    ClmulAdd(x, hpow[STITCH_BLOCKS - 1 - i], &lo, &mid, &hi);
+  }
+  return Reduce(lo, mid, hi);
+}
+
+// The whole tiles of 8 blocks in buf; returns the number of bytes done
+STITCHED static size_t CryptStitched(const struct AES_ctx* ctx, const uint8_t* H, uint8_t* Y, uint8_t* counter,
+                                     uint8_t* buf, size_t length, int encrypt)
+{
+  const size_t tiles = length / (STITCH_BLOCKS * AES_BLOCKLEN);
+  __m128i rk[GCM_ROUNDS + 1];
+  __m128i hpow[STITCH_BLOCKS];  // hpow[i] = H^(i + 1)
+  __m128i y, ctr;
+  size_t t;
+  int i, r;
+
+  if (tiles == 0)
+  {
+    return 0;
+  }
+  for (r = 0; r <= GCM_ROUNDS; ++r)
+  {
+    rk[r] = _mm_loadu_si128((const __m128i*)(ctx->RoundKey + r * AES_BLOCKLEN));
+  }
+  hpow[0] = Bswap(_mm_loadu_si128((const __m128i*)H));
+  for (i = 1; i < STITCH_BLOCKS; ++i)
+  {
+    __m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+    ClmulAdd(hpow[i - 1], hpow[0], &lo, &mid, &hi);
+    hpow[i] = Reduce(lo, mid, hi);
+  }
+  y = Bswap(_mm_loadu_si128((const __m128i*)Y));
+  // Byte-reversed, the 32-bit counter is the low lane and adds without carry
+  ctr = Bswap(_mm_loadu_si128((const __m128i*)counter));
+
+  for (t = 0; t < tiles; ++t)
+  {
+    uint8_t* p = buf + t * STITCH_BLOCKS * AES_BLOCKLEN;
+    const uint8_t* h = encrypt ? ((t > 0) ? p - STITCH_BLOCKS * AES_BLOCKLEN : NULL) : p;
+    __m128i b[STITCH_BLOCKS], c[STITCH_BLOCKS];
+    __m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+
+    for (i = 0; i < STITCH_BLOCKS; ++i)
+    {
+      b[i] = _mm_xor_si128(Bswap(_mm_add_epi32(ctr, _mm_set_epi32(0, 0, 0, i))), rk[0]);
+      c[i] = (h != NULL) ? Bswap(_mm_loadu_si128((const __m128i*)(h + i * AES_BLOCKLEN))) : _mm_setzero_si128();
+    }
+    ctr = _mm_add_epi32(ctr, _mm_set_epi32(0, 0, 0, STITCH_BLOCKS));
+    c[0] = _mm_xor_si128(c[0], y);
+
+    for (r = 1; r < GCM_ROUNDS; ++r)
+    {
+      for (i = 0; i < STITCH_BLOCKS; ++i)
+      {
+        b[i] = _mm_aesenc_si128(b[i], rk[r]);
+      }
+      if (h != NULL && r <= STITCH_BLOCKS)
+      {
+        ClmulAdd(c[r - 1], hpow[STITCH_BLOCKS - r], &lo, &mid, &hi);
+      }
+    }
+    for (i = 0; i < STITCH_BLOCKS; ++i)
+    {
+      b[i] = _mm_aesenclast_si128(b[i], rk[GCM_ROUNDS]);
+    }
+    if (h != NULL)
+    {
+      y = Reduce(lo, mid, hi);
+    }
+    for (i = 0; i < STITCH_BLOCKS; ++i)
+    {
+      __m128i* q = (__m128i*)(p + i * AES_BLOCKLEN);
+      _mm_storeu_si128(q, _mm_xor_si128(_mm_loadu_si128(q), b[i]));
+    }
+  }
+  if (encrypt)
+  {
+    y = HashTile(y, buf + (tiles - 1) * STITCH_BLOCKS * AES_BLOCKLEN, hpow);
+  }
+
+  _mm_storeu_si128((__m128i*)Y, Bswap(y));
+  _mm_storeu_si128((__m128i*)counter, Bswap(ctr));
+  return tiles * STITCH_BLOCKS * AES_BLOCKLEN;
+}
+#endif // #if AES_GCM_AESNI
+
+
+// Runs the whole of GCM and leaves the computed tag in tag
+static void Gcm(const struct AES_ctx* ctx, const uint8_t* iv, size_t iv_len,
+                const uint8_t* aad, size_t aad_len,
+                uint8_t* buf, size_t length, uint8_t* tag, int encrypt)
+{
+  const AES_ghash_fn ghash = AES_backend_ghash();
+  uint8_t H[AES_BLOCKLEN] = { 0 };
+  uint8_t J0[AES_BLOCKLEN] = { 0 };
+  uint8_t Y[AES_BLOCKLEN] = { 0 };
+  uint8_t counter[AES_BLOCKLEN];
+  uint8_t lengths[AES_BLOCKLEN];
+  size_t done = 0;
+  int i;
+
+  AES_block_encrypt(ctx, H);
+  if (iv_len == 12)
+  {
+    memcpy(J0, iv, 12);
+    J0[AES_BLOCKLEN - 1] = 1;
+  }
+  else
+  {
+    GhashPadded(ghash, J0, H, iv, iv_len);
+    Store64Be(lengths, 0);
+    Store64Be(lengths + 8, (uint64_t)iv_len * 8);
+    ghash(J0, H, lengths, 1);
+  }
+  memcpy(counter, J0, AES_BLOCKLEN);
+  Inc32(counter);
+
+  GhashPadded(ghash, Y, H, aad, aad_len);
+#if AES_GCM_AESNI
+  if (HaveStitched())
+  {
+    done = CryptStitched(ctx, H, Y, counter, buf, length, encrypt);
+  }
+#endif
+  CryptTiles(ctx, H, Y, counter, buf + done, length - done, encrypt);
+
+  Store64Be(lengths, (uint64_t)aad_len * 8);
+  Store64Be(lengths + 8, (uint64_t)length * 8);
+  ghash(Y, H, lengths, 1);
+
+  AES_block_encrypt(ctx, J0);
+  for (i = 0; i < AES_GCM_TAGLEN; ++i)
+  {
+    tag[i] = Y[i] ^ J0[i];
+  }
+  Wipe(H, sizeof(H));
+  Wipe(J0, sizeof(J0));
+  Wipe(Y, sizeof(Y));
+}
+
+
+/*****************************************************************************/
+/* Public functions:                                                         */
+/*****************************************************************************/
+void AES_GCM_encrypt(const struct AES_ctx* ctx, const uint8_t* iv, size_t iv_len,
+                     const uint8_t* aad, size_t aad_len,
+                     uint8_t* buf, size_t length, uint8_t* tag)
+{
+  AES_KERNEL_ENTER(gcm_encrypt, length, 0, AES_STATS_SEQUENTIAL);
+  Gcm(ctx, iv, iv_len, aad, aad_len, buf, length, tag, 1);
+  AES_KERNEL_EXIT(gcm_encrypt, AES_STATS_GCM, length, 0, AES_STATS_SEQUENTIAL);
+}
+
+int AES_GCM_decrypt(const struct AES_ctx* ctx, const uint8_t* iv, size_t iv_len,
+                    const uint8_t* aad, size_t aad_len,
+                    uint8_t* buf, size_t length, const uint8_t* tag)
+{
+  uint8_t expected[AES_GCM_TAGLEN];
+  uint8_t diff = 0;
+  int i;
+
+  AES_KERNEL_ENTER(gcm_decrypt, length, 0, AES_STATS_SEQUENTIAL);
+  Gcm(ctx, iv, iv_len, aad, aad_len, buf, length, expected, 0);
+  // Compare in constant time
+  for (i = 0; i < AES_GCM_TAGLEN; ++i)
+  {
+    diff |= (uint8_t)(expected[i] ^ tag[i]);
+  }
+  if (diff != 0)
+  {
+    Wipe(buf, length);
+  }
+  Wipe(expected, sizeof(expected));
+  AES_KERNEL_EXIT(gcm_decrypt, AES_STATS_GCM, length, 0, AES_STATS_SEQUENTIAL);
+  return (diff != 0) ? -1 : 0;
+}
@@ -0,0 +1,40 @@
+#ifndef _AES_GCM_H_
+#define _AES_GCM_H_
+
+#include <stdint.h>
+#include "aes.h"
+
+// AES-GCM (NIST SP 800-38D) in a single pass over the data: every tile of
+// counter blocks is encrypted, applied to buf and its ciphertext hashed while
+// it is still in L1, instead of a CTR pass followed by a GHASH pass.
+//
+// While the "aesni" block and "pclmul" GHASH backends are selected
+// (aes_backend.h; the default on x86-64 CPUs with AES-NI and PCLMULQDQ), tiles
+// of 8 blocks go through a stitched kernel: the AES rounds of 8 counter blocks
+// are interleaved with the carry-less multiplications for 8 ciphertext blocks,
+// so the AES unit and the multiplier work side by side. The output is the same
+// either way.
+
+// Blocks per tile of the portable pass
+#ifndef AES_GCM_TILE_BLOCKS
+  #define AES_GCM_TILE_BLOCKS 8
+#endif
+
+#define AES_GCM_TAGLEN 16
+
+// ctx only supplies the key (AES_init_ctx()); its Iv is not used. The IV is
+// given per message: 12 bytes is the usual and fastest length, any other
+// length is hashed into the first counter block. An IV must never be used
+// twice under one key. Encrypts buf in place and writes the 16-byte tag.
+void AES_GCM_encrypt(const struct AES_ctx* ctx, const uint8_t* iv, size_t iv_len,
+                     const uint8_t* aad, size_t aad_len,
+                     uint8_t* buf, size_t length, uint8_t* tag);
+
+// Decrypts buf in place and checks the tag. Returns 0 if it matches; otherwise
+// returns -1 and zeroes buf, so no unauthenticated plaintext is released.
+int AES_GCM_decrypt(const struct AES_ctx* ctx, const uint8_t* iv, size_t iv_len,
+                    const uint8_t* aad, size_t aad_len,
+                    uint8_t* buf, size_t length, const uint8_t* tag);
+
+
+#endif // _AES_GCM_H_
@@ -0,0 +1,327 @@
+/*
+
+AES-round hash (aes_hash.h).
+
+  L        = round(k0 ^ length, k1)                 per-length key
+  <= 16    s = round(round(round(pad(data) ^ L, k2), k3), L)
+  longer   lanes a = L and c = round(L, k3) absorb 32 bytes per step,
+           a = round(a ^ x, k2), c = round(c ^ y, k3), the last 32 bytes
+           overlapping what came before; s = round(round(round(a, c), k2), L)
+
+and the hash is the two 64-bit halves of s XORed together.
+
+AES_block_round() is exactly the AESENC instruction, so on x86-64 the same
+rounds run on AES-NI when the CPU has it (AES_HASH_AESNI); the hashes do not
+change, only the speed.
+
+*/
+
+#include <string.h>
+#include <time.h>
+#include <stdatomic.h>
+#include "aes.h"
+#include "aes_hash.h"
+#include "aes_drbg.h"
+#include "aes_util.h"
+
+#ifndef AES_HASH_AESNI
+  #if defined(__x86_64__) && defined(__GNUC__)
+    #define AES_HASH_AESNI 1
+  #else
+    #define AES_HASH_AESNI 0
+  #endif
+#endif
+
+#if AES_HASH_AESNI
+  #include <wmmintrin.h>
+#endif
+
+static void Xor(uint8_t* dst, const uint8_t* src)
+{
+  int i;
+  for (i = 0; i < AES_BLOCKLEN; ++i)
+  {
+    dst[i] ^= src[i];
+  }
+}
+
+static uint64_t Fold(const uint8_t* s)
+{
+  return Load64Le(s) ^ Load64Le(s + 8);
+}
+
+static void LengthKey(const struct AES_hash_key* key, size_t length, uint8_t* L)
+{
+  memcpy(L, key->k[0], AES_BLOCKLEN);
+  Store64Le(L + 8, Load64Le(L + 8) ^ (uint64_t)length);
+  AES_block_round(L, key->k[1]);
+}
+
+// The short-input path for n (at most AES_HASH_TILE) keys of the length L was
+// made for, given as numbers; round by round over the tile so the blocks are
+// independent work
+static void HashTile(const uint8_t* L, const struct AES_hash_key* key, const uint64_t* values, uint64_t* out, size_t n)
+{
+  uint8_t s[AES_HASH_TILE][AES_BLOCKLEN];
+  size_t i;
+
+  for (i = 0; i < n; ++i)
+  {
+    memcpy(s[i], L, AES_BLOCKLEN);
+    Store64Le(s[i], Load64Le(s[i]) ^ values[i]);
+  }
+  for (i = 0; i < n; ++i)
+  {
+    AES_block_round(s[i], key->k[2]);
+  }
+  for (i = 0; i < n; ++i)
+  {
+    AES_block_round(s[i], key->k[3]);
+  }
+  for (i = 0; i < n; ++i)
+  {
+    AES_block_round(s[i], L);
+    out[i] = Fold(s[i]);
+  }
+}
+
+
+#if AES_HASH_AESNI
+#define AESNI __attribute__((target("sse2,aes")))
+
+static int HaveAesni(void)
+{
+  return __builtin_cpu_supports("aes");
+}
+
+AESNI static __m128i Load(const uint8_t* p)
+{
+  return _mm_loadu_si128((const __m128i*)p);
+}
+
+AESNI static uint64_t FoldAesni(__m128i s)
+{
+  return (uint64_t)_mm_cvtsi128_si64(_mm_xor_si128(s, _mm_unpackhi_epi64(s, s)));
+}
+
+AESNI static __m128i LengthKeyAesni(const struct AES_hash_key* key, size_t length)
+{
+  return _mm_aesenc_si128(_mm_xor_si128(Load(key->k[0]), _mm_set_epi64x((long long)length, 0)), Load(key->k[1]));
+}
+
+AESNI static uint64_t HashAesni(const struct AES_hash_key* key, const uint8_t* p, size_t length)
+{
+  const __m128i k2 = Load(key->k[2]);
+  const __m128i k3 = Load(key->k[3]);
+  const __m128i L = LengthKeyAesni(key, length);
+  __m128i a, c;
+  size_t i;
+
+  if (length <= AES_BLOCKLEN)
+  {
+    uint8_t padded[AES_BLOCKLEN] = { 0 };
+    if (length > 0)
+    {
+      memcpy(padded, p, length);
+    }
+    a = _mm_aesenc_si128(_mm_xor_si128(Load(padded), L), k2);
+    a = _mm_aesenc_si128(a, k3);
+    return FoldAesni(_mm_aesenc_si128(a, L));
+  }
+
+  a = L;
+  c = _mm_aesenc_si128(L, k3);
+  for (i = 0; length - i > 2 * AES_BLOCKLEN; i += 2 * AES_BLOCKLEN)
+  {
+    a = _mm_aesenc_si128(_mm_xor_si128(a, Load(p + i)), k2);
+    c = _mm_aesenc_si128(_mm_xor_si128(c, Load(p + i + AES_BLOCKLEN)), k3);
+  }
+  a = _mm_aesenc_si128(_mm_xor_si128(a, Load((length >= 2 * AES_BLOCKLEN) ? p + length - 2 * AES_BLOCKLEN : p)), k2);
+  c = _mm_aesenc_si128(_mm_xor_si128(c, Load(p + length - AES_BLOCKLEN)), k3);
+
+  a = _mm_aesenc_si128(a, c);
+  a = _mm_aesenc_si128(a, k2);
+  return FoldAesni(_mm_aesenc_si128(a, L));
+}
+
+AESNI static void HashTileAesni(const struct AES_hash_key* key, size_t length, const uint64_t* values, uint64_t* out, size_t n)
+{
+  const __m128i k2 = Load(key->k[2]);
+  const __m128i k3 = Load(key->k[3]);
+  const __m128i L = LengthKeyAesni(key, length);
+  size_t i;
+
+  for (i = 0; i < n; ++i)
+  {
+    __m128i s = _mm_xor_si128(L, _mm_cvtsi64_si128((long long)values[i]));
+    s = _mm_aesenc_si128(s, k2);
+    s = _mm_aesenc_si128(s, k3);
+    out[i] = FoldAesni(_mm_aesenc_si128(s, L));
+  }
+}
+#endif // #if AES_HASH_AESNI
+
+
+/*****************************************************************************/
+/* Public functions:                                                         */
+/*****************************************************************************/
+void AES_hash_init(struct AES_hash_key* key, uint64_t seed0, uint64_t seed1)
+{
+  static const uint64_t weyl[2] = { 0x9E3779B97F4A7C15ULL, 0xBB67AE8584CAA73BULL };
+  uint8_t c[AES_BLOCKLEN];
+  int i;
+
+  Store64Le(key->k[0], seed0);
+  Store64Le(key->k[0] + 8, seed1);
+  for (i = 1; i < 4; ++i)
+  {
+    Store64Le(c, weyl[0] * (uint64_t)i);
+    Store64Le(c + 8, weyl[1] * (uint64_t)i);
+    memcpy(key->k[i], key->k[i - 1], AES_BLOCKLEN);
+    AES_block_round(key->k[i], c);
+    AES_block_round(key->k[i], c);
+  }
+}
+
+const struct AES_hash_key* AES_hash_default(void)
+{
+  static struct AES_hash_key key;
+  // 0 = not seeded, 1 = being seeded, 2 = done
+  static atomic_int state;
+  int expected = 0;
+
+  if (atomic_load_explicit(&state, memory_order_acquire) == 2)
+  {
+    return &key;
+  }
+  if (atomic_compare_exchange_strong(&state, &expected, 1))
+  {
+    uint8_t seed[16];
+    if (AES_drbg_system_entropy(NULL, seed, sizeof(seed)) != 0)
+    {
+      // No /dev/urandom: still differs per process and per run
+      Store64Le(seed, (uint64_t)(uintptr_t)&key ^ (uint64_t)time(NULL));
+      Store64Le(seed + 8, (uint64_t)clock() ^ (uint64_t)(uintptr_t)&expected);
+    }
+    AES_hash_init(&key, Load64Le(seed), Load64Le(seed + 8));
+    Wipe(seed, sizeof(seed));
+    atomic_store_explicit(&state, 2, memory_order_release);
+  }
+  else
+  {
+    while (atomic_load_explicit(&state, memory_order_acquire) != 2)
+    {
+    }
+  }
+  return &key;
+}
+
+uint64_t AES_hash(const struct AES_hash_key* key, const void* data, size_t length)
+{
+  const uint8_t* p = (const uint8_t*)data;
+  uint8_t L[AES_BLOCKLEN], a[AES_BLOCKLEN], c[AES_BLOCKLEN];
+  size_t left;
+
+#if AES_HASH_AESNI
+  if (HaveAesni())
+  {
+    return HashAesni(key, p, length);
+  }
+#endif
+
+  LengthKey(key, length, L);
+  if (length <= AES_BLOCKLEN)
+  {
+    memset(a, 0, AES_BLOCKLEN);
+    if (length > 0)
+    {
+      memcpy(a, p, length);
+    }
+    Xor(a, L);
+    AES_block_round(a, key->k[2]);
+    AES_block_round(a, key->k[3]);
+    AES_block_round(a, L);
+    return Fold(a);
+  }
+
+  memcpy(a, L, AES_BLOCKLEN);
+  memcpy(c, L, AES_BLOCKLEN);
+  AES_block_round(c, key->k[3]);
+  for (left = length; left > 2 * AES_BLOCKLEN; left -= 2 * AES_BLOCKLEN, p += 2 * AES_BLOCKLEN)
+  {
+    Xor(a, p);
+    AES_block_round(a, key->k[2]);
+    Xor(c, p + AES_BLOCKLEN);
+    AES_block_round(c, key->k[3]);
+  }
+
+  // 17 .. 32 bytes left: the last 32 of the input, or all of it and the
+  // last 16 bytes again if it is shorter
+  p = (const uint8_t*)data;
+  Xor(a, (length >= 2 * AES_BLOCKLEN) ? p + length - 2 * AES_BLOCKLEN : p);
+  AES_block_round(a, key->k[2]);
+  Xor(c, p + length - AES_BLOCKLEN);
+  AES_block_round(c, key->k[3]);
+
+  AES_block_round(a, c);
+  AES_block_round(a, key->k[2]);
+  AES_block_round(a, L);
+  return Fold(a);
+}
+
+void AES_hash_u64(const struct AES_hash_key* key, const uint64_t* keys, uint64_t* out, size_t count)
+{
+  uint8_t L[AES_BLOCKLEN];
+  size_t t;
+
+#if AES_HASH_AESNI
+  if (HaveAesni())
+  {
+    HashTileAesni(key, sizeof(uint64_t), keys, out, count);
+    return;
+  }
+#endif
+
+  LengthKey(key, sizeof(uint64_t), L);
+  for (t = 0; t < count; t += AES_HASH_TILE)
+  {
+    HashTile(L, key, keys + t, out + t, (count - t < AES_HASH_TILE) ? (count - t) : AES_HASH_TILE);
+  }
+}
+
+void AES_hash_u32(const struct AES_hash_key* key, const uint32_t* keys, uint64_t* out, size_t count)
+{
+  uint8_t L[AES_BLOCKLEN];
+  uint64_t values[AES_HASH_TILE];
+  size_t t, i;
+#if AES_HASH_AESNI
+  const int aesni = HaveAesni();
+#endif
+
+  LengthKey(key, sizeof(uint32_t), L);
+  for (t = 0; t < count; t += AES_HASH_TILE)
+  {
+    const size_t n = (count - t < AES_HASH_TILE) ? (count - t) : AES_HASH_TILE;
+    for (i = 0; i < n; ++i)
+    {
+      values[i] = keys[t + i];
+    }
+#if AES_HASH_AESNI
+    if (aesni)
+    {
+      HashTileAesni(key, sizeof(uint32_t), values, out + t, n);
+      continue;
+    }
+#endif
+    HashTile(L, key, values, out + t, n);
+  }
+}
+
+void AES_hash_many(const struct AES_hash_key* key, const void* const* data, const size_t* lengths, uint64_t* out, size_t count)
+{
+  size_t i;
+  for (i = 0; i < count; ++i)
+  {
+    out[i] = AES_hash(key, data[i], lengths[i]);
+  }
+}
@@ -0,0 +1,46 @@
+#ifndef _AES_HASH_H_
+#define _AES_HASH_H_
+
+#include <stdint.h>
+#include "aes.h"
+
+// Keyed, non-cryptographic 64-bit hash for in-memory hash tables, built from
+// AES rounds (AES_block_round()) in the style of the aeshash of the Go runtime.
+//
+// A round is a strong mixer for 16 bytes, so a short key costs a handful of
+// rounds: the length is first folded into a per-length key, the zero-padded
+// data is XORed with it and scrambled by three more rounds. Longer inputs are
+// absorbed 32 bytes per step into two independent lanes.
+//
+// The hash key is what stops hash flooding: without it nobody can pick inputs
+// that collide. Use AES_hash_default(), seeded once per process from
+// /dev/urandom, unless hashes must be reproducible. This is not a MAC and not a
+// cryptographic hash.
+
+// Values hashed per round-function step by the bulk functions
+#ifndef AES_HASH_TILE
+  #define AES_HASH_TILE 8
+#endif
+
+struct AES_hash_key
+{
+  uint8_t k[4][AES_BLOCKLEN];
+};
+
+void AES_hash_init(struct AES_hash_key* key, uint64_t seed0, uint64_t seed1);
+
+// The per-process key, seeded on first use
+const struct AES_hash_key* AES_hash_default(void);
+
+uint64_t AES_hash(const struct AES_hash_key* key, const void* data, size_t length);
+
+// Bulk forms. out[i] = AES_hash() of keys[i] as its 8 (or 4) little-endian bytes;
+// the values are hashed AES_HASH_TILE at a time, round by round.
+void AES_hash_u64(const struct AES_hash_key* key, const uint64_t* keys, uint64_t* out, size_t count);
+void AES_hash_u32(const struct AES_hash_key* key, const uint32_t* keys, uint64_t* out, size_t count);
+
+// out[i] = AES_hash(key, data[i], lengths[i])
+void AES_hash_many(const struct AES_hash_key* key, const void* const* data, const size_t* lengths, uint64_t* out, size_t count);
+
+
+#endif // _AES_HASH_H_
@@ -0,0 +1,32 @@
+#ifndef _AES_INSTRUMENT_H_
+#define _AES_INSTRUMENT_H_
+
+// Private to the library: one entry/exit pair per kernel call that feeds all
+// the instrumentation layers - USDT probes (aes_probes.h), statistics counters
+// (aes_stats.h) and the trace recorder (aes_trace.h). Each layer compiles to
+// nothing unless it is enabled.
+//
+//   probe    probe name prefix; also the trace event name
+//   mode     enum AES_stats_mode
+//   thread   omp_get_thread_num() or 0, see aes_probes.h
+//   backend  enum AES_stats_backend
+//
+// AES_KERNEL_ENTER declares locals, so it must come before AES_KERNEL_EXIT in
+// the same block.
+
+#include "aes_stats.h"
+#include "aes_probes.h"
+#include "aes_trace.h"
+
+#define AES_KERNEL_ENTER(probe, length, thread, backend)            \
+  AES_PROBE(probe##_entry, (length), (thread), (backend));          \
+  AES_TRACE_BEGIN(aes_trace_start_);                                \
+  AES_STATS_BEGIN(aes_stats_start_)
+
+#define AES_KERNEL_EXIT(probe, mode, length, thread, backend)       \
+  AES_STATS_END((backend), (mode), (length), aes_stats_start_);     \
+  AES_TRACE_END(#probe, AES_TRACE_KERNEL, (length), (thread), aes_trace_start_); \
+  AES_PROBE(probe##_exit, (length), (thread), (backend))
+
+
+#endif // _AES_INSTRUMENT_H_
@@ -0,0 +1,336 @@
+/*
+
+AES key wrap (aes_kw.h).
+
+  W:    A = IV, R[1..n] = P
+        for j = 0..5, i = 1..n:  B = E(A || R[i]),  A = MSB64(B) ^ (n*j + i),  R[i] = LSB64(B)
+        C = A || R[1..n]
+
+AES-KWP uses the same W with IV = A65959A6 || length and the key padded with
+zeros to whole semiblocks; a padded key of one semiblock is just E(IV || P).
+
+The batch functions go a tile of AES_KW_TILE_KEYS keys at a time. The A
+registers of a tile sit in a local array and its R semiblocks in the output,
+and every step (j, i) gathers one block per key, encrypts the tile with one
+kernel call and scatters the halves back.
+
+*/
+
+#include <string.h>
+#include "aes.h"
+#include "aes_kw.h"
+#include "aes_backend.h"
+#include "aes_instrument.h"
+#include "aes_util.h"
+
+static const uint8_t kw_iv[AES_KW_SEMIBLOCK] = { 0xa6, 0xa6, 0xa6, 0xa6, 0xa6, 0xa6, 0xa6, 0xa6 };
+static const uint8_t kwp_prefix[4] = { 0xa6, 0x59, 0x59, 0xa6 };
+
+// a ^= t, as a 64-bit big-endian number
+static void XorT(uint8_t* a, uint64_t t)
+{
+  int i;
+  for (i = AES_KW_SEMIBLOCK - 1; i >= 0; --i)
+  {
+    a[i] ^= (uint8_t)t;
+    t >>= 8;
+  }
+}
+
+// W over m keys of n semiblocks: key k has its register at A + 8k and its
+// semiblocks at R + k * stride
+static void Wrap(const struct AES_ctx* kek, uint8_t* A, uint8_t* R, size_t stride, size_t n, size_t m)
+{
+  const AES_block_fn encrypt_blocks = AES_backend_block();
+  uint8_t B[AES_KW_TILE_KEYS * AES_BLOCKLEN];
+  size_t i, j, k;
+
+  for (j = 0; j < 6; ++j)
+  {
+    for (i = 0; i < n; ++i)
+    {
+      const uint64_t t = (uint64_t)n * j + i + 1;
+      for (k = 0; k < m; ++k)
+      {
+        memcpy(B + k * AES_BLOCKLEN, A + k * AES_KW_SEMIBLOCK, AES_KW_SEMIBLOCK);
+        memcpy(B + k * AES_BLOCKLEN + AES_KW_SEMIBLOCK, R + k * stride + i * AES_KW_SEMIBLOCK, AES_KW_SEMIBLOCK);
+      }
+      encrypt_blocks(kek, B, m);
+      for (k = 0; k < m; ++k)
+      {
+        memcpy(A + k * AES_KW_SEMIBLOCK, B + k * AES_BLOCKLEN, AES_KW_SEMIBLOCK);
+        XorT(A + k * AES_KW_SEMIBLOCK, t);
+        memcpy(R + k * stride + i * AES_KW_SEMIBLOCK, B + k * AES_BLOCKLEN + AES_KW_SEMIBLOCK, AES_KW_SEMIBLOCK);
+      }
+    }
+  }
+  Wipe(B, sizeof(B));
+}
+
+static size_t TileKeys(size_t count, size_t first)
+{
+  return (count - first < AES_KW_TILE_KEYS) ? (count - first) : AES_KW_TILE_KEYS;
+}
+
+#if (defined(CBC) && (CBC == 1)) || (defined(ECB) && (ECB == 1))
+// The inverse of Wrap(); there is no multi-block decryption kernel, so the
+// blocks of a step are decrypted one after the other
+static void Unwrap(const struct AES_ctx* kek, uint8_t* A, uint8_t* R, size_t stride, size_t n, size_t m)
+{
+  uint8_t B[AES_KW_TILE_KEYS * AES_BLOCKLEN];
+  size_t i, j, k;
+
+  for (j = 6; j-- > 0; )
+  {
+    for (i = n; i-- > 0; )
+    {
+      const uint64_t t = (uint64_t)n * j + i + 1;
+      for (k = 0; k < m; ++k)
+      {
+        memcpy(B + k * AES_BLOCKLEN, A + k * AES_KW_SEMIBLOCK, AES_KW_SEMIBLOCK);
+        XorT(B + k * AES_BLOCKLEN, t);
+        memcpy(B + k * AES_BLOCKLEN + AES_KW_SEMIBLOCK, R + k * stride + i * AES_KW_SEMIBLOCK, AES_KW_SEMIBLOCK);
+        AES_block_decrypt(kek, B + k * AES_BLOCKLEN);
+      }
+      for (k = 0; k < m; ++k)
+      {
+        memcpy(A + k * AES_KW_SEMIBLOCK, B + k * AES_BLOCKLEN, AES_KW_SEMIBLOCK);
+        memcpy(R + k * stride + i * AES_KW_SEMIBLOCK, B + k * AES_BLOCKLEN + AES_KW_SEMIBLOCK, AES_KW_SEMIBLOCK);
+      }
+    }
+  }
+  Wipe(B, sizeof(B));
+}
+
+// Nonzero unless the n-byte strings are equal; constant time
+static uint8_t Differ(const uint8_t* a, const uint8_t* b, size_t n)
+{
+  uint8_t diff = 0;
+  size_t i;
+  for (i = 0; i < n; ++i)
+  {
+    diff |= (uint8_t)(a[i] ^ b[i]);
+  }
+  return diff;
+}
+#endif
+
+
+/*****************************************************************************/
+/* Public functions:                                                         */
+/*****************************************************************************/
+size_t AES_KWP_wrapped_length(size_t length)
+{
+  return (length + AES_KW_SEMIBLOCK - 1) / AES_KW_SEMIBLOCK * AES_KW_SEMIBLOCK + AES_KW_SEMIBLOCK;
+}
+
+int AES_KW_wrap_batch(const struct AES_ctx* kek, const uint8_t* in, size_t length, size_t count, uint8_t* out)
+{
+  const size_t n = length / AES_KW_SEMIBLOCK;
+  const size_t stride = length + AES_KW_SEMIBLOCK;
+  uint8_t A[AES_KW_TILE_KEYS * AES_KW_SEMIBLOCK];
+  size_t first, k, m;
+
+  if (length % AES_KW_SEMIBLOCK != 0 || n < 2)
+  {
+    return -1;
+  }
+  AES_KERNEL_ENTER(kw_wrap, count * length, 0, AES_STATS_SEQUENTIAL);
+  for (first = 0; first < count; first += m)
+  {
+    m = TileKeys(count, first);
+    for (k = 0; k < m; ++k)
+    {
+      memcpy(A + k * AES_KW_SEMIBLOCK, kw_iv, AES_KW_SEMIBLOCK);
+      memcpy(out + (first + k) * stride + AES_KW_SEMIBLOCK, in + (first + k) * length, length);
+    }
+    Wrap(kek, A, out + first * stride + AES_KW_SEMIBLOCK, stride, n, m);
+    for (k = 0; k < m; ++k)
+    {
+      memcpy(out + (first + k) * stride, A + k * AES_KW_SEMIBLOCK, AES_KW_SEMIBLOCK);
+    }
+  }
+  AES_KERNEL_EXIT(kw_wrap, AES_STATS_KW_WRAP, count * length, 0, AES_STATS_SEQUENTIAL);
+  return 0;
+}
+
+int AES_KWP_wrap_batch(const struct AES_ctx* kek, const uint8_t* in, size_t length, size_t count, uint8_t* out)
+{
+  const size_t stride = AES_KWP_wrapped_length(length);
+  const size_t n = stride / AES_KW_SEMIBLOCK - 1;
+  uint8_t A[AES_KW_TILE_KEYS * AES_KW_SEMIBLOCK];
+  size_t first, k, m;
+
+  if (length == 0 || (uint64_t)length > 0xffffffffULL)
+  {
+    return -1;
+  }
+  AES_KERNEL_ENTER(kw_wrap, count * length, 0, AES_STATS_SEQUENTIAL);
+  for (first = 0; first < count; first += m)
+  {
+    m = TileKeys(count, first);
+    for (k = 0; k < m; ++k)
+    {
+      uint8_t* a = A + k * AES_KW_SEMIBLOCK;
+      uint8_t* r = out + (first + k) * stride + AES_KW_SEMIBLOCK;
+      memcpy(a, kwp_prefix, sizeof(kwp_prefix));
+      a[4] = (uint8_t)(length >> 24);
+      a[5] = (uint8_t)(length >> 16);
+      a[6] = (uint8_t)(length >> 8);
+      a[7] = (uint8_t)length;
+      memcpy(r, in + (first + k) * length, length);
+      memset(r + length, 0, n * AES_KW_SEMIBLOCK - length);
+    }
+    if (n == 1)
+    {
+      // One block per key, and the keys are contiguous: a single kernel call
+      for (k = 0; k < m; ++k)
+      {
+        memcpy(out + (first + k) * stride, A + k * AES_KW_SEMIBLOCK, AES_KW_SEMIBLOCK);
+      }
+      AES_backend_block()(kek, out + first * stride, m);
+      continue;
+    }
+    Wrap(kek, A, out + first * stride + AES_KW_SEMIBLOCK, stride, n, m);
+    for (k = 0; k < m; ++k)
+    {
+      memcpy(out + (first + k) * stride, A + k * AES_KW_SEMIBLOCK, AES_KW_SEMIBLOCK);
+    }
+  }
+  AES_KERNEL_EXIT(kw_wrap, AES_STATS_KW_WRAP, count * length, 0, AES_STATS_SEQUENTIAL);
+  return 0;
+}
+
+int AES_KW_wrap(const struct AES_ctx* kek, const uint8_t* in, size_t length, uint8_t* out)
+{
+  return AES_KW_wrap_batch(kek, in, length, 1, out);
+}
+
+int AES_KWP_wrap(const struct AES_ctx* kek, const uint8_t* in, size_t length, uint8_t* out)
+{
+  return AES_KWP_wrap_batch(kek, in, length, 1, out);
+}
+
+#if (defined(CBC) && (CBC == 1)) || (defined(ECB) && (ECB == 1))
+long AES_KW_unwrap_batch(const struct AES_ctx* kek, const uint8_t* in, size_t wrapped_length, size_t count, uint8_t* out)
+{
+  const size_t n = wrapped_length / AES_KW_SEMIBLOCK - 1;
+  const size_t stride = wrapped_length - AES_KW_SEMIBLOCK;
+  uint8_t A[AES_KW_TILE_KEYS * AES_KW_SEMIBLOCK];
+  size_t first, k, m;
+  long failed = 0;
+
+  if (wrapped_length % AES_KW_SEMIBLOCK != 0 || wrapped_length < 3 * AES_KW_SEMIBLOCK)
+  {
+    return -1;
+  }
+  AES_KERNEL_ENTER(kw_unwrap, count * stride, 0, AES_STATS_SEQUENTIAL);
+  for (first = 0; first < count; first += m)
+  {
+    m = TileKeys(count, first);
+    for (k = 0; k < m; ++k)
+    {
+      memcpy(A + k * AES_KW_SEMIBLOCK, in + (first + k) * wrapped_length, AES_KW_SEMIBLOCK);
+      memcpy(out + (first + k) * stride, in + (first + k) * wrapped_length + AES_KW_SEMIBLOCK, stride);
+    }
+    Unwrap(kek, A, out + first * stride, stride, n, m);
+    for (k = 0; k < m; ++k)
+    {
+      if (Differ(A + k * AES_KW_SEMIBLOCK, kw_iv, AES_KW_SEMIBLOCK) != 0)
+      {
+        Wipe(out + (first + k) * stride, stride);
+        ++failed;
+      }
+    }
+  }
+  Wipe(A, sizeof(A));
+  AES_KERNEL_EXIT(kw_unwrap, AES_STATS_KW_UNWRAP, count * stride, 0, AES_STATS_SEQUENTIAL);
+  return failed;
+}
+
+long AES_KWP_unwrap_batch(const struct AES_ctx* kek, const uint8_t* in, size_t wrapped_length, size_t count,
+                          uint8_t* out, size_t* lengths)
+{
+  const size_t n = wrapped_length / AES_KW_SEMIBLOCK - 1;
+  const size_t stride = wrapped_length - AES_KW_SEMIBLOCK;
+  uint8_t A[AES_KW_TILE_KEYS * AES_KW_SEMIBLOCK];
+  size_t first, k, m, i;
+  long failed = 0;
+
+  if (wrapped_length % AES_KW_SEMIBLOCK != 0 || wrapped_length < 2 * AES_KW_SEMIBLOCK)
+  {
+    return -1;
+  }
+  AES_KERNEL_ENTER(kw_unwrap, count * stride, 0, AES_STATS_SEQUENTIAL);
+  for (first = 0; first < count; first += m)
+  {
+    m = TileKeys(count, first);
+    for (k = 0; k < m; ++k)
+    {
+      const uint8_t* c = in + (first + k) * wrapped_length;
+      if (n == 1)
+      {
+        uint8_t B[AES_BLOCKLEN];
+        memcpy(B, c, AES_BLOCKLEN);
+        AES_block_decrypt(kek, B);
+        memcpy(A + k * AES_KW_SEMIBLOCK, B, AES_KW_SEMIBLOCK);
+        memcpy(out + (first + k) * stride, B + AES_KW_SEMIBLOCK, AES_KW_SEMIBLOCK);
+        Wipe(B, sizeof(B));
+      }
+      else
+      {
+        memcpy(A + k * AES_KW_SEMIBLOCK, c, AES_KW_SEMIBLOCK);
+        memcpy(out + (first + k) * stride, c + AES_KW_SEMIBLOCK, stride);
+      }
+    }
+    if (n > 1)
+    {
+      Unwrap(kek, A, out + first * stride, stride, n, m);
+    }
+
+    for (k = 0; k < m; ++k)
+    {
+      const uint8_t* a = A + k * AES_KW_SEMIBLOCK;
+      uint8_t* p = out + (first + k) * stride;
+      const size_t mli = ((size_t)a[4] << 24) | ((size_t)a[5] << 16) | ((size_t)a[6] << 8) | a[7];
+      uint8_t bad = Differ(a, kwp_prefix, sizeof(kwp_prefix));
+
+      // The length must leave 0 to 7 bytes of zero padding
+      if (mli <= stride - AES_KW_SEMIBLOCK || mli > stride)
+      {
+        bad = 1;
+      }
+      else
+      {
+        for (i = mli; i < stride; ++i)
+        {
+          bad |= p[i];
+        }
+      }
+      if (bad != 0)
+      {
+        Wipe(p, stride);
+        lengths[first + k] = 0;
+        ++failed;
+      }
+      else
+      {
+        lengths[first + k] = mli;
+      }
+    }
+  }
+  Wipe(A, sizeof(A));
+  AES_KERNEL_EXIT(kw_unwrap, AES_STATS_KW_UNWRAP, count * stride, 0, AES_STATS_SEQUENTIAL);
+  return failed;
+}
+
+int AES_KW_unwrap(const struct AES_ctx* kek, const uint8_t* in, size_t wrapped_length, uint8_t* out)
+{
+  return (AES_KW_unwrap_batch(kek, in, wrapped_length, 1, out) == 0) ? 0 : -1;
+}
+
+int AES_KWP_unwrap(const struct AES_ctx* kek, const uint8_t* in, size_t wrapped_length, uint8_t* out, size_t* length)
+{
+  return (AES_KWP_unwrap_batch(kek, in, wrapped_length, 1, out, length) == 0) ? 0 : -1;
+}
+#endif
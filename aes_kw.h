@@ -0,0 +1,62 @@
+#ifndef _AES_KW_H_
+#define _AES_KW_H_
+
+#include <stdint.h>
+#include "aes.h"
+
+// AES key wrap: AES-KW (RFC 3394) and AES-KWP, with padding (RFC 5649),
+// both NIST SP 800-38F.
+//
+// Wrapping a key of n 64-bit semiblocks takes 6n block operations, each
+// depending on the one before. The batch functions wrap many keys of the same
+// length under one KEK and run the chains of AES_KW_TILE_KEYS keys side by
+// side: every step encrypts one block per key in a single call of the block
+// kernel (aes_backend.h). The _openmp versions in aes_openmp.h split a batch
+// over threads.
+//
+// The kek context only supplies the key (AES_init_ctx()). Unwrapping needs the
+// inverse cipher, so it is there when CBC or ECB is enabled.
+
+#ifndef AES_KW_TILE_KEYS
+  #define AES_KW_TILE_KEYS 16
+#endif
+
+#define AES_KW_SEMIBLOCK 8
+
+// AES-KW: length is a multiple of 8 and at least 16; out receives length + 8
+// bytes. Returns 0, or -1 if length is not allowed.
+int AES_KW_wrap(const struct AES_ctx* kek, const uint8_t* in, size_t length, uint8_t* out);
+
+// AES-KWP: any length from 1 to 2^32 - 1; out receives
+// AES_KWP_wrapped_length(length) bytes. Returns 0, or -1 if length is not
+// allowed.
+size_t AES_KWP_wrapped_length(size_t length);
+int AES_KWP_wrap(const struct AES_ctx* kek, const uint8_t* in, size_t length, uint8_t* out);
+
+// count keys of length bytes each, back to back in in; the wrapped keys go back
+// to back into out (each AES_KW: length + 8, AES_KWP: AES_KWP_wrapped_length()
+// bytes). in and out must not overlap. Returns 0, or -1 if length is not
+// allowed.
+int AES_KW_wrap_batch(const struct AES_ctx* kek, const uint8_t* in, size_t length, size_t count, uint8_t* out);
+int AES_KWP_wrap_batch(const struct AES_ctx* kek, const uint8_t* in, size_t length, size_t count, uint8_t* out);
+
+#if (defined(CBC) && (CBC == 1)) || (defined(ECB) && (ECB == 1))
+// AES-KW: wrapped_length bytes in, wrapped_length - 8 out. Returns 0 if the
+// integrity check passes; otherwise -1, and out is wiped.
+int AES_KW_unwrap(const struct AES_ctx* kek, const uint8_t* in, size_t wrapped_length, uint8_t* out);
+
+// AES-KWP: out needs room for wrapped_length - 8 bytes and *length receives
+// the unpadded key length. Returns 0 or -1 as above.
+int AES_KWP_unwrap(const struct AES_ctx* kek, const uint8_t* in, size_t wrapped_length, uint8_t* out, size_t* length);
+
+// count wrapped keys of wrapped_length bytes each; key k is unwrapped to
+// out + k * (wrapped_length - 8), and for AES-KWP its length goes to
+// lengths[k]. Returns the number of keys that failed the check (and were
+// wiped), or -1 if wrapped_length is not allowed.
+long AES_KW_unwrap_batch(const struct AES_ctx* kek, const uint8_t* in, size_t wrapped_length, size_t count, uint8_t* out);
+long AES_KWP_unwrap_batch(const struct AES_ctx* kek, const uint8_t* in, size_t wrapped_length, size_t count,
+                          uint8_t* out, size_t* lengths);
+#endif
+
+
+#endif // _AES_KW_H_
@@ -0,0 +1,419 @@
+/*
+
+CMAC and the Merkle-tree MAC (aes_mac.h).
+
+Level k of the tree has ceil(leaves / 2^k) nodes and node j of it covers
+leaves j * 2^k .. (j + 1) * 2^k - 1. The proof for a range is what a
+depth-first walk from the root meets outside the range: the walk stops at
+nodes that lie wholly inside the range (the reader recomputes those from the
+chunks) or wholly outside it (those go into the proof), so it only goes down
+the two paths to the ends of the range. Generating and checking a proof walk
+the tree in the same order.
+
+*/
+
+#include <string.h>
+#include "aes.h"
+#include "aes_mac.h"
+#include "aes_gcm.h"
+#include "aes_util.h"
+
+struct cmac
+{
+  const struct AES_ctx* ctx;
+  const uint8_t* k1;
+  const uint8_t* k2;
+  uint8_t x[AES_BLOCKLEN];
+  uint8_t block[AES_BLOCKLEN];
+  size_t n;
+};
+
+// out = in * x in GF(2^128), the CMAC subkey doubling
+static void Double(const uint8_t* in, uint8_t* out)
+{
+  const uint8_t carry = in[0] >> 7;
+  int i;
+  for (i = 0; i < AES_BLOCKLEN - 1; ++i)
+  {
+    out[i] = (uint8_t)((in[i] << 1) | (in[i + 1] >> 7));
+  }
+  out[AES_BLOCKLEN - 1] = (uint8_t)((in[AES_BLOCKLEN - 1] << 1) ^ (0x87 & (0 - carry)));
+}
+
+static void Subkeys(const struct AES_ctx* ctx, uint8_t* k1, uint8_t* k2)
+{
+  uint8_t L[AES_BLOCKLEN] = { 0 };
+  AES_block_encrypt(ctx, L);
+  Double(L, k1);
+  Double(k1, k2);
+  Wipe(L, sizeof(L));
+}
+
+static void CmacStart(struct cmac* c, const struct AES_ctx* ctx, const uint8_t* k1, const uint8_t* k2)
+{
+  c->ctx = ctx;
+  c->k1 = k1;
+  c->k2 = k2;
+  memset(c->x, 0, AES_BLOCKLEN);
+  c->n = 0;
+}
+
+// A full block is only absorbed once more data follows it: the last block is
+// treated differently
+static void CmacUpdate(struct cmac* c, const uint8_t* data, size_t length)
+{
+  size_t i, take;
+
+  while (length > 0)
+  {
+    if (c->n == AES_BLOCKLEN)
+    {
+      for (i = 0; i < AES_BLOCKLEN; ++i)
+      {
+        c->x[i] ^= c->block[i];
+      }
+      AES_block_encrypt(c->ctx, c->x);
+      c->n = 0;
+    }
+    take = (AES_BLOCKLEN - c->n < length) ? (AES_BLOCKLEN - c->n) : length;
+    memcpy(c->block + c->n, data, take);
+    c->n += take;
+    data += take;
+    length -= take;
+  }
+}
+
+static void CmacFinish(struct cmac* c, uint8_t* mac)
+{
+  const uint8_t* k = c->k1;
+  size_t i;
+
+  if (c->n < AES_BLOCKLEN)
+  {
+    c->block[c->n] = 0x80;
+    memset(c->block + c->n + 1, 0, AES_BLOCKLEN - c->n - 1);
+    k = c->k2;
+  }
+  for (i = 0; i < AES_BLOCKLEN; ++i)
+  {
+    c->x[i] ^= c->block[i] ^ k[i];
+  }
+  AES_block_encrypt(c->ctx, c->x);
+  memcpy(mac, c->x, AES_MAC_LEN);
+  Wipe(c, sizeof(*c));
+}
+
+// Key number label: E(label || 0 || i) for the blocks of one key
+static void DeriveKey(const struct AES_ctx* master, uint8_t label, struct AES_ctx* ctx)
+{
+  uint8_t key[((AES_KEYLEN + AES_BLOCKLEN - 1) / AES_BLOCKLEN) * AES_BLOCKLEN] = { 0 };
+  size_t i;
+
+  for (i = 0; i < sizeof(key); i += AES_BLOCKLEN)
+  {
+    key[i] = label;
+    key[i + AES_BLOCKLEN - 1] = (uint8_t)(i / AES_BLOCKLEN);
+    AES_block_encrypt(master, key + i);
+  }
+  AES_init_ctx(ctx, key);
+  Wipe(key, sizeof(key));
+}
+
+static size_t Width(const struct AES_mac_tree* tree, size_t level)
+{
+  return ((tree->leaves - 1) >> level) + 1;
+}
+
+static uint8_t* NodeAt(const struct AES_mac_tree* tree, size_t level, size_t j)
+{
+  size_t k, offset = 0;
+  for (k = 0; k < level; ++k)
+  {
+    offset += Width(tree, k);
+  }
+  return tree->nodes + (offset + j) * AES_MAC_LEN;
+}
+
+static size_t ChunkLength(const struct AES_mac_tree* tree, size_t index)
+{
+  const size_t offset = index * tree->chunk_size;
+  return (tree->length - offset < tree->chunk_size) ? (tree->length - offset) : tree->chunk_size;
+}
+
+static void Leaf(const struct AES_mac_tree* tree, size_t index, const uint8_t* chunk, size_t length, uint8_t* out)
+{
+  uint8_t head[9];
+
+  if (tree->leaf == AES_MAC_LEAF_GMAC)
+  {
+    uint8_t nonce[12] = { 0 };
+    uint8_t none[1];
+    Store64Be(nonce + 4, (uint64_t)index);
+    AES_GCM_encrypt(&tree->leaf_ctx, nonce, sizeof(nonce), chunk, length, none, 0, out);
+  }
+  else
+  {
+    struct cmac c;
+    head[0] = 0x00;
+    Store64Be(head + 1, (uint64_t)index);
+    CmacStart(&c, &tree->leaf_ctx, tree->leaf_k1, tree->leaf_k2);
+    CmacUpdate(&c, head, sizeof(head));
+    CmacUpdate(&c, chunk, length);
+    CmacFinish(&c, out);
+  }
+}
+
+static void Inner(const struct AES_mac_tree* tree, const uint8_t* left, const uint8_t* right, uint8_t* out)
+{
+  static const uint8_t head = 0x01;
+  struct cmac c;
+  CmacStart(&c, &tree->node_ctx, tree->node_k1, tree->node_k2);
+  CmacUpdate(&c, &head, 1);
+  CmacUpdate(&c, left, AES_MAC_LEN);
+  CmacUpdate(&c, right, AES_MAC_LEN);
+  CmacFinish(&c, out);
+}
+
+static void Tag(const struct AES_mac_tree* tree, const uint8_t* root, uint8_t* tag)
+{
+  uint8_t head[18];
+  struct cmac c;
+
+  head[0] = 0x02;
+  Store64Be(head + 1, (uint64_t)tree->length);
+  Store64Be(head + 9, (uint64_t)tree->chunk_size);
+  head[17] = (uint8_t)tree->leaf;
+  CmacStart(&c, &tree->node_ctx, tree->node_k1, tree->node_k2);
+  CmacUpdate(&c, head, sizeof(head));
+  CmacUpdate(&c, root, AES_MAC_LEN);
+  CmacFinish(&c, tag);
+}
+
+// Whether node j of a level lies wholly outside, wholly inside or across the
+// leaf range first .. last
+enum span { OUTSIDE, INSIDE, ACROSS };
+
+static enum span Span(const struct AES_mac_tree* tree, size_t level, size_t j, size_t first, size_t last)
+{
+  const size_t lo = j << level;
+  size_t hi = ((j + 1) << level) - 1;
+  hi = (hi < tree->leaves - 1) ? hi : tree->leaves - 1;
+
+  if (hi < first || lo > last)
+  {
+    return OUTSIDE;
+  }
+  return (first <= lo && hi <= last) ? INSIDE : ACROSS;
+}
+
+static void Collect(const struct AES_mac_tree* tree, size_t level, size_t j, size_t first, size_t last,
+                    uint8_t* proof, size_t* count)
+{
+  switch (Span(tree, level, j, first, last))
+  {
+    case OUTSIDE:
+      memcpy(proof + (*count)++ * AES_MAC_LEN, NodeAt(tree, level, j), AES_MAC_LEN);
+      break;
+    case INSIDE:
+      break;
+    case ACROSS:
+      Collect(tree, level - 1, 2 * j, first, last, proof, count);
+      if (2 * j + 1 < Width(tree, level - 1))
+      {
+        Collect(tree, level - 1, 2 * j + 1, first, last, proof, count);
+      }
+      break;
+  }
+}
+
+// Node j of a level from the chunks alone; data starts at chunk first
+static void Subtree(const struct AES_mac_tree* tree, size_t level, size_t j, const uint8_t* data, size_t first, uint8_t* out)
+{
+  uint8_t left[AES_MAC_LEN], right[AES_MAC_LEN];
+
+  if (level == 0)
+  {
+    Leaf(tree, j, data + (j - first) * tree->chunk_size, ChunkLength(tree, j), out);
+    return;
+  }
+  Subtree(tree, level - 1, 2 * j, data, first, left);
+  if (2 * j + 1 < Width(tree, level - 1))
+  {
+    Subtree(tree, level - 1, 2 * j + 1, data, first, right);
+    Inner(tree, left, right, out);
+  }
+  else
+  {
+    memcpy(out, left, AES_MAC_LEN);
+  }
+}
+
+// Node j of a level from the chunks and the proof; -1 if the proof runs out
+static int Recompute(const struct AES_mac_tree* tree, size_t level, size_t j, size_t first, size_t last,
+                     const uint8_t* data, const uint8_t* proof, size_t proof_count, size_t* used, uint8_t* out)
+{
+  uint8_t left[AES_MAC_LEN], right[AES_MAC_LEN];
+
+  switch (Span(tree, level, j, first, last))
+  {
+    case OUTSIDE:
+      if (*used == proof_count)
+      {
+        return -1;
+      }
+      memcpy(out, proof + (*used)++ * AES_MAC_LEN, AES_MAC_LEN);
+      return 0;
+    case INSIDE:
+      Subtree(tree, level, j, data, first, out);
+      return 0;
+    default:
+      if (Recompute(tree, level - 1, 2 * j, first, last, data, proof, proof_count, used, left) != 0)
+      {
+        return -1;
+      }
+      if (2 * j + 1 < Width(tree, level - 1))
+      {
+        if (Recompute(tree, level - 1, 2 * j + 1, first, last, data, proof, proof_count, used, right) != 0)
+        {
+          return -1;
+        }
+        Inner(tree, left, right, out);
+      }
+      else
+      {
+        memcpy(out, left, AES_MAC_LEN);
+      }
+      return 0;
+  }
+}
+
+
+/*****************************************************************************/
+/* Public functions:                                                         */
+/*****************************************************************************/
+void AES_CMAC(const struct AES_ctx* ctx, const uint8_t* data, size_t length, uint8_t* mac)
+{
+  uint8_t k1[AES_BLOCKLEN], k2[AES_BLOCKLEN];
+  struct cmac c;
+
+  Subkeys(ctx, k1, k2);
+  CmacStart(&c, ctx, k1, k2);
+  CmacUpdate(&c, data, length);
+  CmacFinish(&c, mac);
+  Wipe(k1, sizeof(k1));
+  Wipe(k2, sizeof(k2));
+}
+
+size_t AES_mac_tree_size(size_t chunk_size, size_t length)
+{
+  size_t width = (length == 0) ? 1 : (length + chunk_size - 1) / chunk_size;
+  size_t nodes = width;
+
+  while (width > 1)
+  {
+    width = (width + 1) / 2;
+    nodes += width;
+  }
+  return nodes * AES_MAC_LEN;
+}
+
+void AES_mac_tree_init(struct AES_mac_tree* tree, const uint8_t* key, enum AES_mac_leaf leaf,
+                       size_t chunk_size, size_t length, void* memory)
+{
+  struct AES_ctx master;
+
+  AES_init_ctx(&master, key);
+  DeriveKey(&master, 1, &tree->leaf_ctx);
+  DeriveKey(&master, 2, &tree->node_ctx);
+  Wipe(&master, sizeof(master));
+  Subkeys(&tree->leaf_ctx, tree->leaf_k1, tree->leaf_k2);
+  Subkeys(&tree->node_ctx, tree->node_k1, tree->node_k2);
+
+  tree->leaf = leaf;
+  tree->chunk_size = chunk_size;
+  tree->length = length;
+  tree->leaves = (length == 0) ? 1 : (length + chunk_size - 1) / chunk_size;
+  for (tree->levels = 1; Width(tree, tree->levels - 1) > 1; ++tree->levels)
+  {
+  }
+  tree->nodes = (uint8_t*)memory;
+}
+
+void AES_mac_tree_leaves(struct AES_mac_tree* tree, const uint8_t* data, size_t first, size_t count)
+{
+  size_t i;
+  for (i = first; i < first + count; ++i)
+  {
+    Leaf(tree, i, data + (i - first) * tree->chunk_size, ChunkLength(tree, i), tree->nodes + i * AES_MAC_LEN);
+  }
+}
+
+void AES_mac_tree_finish(struct AES_mac_tree* tree, uint8_t* tag)
+{
+  const uint8_t* below = tree->nodes;
+  uint8_t* level = tree->nodes;
+  size_t k, j, width;
+
+  for (k = 1; k < tree->levels; ++k)
+  {
+    width = Width(tree, k - 1);
+    level += width * AES_MAC_LEN;
+    for (j = 0; 2 * j < width; ++j)
+    {
+      if (2 * j + 1 < width)
+      {
+        Inner(tree, below + 2 * j * AES_MAC_LEN, below + (2 * j + 1) * AES_MAC_LEN, level + j * AES_MAC_LEN);
+      }
+      else
+      {
+        memcpy(level + j * AES_MAC_LEN, below + 2 * j * AES_MAC_LEN, AES_MAC_LEN);
+      }
+    }
+    below = level;
+  }
+  Tag(tree, below, tag);
+}
+
+void AES_mac_tree_build(struct AES_mac_tree* tree, const uint8_t* data, uint8_t* tag)
+{
+  AES_mac_tree_leaves(tree, data, 0, tree->leaves);
+  AES_mac_tree_finish(tree, tag);
+}
+
+size_t AES_mac_tree_proof_max(const struct AES_mac_tree* tree)
+{
+  return 2 * (tree->levels - 1);
+}
+
+size_t AES_mac_tree_proof(const struct AES_mac_tree* tree, size_t first, size_t count, uint8_t* proof)
+{
+  size_t n = 0;
+  if (count > 0 && first + count <= tree->leaves)
+  {
+    Collect(tree, tree->levels - 1, 0, first, first + count - 1, proof, &n);
+  }
+  return n;
+}
+
+int AES_mac_tree_verify(const struct AES_mac_tree* tree, const uint8_t* tag, size_t first, size_t count,
+                        const uint8_t* data, const uint8_t* proof, size_t proof_count)
+{
+  uint8_t root[AES_MAC_LEN], expected[AES_MAC_LEN];
+  uint8_t diff = 0;
+  size_t used = 0;
+  int i;
+
+  if (count == 0 || first + count > tree->leaves ||
+      Recompute(tree, tree->levels - 1, 0, first, first + count - 1, data, proof, proof_count, &used, root) != 0 ||
+      used != proof_count)
+  {
+    return -1;
+  }
+  Tag(tree, root, expected);
+  // Compare in constant time
+  for (i = 0; i < AES_MAC_LEN; ++i)
+  {
+    diff |= (uint8_t)(expected[i] ^ tag[i]);
+  }
+  return (diff != 0) ? -1 : 0;
+}
@@ -0,0 +1,86 @@
+#ifndef _AES_MAC_H_
+#define _AES_MAC_H_
+
+#include <stdint.h>
+#include "aes.h"
+
+#define AES_MAC_LEN 16
+
+// CMAC (RFC 4493, NIST SP 800-38B) of length bytes
+void AES_CMAC(const struct AES_ctx* ctx, const uint8_t* data, size_t length, uint8_t* mac);
+
+
+// Merkle-tree MAC over a large object, so that a reader of a few chunks can
+// check them against the one trusted tag without reading the rest.
+//
+// The object is cut into chunks of chunk_size bytes (an empty object is one
+// empty chunk). Leaf i is a MAC of chunk i bound to i: CMAC of 0x00 || i || chunk,
+// or GMAC (AES_GCM_encrypt() with no plaintext) under a nonce holding i.
+// Every inner node is the CMAC of 0x01 || left || right; a node without a right
+// sibling is carried up as it is. The tag is the CMAC of the root together with
+// the object length and chunk size. Leaves and inner nodes use separate keys
+// derived from the one given.
+//
+// The tree is kept next to the object, untrusted; only the tag needs
+// protecting. To check a range of chunks the reader takes the tree nodes
+// bordering the range, at most two per level (AES_mac_tree_proof()), and
+// recomputes the tag (AES_mac_tree_verify()).
+//
+// GMAC leaves are faster with PCLMULQDQ but, like any GMAC, must never see two
+// different chunks under the same key and index: use a fresh key for every
+// version of an object. CMAC leaves have no such rule.
+
+enum AES_mac_leaf
+{
+  AES_MAC_LEAF_CMAC,
+  AES_MAC_LEAF_GMAC
+};
+
+struct AES_mac_tree
+{
+  struct AES_ctx leaf_ctx;
+  struct AES_ctx node_ctx;
+  uint8_t leaf_k1[AES_BLOCKLEN], leaf_k2[AES_BLOCKLEN];  // CMAC subkeys
+  uint8_t node_k1[AES_BLOCKLEN], node_k2[AES_BLOCKLEN];
+  enum AES_mac_leaf leaf;
+  size_t chunk_size;
+  size_t length;
+  size_t leaves;
+  size_t levels;      // including the leaves; the root level holds one node
+  uint8_t* nodes;     // AES_MAC_LEN bytes per node, level by level, leaves first
+};
+
+// Bytes of memory the nodes of a tree over length bytes take
+size_t AES_mac_tree_size(size_t chunk_size, size_t length);
+
+// memory is AES_mac_tree_size() bytes for a tree that is built, or NULL for one
+// that only verifies. chunk_size must not be 0.
+void AES_mac_tree_init(struct AES_mac_tree* tree, const uint8_t* key, enum AES_mac_leaf leaf,
+                       size_t chunk_size, size_t length, void* memory);
+
+// Computes leaves first .. first + count - 1 from data, which starts at chunk
+// first. Ranges are independent, so threads can each take one
+// (AES_mac_tree_build_openmp() in aes_openmp.h).
+void AES_mac_tree_leaves(struct AES_mac_tree* tree, const uint8_t* data, size_t first, size_t count);
+
+// Computes the inner nodes once all leaves are in, and writes the tag
+void AES_mac_tree_finish(struct AES_mac_tree* tree, uint8_t* tag);
+
+// AES_mac_tree_leaves() for all of data, then AES_mac_tree_finish()
+void AES_mac_tree_build(struct AES_mac_tree* tree, const uint8_t* data, uint8_t* tag);
+
+// The largest number of nodes AES_mac_tree_proof() writes for this tree
+size_t AES_mac_tree_proof_max(const struct AES_mac_tree* tree);
+
+// The nodes a reader of chunks first .. first + count - 1 needs besides the
+// chunks, AES_MAC_LEN bytes each; returns how many were written
+size_t AES_mac_tree_proof(const struct AES_mac_tree* tree, size_t first, size_t count, uint8_t* proof);
+
+// Checks chunks first .. first + count - 1 (data, starting at chunk first)
+// against the tag, with the proof_count nodes from AES_mac_tree_proof().
+// Returns 0 if they are authentic, -1 otherwise.
+int AES_mac_tree_verify(const struct AES_mac_tree* tree, const uint8_t* tag, size_t first, size_t count,
+                        const uint8_t* data, const uint8_t* proof, size_t proof_count);
+
+
+#endif // _AES_MAC_H_
@@ -13,23 +13,75 @@ its own counter value and encrypts it independently.
 #include <omp.h>
 #include "aes.h"
 #include "aes_openmp.h"
+#include "aes_backend.h"
+#include "aes_instrument.h"
+#include "aes_util.h"
 // #include <stdio.h>
-/*
- * Increment IV by a specified number of blocks
- * Directly adds the blocks count to the IV without looping for each block
- * Treats the 16-byte IV as a big-endian 128-bit counter
- */
-static void IncrementIvBy(uint8_t* Iv, size_t blocks)
+
+#if AES_OPENMP_IMBALANCE
+static struct AES_openmp_imbalance imbalance;
+
+// Folds the per-thread timings of one call into the shared profile
+static void RecordImbalance(const struct AES_openmp_thread_profile* prof, unsigned threads,
+                            size_t length, double region_seconds)
+{
+  unsigned t, straggler = 0;
+  double max_busy = 0.0, sum_busy = 0.0;
+
+  if (threads > AES_OPENMP_MAX_THREADS)
+  {
+    threads = AES_OPENMP_MAX_THREADS;
+  }
+
+  for (t = 0; t < threads; ++t)
+  {
+    double busy = prof[t].end - prof[t].start;
+    sum_busy += busy;
+    if (busy > max_busy)
+    {
+      max_busy = busy;
+    }
+    if (prof[t].end > prof[straggler].end)
+    {
+      straggler = t;
+    }
+  }
+
+  #pragma omp critical(aes_openmp_imbalance)
+  {
+    imbalance.length = length;
+    imbalance.threads = threads;
+    imbalance.region_seconds = region_seconds;
+    imbalance.max_busy_seconds = max_busy;
+    imbalance.mean_busy_seconds = sum_busy / threads;
+    imbalance.imbalance = (sum_busy > 0.0) ? (max_busy * threads / sum_busy) : 1.0;
+    imbalance.straggler = straggler;
+    memcpy(imbalance.thread, prof, threads * sizeof(*prof));
+
+    imbalance.calls += 1;
+    imbalance.mean_imbalance += (imbalance.imbalance - imbalance.mean_imbalance) / imbalance.calls;
+    if (imbalance.imbalance > imbalance.worst_imbalance)
+    {
+      imbalance.worst_imbalance = imbalance.imbalance;
+    }
+    imbalance.straggler_count[straggler] += 1;
+  }
+}
+#endif // #if AES_OPENMP_IMBALANCE
+
+uint64_t AES_openmp_imbalance(struct AES_openmp_imbalance* out)
 {
-  // Add 'blocks' directly to the IV counter (treating it as big-endian)
-  // Process from right to left, adding byte by byte with carry
-  size_t carry = blocks;
-  for (int i = (AES_BLOCKLEN - 1); i >= 0 && carry > 0; --i)
+  uint64_t calls = 0;
+
+  memset(out, 0, sizeof(*out));
+#if AES_OPENMP_IMBALANCE
+  #pragma omp critical(aes_openmp_imbalance)
   {
-    size_t sum = Iv[i] + (carry & 0xFF);
-    Iv[i] = (uint8_t)(sum & 0xFF);
-    carry = (carry >> 8) + (sum >> 8);
+    memcpy(out, &imbalance, sizeof(*out));
+    calls = imbalance.calls;
   }
+#endif
+  return calls;
 }
 
 /*
@@ -37,9 +89,10 @@ static void IncrementIvBy(uint8_t* Iv, size_t blocks)
  *
  * Parallelization approach:
  * - Save initial IV before parallel region (all threads need same starting point)
+ * - Each thread takes one contiguous chunk of blocks (the schedule(static) split)
  * - Each thread calculates IV for its assigned block using IncrementIvBy
- * - Threads encrypt their counters independently with AES_ECB_encrypt
- * - XOR encrypted counter with plaintext/ciphertext
+ * - Threads encrypt tiles of counters with the selected block kernel (aes_backend.h)
+ * - XOR encrypted counters with plaintext/ciphertext using the selected XOR kernel
  * - Update main context IV to next counter value after all threads complete
  * - Handle remaining bytes sequentially
  */
@@ -53,40 +106,111 @@ void AES_CTR_xcrypt_buffer_openmp(struct AES_ctx* ctx, uint8_t* buf, size_t leng
   // Save initial IV so all threads reference the same starting point
   uint8_t initial_iv[AES_BLOCKLEN];
   memcpy(initial_iv, ctx->Iv, AES_BLOCKLEN);
+  // Look the kernels up once; every thread uses the same ones
+  const AES_block_fn encrypt_blocks = AES_backend_block();
+  const AES_xor_fn xor_bytes = AES_backend_xor();
+  AES_KERNEL_ENTER(ctr, length, omp_get_thread_num(), AES_STATS_OPENMP);
+  AES_PROBE(parallel_begin, length, omp_get_max_threads(), AES_STATS_OPENMP);
+  AES_TRACE_BEGIN(region_trace);
+#if AES_OPENMP_IMBALANCE || AES_USDT
+  unsigned team_size = 1;  // what the runtime gave us, set by thread 0
+#endif
+#if AES_OPENMP_IMBALANCE
+  struct AES_openmp_thread_profile prof[AES_OPENMP_MAX_THREADS];
+  const double region_start = omp_get_wtime();
+#endif
 
   // Parallel block encryption
-  #pragma omp parallel private(buffer, i)
+  #pragma omp parallel private(i)
   {
     uint8_t thread_iv[AES_BLOCKLEN];
+    uint8_t keystream[AES_OPENMP_TILE_BLOCKS * AES_BLOCKLEN];
     struct AES_ctx thread_local_ctx;
     memcpy(thread_local_ctx.RoundKey, ctx->RoundKey, AES_keyExpSize);
 
-    #pragma omp for schedule(static)
-    for (size_t block_idx = 0; block_idx < num_blocks; ++block_idx)
+#if AES_STATS
+    #pragma omp master
     {
-      // Each thread computes the IV for its block index
-      memcpy(thread_iv, initial_iv, AES_BLOCKLEN);
+      AES_STATS_PARALLEL((unsigned)omp_get_num_threads());
+    }
+#endif
 
-      // Increment this thread's IV copy by the block index
-      IncrementIvBy(thread_iv, block_idx);
+    // Split the blocks the same way schedule(static) does - one contiguous chunk
+    // per thread, the first (num_blocks % nthreads) threads getting one extra
+    // block - but explicitly, so each chunk can be observed as a unit.
+    const size_t tid = (size_t)omp_get_thread_num();
+    const size_t nthreads = (size_t)omp_get_num_threads();
+    const size_t chunk = num_blocks / nthreads;
+    const size_t extra = num_blocks % nthreads;
+    const size_t first_block = (tid * chunk) + ((tid < extra) ? tid : extra);
+    const size_t end_block = first_block + chunk + ((tid < extra) ? 1 : 0);
 
-      // Encrypt the counter value
-      memcpy(buffer, thread_iv, AES_BLOCKLEN);
-      AES_ECB_encrypt(&thread_local_ctx, buffer);
+    AES_PROBE(chunk_begin, (end_block - first_block) * AES_BLOCKLEN, tid, AES_STATS_OPENMP);
+    AES_TRACE_BEGIN(chunk_trace);
+#if AES_OPENMP_IMBALANCE
+    const double chunk_start = omp_get_wtime();
+#endif
+    // Each thread computes the IV for its first block once, then steps it by one
+    memcpy(thread_iv, initial_iv, AES_BLOCKLEN);
+    IncrementBy(thread_iv, first_block);
 
-      // XOR encrypted counter with plaintext/ciphertext
-      size_t buf_idx = block_idx * AES_BLOCKLEN;
-      for (i = 0; i < AES_BLOCKLEN; ++i)
+    for (size_t block_idx = first_block; block_idx < end_block; block_idx += AES_OPENMP_TILE_BLOCKS)
+    {
+      size_t tile = end_block - block_idx;
+      if (tile > AES_OPENMP_TILE_BLOCKS)
       {
-        buf[buf_idx + i] ^= buffer[i];
+        tile = AES_OPENMP_TILE_BLOCKS;
       }
+
+      // Lay out a tile of counter values and encrypt them in one kernel call
+      for (i = 0; i < tile; ++i)
+      {
+        memcpy(keystream + (i * AES_BLOCKLEN), thread_iv, AES_BLOCKLEN);
+        IncrementBy(thread_iv, 1);
+      }
+      encrypt_blocks(&thread_local_ctx, keystream, tile);
+
+      // XOR encrypted counters with plaintext/ciphertext
+      xor_bytes(buf + (block_idx * AES_BLOCKLEN), keystream, tile * AES_BLOCKLEN);
+    }
+#if AES_OPENMP_IMBALANCE
+    if (tid < AES_OPENMP_MAX_THREADS)
+    {
+      prof[tid].start = chunk_start - region_start;
+      prof[tid].end = omp_get_wtime() - region_start;
+      prof[tid].blocks = end_block - first_block;
+    }
+#endif
+#if AES_OPENMP_IMBALANCE || AES_USDT
+    if (tid == 0)
+    {
+      team_size = (unsigned)nthreads;
+    }
+#endif
+    AES_PROBE(chunk_end, (end_block - first_block) * AES_BLOCKLEN, tid, AES_STATS_OPENMP);
+    AES_TRACE_END("ctr_chunk", AES_TRACE_CHUNK, (end_block - first_block) * AES_BLOCKLEN, (int)tid, chunk_trace);
+#if AES_TRACE
+    // The implicit barrier at the end of the region cannot be timed, so when
+    // recording put an explicit one in front of it. region_trace is shared,
+    // so either every thread of the team reaches the barrier or none does.
+    if (region_trace != 0)
+    {
+      AES_TRACE_BEGIN(wait_trace);
+      #pragma omp barrier
+      AES_TRACE_END("ctr_wait", AES_TRACE_WAIT, 0, (int)tid, wait_trace);
     }
+#endif
   }  // End parallel region - all threads synchronize here
+  AES_TRACE_END("ctr_parallel", AES_TRACE_PARALLEL, length, omp_get_thread_num(), region_trace);
+  AES_PROBE(parallel_end, length, team_size, AES_STATS_OPENMP);
+#if AES_OPENMP_IMBALANCE
+  RecordImbalance(prof, team_size, length, omp_get_wtime() - region_start);
+#endif
 
   // Update main context IV to next counter value for any future operations
   // This maintains the same behavior as the sequential AES_CTR_xcrypt_buffer
   memcpy(ctx->Iv, initial_iv, AES_BLOCKLEN);
-  IncrementIvBy(ctx->Iv, num_blocks);
+  IncrementBy(ctx->Iv, num_blocks);
 
   // Handle remaining bytes (less than one full block) sequentially
   // This follows the same pattern as the original function
@@ -96,7 +220,7 @@ void AES_CTR_xcrypt_buffer_openmp(struct AES_ctx* ctx, uint8_t* buf, size_t leng
     memcpy(remainder_ctx.RoundKey, ctx->RoundKey, AES_keyExpSize);
 
     memcpy(buffer, ctx->Iv, AES_BLOCKLEN);
-    AES_ECB_encrypt(&remainder_ctx, buffer);
+    AES_block_encrypt(&remainder_ctx, buffer);
 
     uint8_t bi = 0;
     for (i = (num_blocks * AES_BLOCKLEN); i < length; ++i, ++bi)
@@ -105,7 +229,352 @@ void AES_CTR_xcrypt_buffer_openmp(struct AES_ctx* ctx, uint8_t* buf, size_t leng
     }
 
     // Increment IV one more time
-    IncrementIvBy(ctx->Iv, 1);
+    IncrementBy(ctx->Iv, 1);
+    AES_STATS_TAIL();
   }
+  AES_KERNEL_EXIT(ctr, AES_STATS_CTR, length, omp_get_thread_num(), AES_STATS_OPENMP);
 }
 
+int AES_drbg_fill_openmp(struct AES_drbg* drbg, uint8_t* out, size_t length)
+{
+  struct AES_drbg snapshots[AES_OPENMP_DRBG_REQUESTS];
+  int status = 0;
+
+  while (length > 0 && status == 0)
+  {
+    size_t reserved = 0, done = 0;
+    int r;
+
+    // Sequential: each request's state depends on the one before
+    for (; reserved < AES_OPENMP_DRBG_REQUESTS && done < length; ++reserved)
+    {
+      const size_t n = (length - done < AES_DRBG_MAX_REQUEST) ? (length - done) : AES_DRBG_MAX_REQUEST;
+      if (AES_drbg_reserve(drbg, &snapshots[reserved], n) != 0)
+      {
+        status = -1;
+        break;
+      }
+      done += n;
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (r = 0; r < (int)reserved; ++r)
+    {
+      const size_t offset = (size_t)r * AES_DRBG_MAX_REQUEST;
+      const size_t n = (done - offset < AES_DRBG_MAX_REQUEST) ? (done - offset) : AES_DRBG_MAX_REQUEST;
+      AES_drbg_output(&snapshots[r], out + offset, n);
+      AES_drbg_uninstantiate(&snapshots[r]);
+    }
+
+    out += done;
+    length -= done;
+  }
+  return status;
+}
+
+// The calling thread's share of count values, split like the CTR chunks above
+static void ThreadRange(size_t count, size_t* first, size_t* n)
+{
+  const size_t tid = (size_t)omp_get_thread_num();
+  const size_t nthreads = (size_t)omp_get_num_threads();
+  const size_t chunk = count / nthreads;
+  const size_t extra = count % nthreads;
+  *first = (tid * chunk) + ((tid < extra) ? tid : extra);
+  *n = chunk + ((tid < extra) ? 1 : 0);
+}
+
+void AES_rng_u32_openmp(const struct AES_rng* rng, uint64_t stream, uint64_t position, uint32_t* out, size_t count)
+{
+  #pragma omp parallel
+  {
+    size_t first, n;
+    ThreadRange(count, &first, &n);
+    AES_rng_u32(rng, stream, position + first, out + first, n);
+  }
+}
+
+void AES_rng_u64_openmp(const struct AES_rng* rng, uint64_t stream, uint64_t position, uint64_t* out, size_t count)
+{
+  #pragma omp parallel
+  {
+    size_t first, n;
+    ThreadRange(count, &first, &n);
+    AES_rng_u64(rng, stream, position + first, out + first, n);
+  }
+}
+
+void AES_rng_double_openmp(const struct AES_rng* rng, uint64_t stream, uint64_t position, double* out, size_t count)
+{
+  #pragma omp parallel
+  {
+    size_t first, n;
+    ThreadRange(count, &first, &n);
+    AES_rng_double(rng, stream, position + first, out + first, n);
+  }
+}
+
+#if defined(CTR) && (CTR == 1)
+void AES_CTR_reencrypt_buffer_openmp(struct AES_ctx* from, struct AES_ctx* to, uint8_t* buf, size_t length)
+{
+  const size_t num_blocks = (length + AES_BLOCKLEN - 1) / AES_BLOCKLEN;
+  const AES_block_fn encrypt_blocks = AES_backend_block();
+  const AES_xor_fn xor_bytes = AES_backend_xor();
+  AES_KERNEL_ENTER(ctr_reencrypt, length, omp_get_thread_num(), AES_STATS_OPENMP);
+
+  #pragma omp parallel
+  {
+    uint8_t old_stream[AES_OPENMP_TILE_BLOCKS * AES_BLOCKLEN];
+    uint8_t new_stream[AES_OPENMP_TILE_BLOCKS * AES_BLOCKLEN];
+    struct AES_ctx from_key, to_key;
+    size_t first, n, block_idx, i;
+
+    ThreadRange(num_blocks, &first, &n);
+    memcpy(&from_key, from, sizeof(from_key));
+    memcpy(&to_key, to, sizeof(to_key));
+    IncrementBy(from_key.Iv, first);
+    IncrementBy(to_key.Iv, first);
+
+    for (block_idx = first; block_idx < first + n; block_idx += AES_OPENMP_TILE_BLOCKS)
+    {
+      const size_t tile = (first + n - block_idx < AES_OPENMP_TILE_BLOCKS) ? (first + n - block_idx) : AES_OPENMP_TILE_BLOCKS;
+      const size_t offset = block_idx * AES_BLOCKLEN;
+      const size_t bytes = (length - offset < tile * AES_BLOCKLEN) ? (length - offset) : tile * AES_BLOCKLEN;
+
+      for (i = 0; i < tile; ++i)
+      {
+        memcpy(old_stream + (i * AES_BLOCKLEN), from_key.Iv, AES_BLOCKLEN);
+        memcpy(new_stream + (i * AES_BLOCKLEN), to_key.Iv, AES_BLOCKLEN);
+        IncrementBy(from_key.Iv, 1);
+        IncrementBy(to_key.Iv, 1);
+      }
+      encrypt_blocks(&from_key, old_stream, tile);
+      encrypt_blocks(&to_key, new_stream, tile);
+
+      // One pass over buf with the combined keystream
+      xor_bytes(old_stream, new_stream, bytes);
+      xor_bytes(buf + offset, old_stream, bytes);
+    }
+  }
+
+  IncrementBy(from->Iv, num_blocks);
+  IncrementBy(to->Iv, num_blocks);
+  AES_KERNEL_EXIT(ctr_reencrypt, AES_STATS_CTR, length, omp_get_thread_num(), AES_STATS_OPENMP);
+}
+
+// Each thread checksums its own chunk from zero; the partial CRCs are then
+// combined in chunk order
+static void CtrCrc32cOpenmp(struct AES_ctx* ctx, uint8_t* buf, size_t length, uint32_t* crc, int of_output)
+{
+  const size_t num_blocks = (length + AES_BLOCKLEN - 1) / AES_BLOCKLEN;
+  const AES_block_fn encrypt_blocks = AES_backend_block();
+  const AES_xor_fn xor_bytes = AES_backend_xor();
+  uint32_t partial[AES_OPENMP_MAX_THREADS];
+  size_t partial_bytes[AES_OPENMP_MAX_THREADS];
+  int threads = omp_get_max_threads();
+  int t;
+  AES_KERNEL_ENTER(ctr_crc32c, length, omp_get_thread_num(), AES_STATS_OPENMP);
+
+  if (threads > AES_OPENMP_MAX_THREADS)
+  {
+    threads = AES_OPENMP_MAX_THREADS;
+  }
+
+  #pragma omp parallel num_threads(threads)
+  {
+    uint8_t stream[AES_OPENMP_TILE_BLOCKS * AES_BLOCKLEN];
+    struct AES_ctx key;
+    const size_t tid = (size_t)omp_get_thread_num();
+    uint32_t c = 0;
+    size_t first, n, block_idx, i, done = 0;
+
+    #pragma omp single
+    threads = omp_get_num_threads();
+
+    ThreadRange(num_blocks, &first, &n);
+    memcpy(&key, ctx, sizeof(key));
+    IncrementBy(key.Iv, first);
+
+    for (block_idx = first; block_idx < first + n; block_idx += AES_OPENMP_TILE_BLOCKS)
+    {
+      const size_t tile = (first + n - block_idx < AES_OPENMP_TILE_BLOCKS) ? (first + n - block_idx) : AES_OPENMP_TILE_BLOCKS;
+      const size_t offset = block_idx * AES_BLOCKLEN;
+      const size_t bytes = (length - offset < tile * AES_BLOCKLEN) ? (length - offset) : tile * AES_BLOCKLEN;
+
+      for (i = 0; i < tile; ++i)
+      {
+        memcpy(stream + (i * AES_BLOCKLEN), key.Iv, AES_BLOCKLEN);
+        IncrementBy(key.Iv, 1);
+      }
+      encrypt_blocks(&key, stream, tile);
+
+      if (!of_output)
+      {
+        c = AES_crc32c(c, buf + offset, bytes);
+      }
+      xor_bytes(buf + offset, stream, bytes);
+      if (of_output)
+      {
+        c = AES_crc32c(c, buf + offset, bytes);
+      }
+      done += bytes;
+    }
+    partial[tid] = c;
+    partial_bytes[tid] = done;
+  }
+
+  for (t = 0; t < threads; ++t)
+  {
+    *crc = AES_crc32c_combine(*crc, partial[t], partial_bytes[t]);
+  }
+  IncrementBy(ctx->Iv, num_blocks);
+  AES_KERNEL_EXIT(ctr_crc32c, AES_STATS_CTR, length, omp_get_thread_num(), AES_STATS_OPENMP);
+}
+
+void AES_CTR_encrypt_buffer_crc32c_openmp(struct AES_ctx* ctx, uint8_t* buf, size_t length, uint32_t* crc)
+{
+  CtrCrc32cOpenmp(ctx, buf, length, crc, 1);
+}
+
+void AES_CTR_decrypt_buffer_crc32c_openmp(struct AES_ctx* ctx, uint8_t* buf, size_t length, uint32_t* crc)
+{
+  CtrCrc32cOpenmp(ctx, buf, length, crc, 0);
+}
+#endif // #if defined(CTR) && (CTR == 1)
+
+int AES_stream_seal_openmp(const struct AES_stream* stream, const uint8_t* aad, size_t aad_len,
+                           const uint8_t* in, size_t length, uint8_t* out)
+{
+  const size_t sealed_chunk = stream->chunk_size + AES_GCM_TAGLEN;
+  size_t chunks;
+
+  if (stream->chunk_size == 0 || (chunks = AES_stream_chunks(stream, length)) > AES_STREAM_MAX_CHUNKS)
+  {
+    return -1;
+  }
+
+  #pragma omp parallel
+  {
+    size_t first, n, i;
+    ThreadRange(chunks, &first, &n);
+    for (i = first; i < first + n; ++i)
+    {
+      const size_t offset = i * stream->chunk_size;
+      const size_t bytes = (length - offset < stream->chunk_size) ? (length - offset) : stream->chunk_size;
+      uint8_t* chunk = out + i * sealed_chunk;
+
+      memcpy(chunk, in + offset, bytes);
+      AES_stream_seal_chunk(stream, (uint32_t)i, i + 1 == chunks, aad, aad_len, chunk, bytes, chunk + bytes);
+    }
+  }
+  return 0;
+}
+
+long AES_stream_open_openmp(const struct AES_stream* stream, const uint8_t* aad, size_t aad_len,
+                            const uint8_t* in, size_t sealed_length, uint8_t* out)
+{
+  const size_t sealed_chunk = stream->chunk_size + AES_GCM_TAGLEN;
+  const size_t length = AES_stream_plain_length(stream, sealed_length);
+  size_t chunks;
+  long failed = 0;
+
+  if (length == (size_t)-1 || (chunks = AES_stream_chunks(stream, length)) > AES_STREAM_MAX_CHUNKS)
+  {
+    return -1;
+  }
+
+  #pragma omp parallel reduction(+:failed)
+  {
+    size_t first, n, i;
+    ThreadRange(chunks, &first, &n);
+    for (i = first; i < first + n; ++i)
+    {
+      const size_t offset = i * stream->chunk_size;
+      const size_t bytes = (length - offset < stream->chunk_size) ? (length - offset) : stream->chunk_size;
+      const uint8_t* chunk = in + i * sealed_chunk;
+
+      memcpy(out + offset, chunk, bytes);
+      if (AES_stream_open_chunk(stream, (uint32_t)i, i + 1 == chunks, aad, aad_len, out + offset, bytes, chunk + bytes) != 0)
+      {
+        ++failed;
+      }
+    }
+  }
+  return failed;
+}
+
+void AES_mac_tree_build_openmp(struct AES_mac_tree* tree, const uint8_t* data, uint8_t* tag)
+{
+  #pragma omp parallel
+  {
+    size_t first, n;
+    ThreadRange(tree->leaves, &first, &n);
+    AES_mac_tree_leaves(tree, data + first * tree->chunk_size, first, n);
+  }
+  AES_mac_tree_finish(tree, tag);
+}
+
+int AES_KW_wrap_batch_openmp(const struct AES_ctx* kek, const uint8_t* in, size_t length, size_t count, uint8_t* out)
+{
+  int result = 0;
+
+  #pragma omp parallel reduction(|:result)
+  {
+    size_t first, n;
+    ThreadRange(count, &first, &n);
+    result |= AES_KW_wrap_batch(kek, in + first * length, length, n, out + first * (length + AES_KW_SEMIBLOCK));
+  }
+  return result;
+}
+
+int AES_KWP_wrap_batch_openmp(const struct AES_ctx* kek, const uint8_t* in, size_t length, size_t count, uint8_t* out)
+{
+  const size_t stride = AES_KWP_wrapped_length(length);
+  int result = 0;
+
+  #pragma omp parallel reduction(|:result)
+  {
+    size_t first, n;
+    ThreadRange(count, &first, &n);
+    result |= AES_KWP_wrap_batch(kek, in + first * length, length, n, out + first * stride);
+  }
+  return result;
+}
+
+#if (defined(CBC) && (CBC == 1)) || (defined(ECB) && (ECB == 1))
+long AES_KW_unwrap_batch_openmp(const struct AES_ctx* kek, const uint8_t* in, size_t wrapped_length, size_t count, uint8_t* out)
+{
+  long failed = 0;
+
+  if (wrapped_length % AES_KW_SEMIBLOCK != 0 || wrapped_length < 3 * AES_KW_SEMIBLOCK)
+  {
+    return -1;
+  }
+  #pragma omp parallel reduction(+:failed)
+  {
+    size_t first, n;
+    ThreadRange(count, &first, &n);
+    failed += AES_KW_unwrap_batch(kek, in + first * wrapped_length, wrapped_length, n,
+                                  out + first * (wrapped_length - AES_KW_SEMIBLOCK));
+  }
+  return failed;
+}
+
+long AES_KWP_unwrap_batch_openmp(const struct AES_ctx* kek, const uint8_t* in, size_t wrapped_length, size_t count,
+                                 uint8_t* out, size_t* lengths)
+{
+  long failed = 0;
+
+  if (wrapped_length % AES_KW_SEMIBLOCK != 0 || wrapped_length < 2 * AES_KW_SEMIBLOCK)
+  {
+    return -1;
+  }
+  #pragma omp parallel reduction(+:failed)
+  {
+    size_t first, n;
+    ThreadRange(count, &first, &n);
+    failed += AES_KWP_unwrap_batch(kek, in + first * wrapped_length, wrapped_length, n,
+                                   out + first * (wrapped_length - AES_KW_SEMIBLOCK), lengths + first);
+  }
+  return failed;
+}
+#endif
@@ -2,9 +2,118 @@
 #define _AES_OPENMP_H_
 
 #include "aes.h"
+#include "aes_drbg.h"
+#include "aes_rng.h"
+#include "aes_fused.h"
+#include "aes_stream.h"
+#include "aes_mac.h"
+#include "aes_kw.h"
+
+// Counter blocks each thread lays out and encrypts per block-kernel call
+#ifndef AES_OPENMP_TILE_BLOCKS
+  #define AES_OPENMP_TILE_BLOCKS 8
+#endif
 
 // OpenMP parallel version of AES CTR mode (with RoundKey copying for cache efficiency)
 // This function parallelizes the CTR mode encryption/decryption across multiple threads
 void AES_CTR_xcrypt_buffer_openmp(struct AES_ctx* ctx, uint8_t* buf, size_t length);
 
+// Generate requests reserved up front per parallel region of AES_drbg_fill_openmp()
+#ifndef AES_OPENMP_DRBG_REQUESTS
+  #define AES_OPENMP_DRBG_REQUESTS 64
+#endif
+
+// AES_drbg_fill() with the generate requests spread over threads: the same
+// output and the same state afterwards. The state chain is advanced in the
+// calling thread (AES_drbg_reserve() costs a few blocks per request), then the
+// requests' output is produced in parallel.
+int AES_drbg_fill_openmp(struct AES_drbg* drbg, uint8_t* out, size_t length);
+
+// AES_rng_u32() / _u64() / _double() with the values split over threads, one
+// contiguous range each; every thread jumps straight to its first position,
+// so the output is the sequential one
+void AES_rng_u32_openmp(const struct AES_rng* rng, uint64_t stream, uint64_t position, uint32_t* out, size_t count);
+void AES_rng_u64_openmp(const struct AES_rng* rng, uint64_t stream, uint64_t position, uint64_t* out, size_t count);
+void AES_rng_double_openmp(const struct AES_rng* rng, uint64_t stream, uint64_t position, double* out, size_t count);
+
+#if defined(CTR) && (CTR == 1)
+// AES_CTR_reencrypt_buffer() with the blocks split over threads like
+// AES_CTR_xcrypt_buffer_openmp(); each thread generates and combines both
+// keystreams for its own chunk
+void AES_CTR_reencrypt_buffer_openmp(struct AES_ctx* from, struct AES_ctx* to, uint8_t* buf, size_t length);
+
+// AES_CTR_encrypt_buffer_crc32c() / AES_CTR_decrypt_buffer_crc32c() with the
+// blocks split over threads; each thread checksums its chunk and the partial
+// CRCs are joined with AES_crc32c_combine(), so *crc is the sequential one
+void AES_CTR_encrypt_buffer_crc32c_openmp(struct AES_ctx* ctx, uint8_t* buf, size_t length, uint32_t* crc);
+void AES_CTR_decrypt_buffer_crc32c_openmp(struct AES_ctx* ctx, uint8_t* buf, size_t length, uint32_t* crc);
+#endif
+
+// AES_stream_seal() / AES_stream_open() with the chunks split over threads,
+// a contiguous run of chunks each. in and out must not overlap.
+int AES_stream_seal_openmp(const struct AES_stream* stream, const uint8_t* aad, size_t aad_len,
+                           const uint8_t* in, size_t length, uint8_t* out);
+long AES_stream_open_openmp(const struct AES_stream* stream, const uint8_t* aad, size_t aad_len,
+                            const uint8_t* in, size_t sealed_length, uint8_t* out);
+
+// AES_mac_tree_build() with the leaves split over threads, a contiguous run
+// each; the inner nodes, about one per leaf and a few blocks each, are then
+// done by the calling thread
+void AES_mac_tree_build_openmp(struct AES_mac_tree* tree, const uint8_t* data, uint8_t* tag);
+
+// The AES-KW/KWP batch functions with the keys split over threads, a
+// contiguous run each; every thread runs its keys in tiles as usual. Return
+// values as for the sequential ones.
+int AES_KW_wrap_batch_openmp(const struct AES_ctx* kek, const uint8_t* in, size_t length, size_t count, uint8_t* out);
+int AES_KWP_wrap_batch_openmp(const struct AES_ctx* kek, const uint8_t* in, size_t length, size_t count, uint8_t* out);
+#if (defined(CBC) && (CBC == 1)) || (defined(ECB) && (ECB == 1))
+long AES_KW_unwrap_batch_openmp(const struct AES_ctx* kek, const uint8_t* in, size_t wrapped_length, size_t count, uint8_t* out);
+long AES_KWP_unwrap_batch_openmp(const struct AES_ctx* kek, const uint8_t* in, size_t wrapped_length, size_t count,
+                                 uint8_t* out, size_t* lengths);
+#endif
+
+
+// #define AES_OPENMP_IMBALANCE to 1 to record, for every parallel call, when each
+// thread started and finished its chunk and how many blocks it did. This shows
+// whether schedule(static) leaves threads idle behind a straggler on a noisy host.
+// Costs two omp_get_wtime() calls per thread per call; compiled out by default.
+#ifndef AES_OPENMP_IMBALANCE
+  #define AES_OPENMP_IMBALANCE 0
+#endif
+
+// Threads beyond this are still used, just not profiled
+#ifndef AES_OPENMP_MAX_THREADS
+  #define AES_OPENMP_MAX_THREADS 256
+#endif
+
+struct AES_openmp_thread_profile
+{
+  double start;   // seconds from entering the call until the thread began its chunk
+  double end;     // seconds from entering the call until the thread finished its chunk
+  size_t blocks;  // blocks in the thread's chunk
+};
+
+struct AES_openmp_imbalance
+{
+  // The most recent profiled call
+  size_t length;
+  unsigned threads;
+  double region_seconds;       // wall time of the whole parallel region
+  double max_busy_seconds;     // longest end - start over all threads
+  double mean_busy_seconds;
+  double imbalance;            // max_busy / mean_busy; 1.0 means perfectly balanced
+  unsigned straggler;          // thread that finished last
+  struct AES_openmp_thread_profile thread[AES_OPENMP_MAX_THREADS];
+
+  // Accumulated over all profiled calls
+  uint64_t calls;
+  double mean_imbalance;
+  double worst_imbalance;
+  uint64_t straggler_count[AES_OPENMP_MAX_THREADS];  // how often each thread finished last
+};
+
+// Copies the profile into *out. Returns the number of profiled calls so far,
+// i.e. 0 if nothing was recorded (or AES_OPENMP_IMBALANCE is 0).
+uint64_t AES_openmp_imbalance(struct AES_openmp_imbalance* out);
+
 #endif // _AES_OPENMP_H_
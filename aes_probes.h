@@ -0,0 +1,60 @@
+#ifndef _AES_PROBES_H_
+#define _AES_PROBES_H_
+
+// USDT (SystemTap/DTrace style) static tracepoints, provider "tiny_aes".
+//
+// A probe site is a single nop plus an ELF note until a tracer attaches, so the
+// probes are left enabled whenever <sys/sdt.h> is available. #define AES_USDT
+// to 0 to drop them, or to 1 to insist on them.
+//
+// Every probe carries the same three arguments:
+//   arg0  length in bytes the probe refers to
+//   arg1  thread: omp_get_thread_num() in aes_openmp.c, 0 in the sequential
+//         kernels (use the tracer's own tid for the OS thread)
+//   arg2  backend, an enum AES_stats_backend value (0 sequential, 1 openmp,
+//         2 batch)
+//
+// Probes:
+//   ecb_encrypt_entry/exit, ecb_decrypt_entry/exit,
+//   cbc_encrypt_entry/exit, cbc_decrypt_entry/exit,
+//   ctr_entry/exit           public mode functions (both backends)
+//   parallel_begin/end       around the OpenMP parallel region; arg1 is the requested
+//                            thread count at begin and the actual team size at end
+//   chunk_begin/end          around the blocks one thread handles inside that region
+//   batch_ecb_encrypt_entry/exit,
+//   batch_ctr_entry/exit     the aes_batch.c kernels over a context table
+//   batch_ctr_packets_entry/exit  packet-vector CTR under one key
+//   ctr_reencrypt_entry/exit,
+//   cbc_reencrypt_entry/exit fused key-rotation passes (aes_fused.h; CTR on both backends)
+//   ctr_crc32c_entry/exit,
+//   cbc_encrypt_crc32c_entry/exit,
+//   cbc_decrypt_crc32c_entry/exit  encryption fused with CRC32C (aes_fused.h; CTR on both backends)
+//   gcm_encrypt_entry/exit,
+//   gcm_decrypt_entry/exit   single-pass AES-GCM (aes_gcm.h)
+//   kw_wrap_entry/exit,
+//   kw_unwrap_entry/exit     AES-KW/KWP batches (aes_kw.h); arg0 is the key bytes
+//
+// e.g.  bpftrace -e 'usdt:./benchmark.elf:tiny_aes:chunk_end { @[arg1] = count(); }'
+
+#ifndef AES_USDT
+  #if defined(__linux__) && defined(__has_include)
+    #if __has_include(<sys/sdt.h>)
+      #define AES_USDT 1
+    #endif
+  #endif
+#endif
+
+#ifndef AES_USDT
+  #define AES_USDT 0
+#endif
+
+#if AES_USDT
+  #include <sys/sdt.h>
+  #define AES_PROBE(name, length, thread, backend) \
+      DTRACE_PROBE3(tiny_aes, name, (size_t)(length), (int)(thread), (int)(backend))
+#else
+  #define AES_PROBE(name, length, thread, backend) do { } while (0)
+#endif
+
+
+#endif // _AES_PROBES_H_
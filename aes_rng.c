@@ -0,0 +1,155 @@
+/*
+
+Counter-based random numbers (aes_rng.h).
+
+Every call lays out the counter blocks it needs and permutes them, a tile of
+AES_RNG_TILE_BLOCKS at a time. The full cipher goes through the selected block
+kernel (aes_backend.h); ARS runs the tile round by round with the round
+functions from aes.c, so the blocks of a tile are independent work in every
+round.
+
+*/
+
+#include <string.h>
+#include "aes.h"
+#include "aes_rng.h"
+#include "aes_backend.h"
+#include "aes_util.h"
+
+static const uint64_t weyl[2] = { 0x9E3779B97F4A7C15ULL, 0xBB67AE8584CAA73BULL };
+
+// length bytes of stream output starting skip bytes into block
+static void Bytes(const struct AES_rng* rng, uint64_t stream, uint64_t block, size_t skip, uint8_t* out, size_t length)
+{
+  uint8_t tile[AES_RNG_TILE_BLOCKS * AES_BLOCKLEN];
+
+  while (length > 0)
+  {
+    size_t n = (skip + length + AES_BLOCKLEN - 1) / AES_BLOCKLEN;
+    size_t take;
+
+    n = (n < AES_RNG_TILE_BLOCKS) ? n : AES_RNG_TILE_BLOCKS;
+    AES_rng_blocks(rng, stream, block, tile, n);
+    take = n * AES_BLOCKLEN - skip;
+    take = (take < length) ? take : length;
+    memcpy(out, tile + skip, take);
+
+    out += take;
+    length -= take;
+    block += n;
+    skip = 0;
+  }
+}
+
+
+/*****************************************************************************/
+/* Public functions:                                                         */
+/*****************************************************************************/
+int AES_rng_init(struct AES_rng* rng, uint64_t key0, uint64_t key1, unsigned rounds)
+{
+  uint8_t key[AES_KEYLEN] = { 0 };
+  unsigned r;
+
+  if (rounds > AES_RNG_MAX_ROUNDS)
+  {
+    return -1;
+  }
+  rng->rounds = rounds;
+  Store64Le(key, key0);
+  Store64Le(key + 8, key1);
+
+  if (rounds == AES_RNG_FULL)
+  {
+    AES_init_ctx(&rng->ctx, key);
+  }
+  else
+  {
+    for (r = 0; r <= rounds; ++r)
+    {
+      Store64Le(rng->ctx.RoundKey + r * AES_BLOCKLEN, key0 + r * weyl[0]);
+      Store64Le(rng->ctx.RoundKey + r * AES_BLOCKLEN + 8, key1 + r * weyl[1]);
+    }
+  }
+  Wipe(key, sizeof(key));
+  return 0;
+}
+
+void AES_rng_blocks(const struct AES_rng* rng, uint64_t stream, uint64_t block, uint8_t* out, size_t nblocks)
+{
+  size_t i, j, t;
+  unsigned r;
+
+  for (i = 0; i < nblocks; ++i)
+  {
+    Store64Le(out + i * AES_BLOCKLEN, block + i);
+    Store64Le(out + i * AES_BLOCKLEN + 8, stream);
+  }
+
+  if (rng->rounds == AES_RNG_FULL)
+  {
+    AES_backend_block()(&rng->ctx, out, nblocks);
+    return;
+  }
+
+  for (t = 0; t < nblocks; t += AES_RNG_TILE_BLOCKS)
+  {
+    const size_t n = (nblocks - t < AES_RNG_TILE_BLOCKS) ? (nblocks - t) : AES_RNG_TILE_BLOCKS;
+    uint8_t* tile = out + t * AES_BLOCKLEN;
+
+    for (i = 0; i < n * AES_BLOCKLEN; i += AES_BLOCKLEN)
+    {
+      for (j = 0; j < AES_BLOCKLEN; ++j)
+      {
+        tile[i + j] ^= rng->ctx.RoundKey[j];
+      }
+    }
+    for (r = 1; r < rng->rounds; ++r)
+    {
+      for (i = 0; i < n; ++i)
+      {
+        AES_block_round(tile + i * AES_BLOCKLEN, rng->ctx.RoundKey + r * AES_BLOCKLEN);
+      }
+    }
+    for (i = 0; i < n; ++i)
+    {
+      AES_block_last_round(tile + i * AES_BLOCKLEN, rng->ctx.RoundKey + rng->rounds * AES_BLOCKLEN);
+    }
+  }
+}
+
+void AES_rng_u32(const struct AES_rng* rng, uint64_t stream, uint64_t position, uint32_t* out, size_t count)
+{
+  uint8_t* bytes = (uint8_t*)out;
+  size_t i;
+
+  Bytes(rng, stream, position / 4, (size_t)(position % 4) * 4, bytes, count * 4);
+  for (i = 0; i < count; ++i)
+  {
+    const uint8_t* p = bytes + i * 4;
+    out[i] = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+  }
+}
+
+void AES_rng_u64(const struct AES_rng* rng, uint64_t stream, uint64_t position, uint64_t* out, size_t count)
+{
+  uint8_t* bytes = (uint8_t*)out;
+  size_t i;
+
+  Bytes(rng, stream, position / 2, (size_t)(position % 2) * 8, bytes, count * 8);
+  for (i = 0; i < count; ++i)
+  {
+    out[i] = Load64Le(bytes + i * 8);
+  }
+}
+
+void AES_rng_double(const struct AES_rng* rng, uint64_t stream, uint64_t position, double* out, size_t count)
+{
+  uint8_t* bytes = (uint8_t*)out;
+  size_t i;
+
+  Bytes(rng, stream, position / 2, (size_t)(position % 2) * 8, bytes, count * 8);
+  for (i = 0; i < count; ++i)
+  {
+    out[i] = (double)(Load64Le(bytes + i * 8) >> 11) * (1.0 / 9007199254740992.0);
+  }
+}
@@ -0,0 +1,62 @@
+#ifndef _AES_RNG_H_
+#define _AES_RNG_H_
+
+#include <stdint.h>
+#include "aes.h"
+
+// Counter-based random numbers for simulations, after ARS from Salmon et al.,
+// "Parallel random numbers: as easy as 1, 2, 3" (SC11).
+//
+// Output block n of stream s is a keyed permutation of the counter (n, s):
+//
+//   counter bytes 0..7   n, little-endian
+//   counter bytes 8..15  s, little-endian
+//
+// so any position of any stream is computed directly - there is no state to
+// step, skipping ahead is O(1), and threads that each take a range of
+// positions (AES_rng_*_openmp() in aes_openmp.h) reproduce exactly the
+// sequential output.
+//
+// The permutation is either the full cipher of this build, or ARS: rounds
+// AES rounds whose round keys are a Weyl sequence, key + i * (0x9E3779B97F4A7C15,
+// 0xBB67AE8584CAA73B) on the two little-endian 64-bit halves. ARS is not a
+// cipher and must not be used for anything that needs one; it is fast and
+// statistically sound for simulation. Output is not bit-compatible with the
+// Random123 library.
+
+// Pass as rounds for the full cipher
+#define AES_RNG_FULL 0
+
+// ARS rounds used by the Random123 ars4x32 default
+#define AES_RNG_ARS_ROUNDS 7
+
+#define AES_RNG_MAX_ROUNDS 10
+
+// Counter blocks laid out and permuted per call of the round functions
+#ifndef AES_RNG_TILE_BLOCKS
+  #define AES_RNG_TILE_BLOCKS 8
+#endif
+
+struct AES_rng
+{
+  struct AES_ctx ctx;  // the cipher's key schedule, or the ARS round keys
+  unsigned rounds;     // AES_RNG_FULL or 1 .. AES_RNG_MAX_ROUNDS
+};
+
+// key0 and key1 are written little-endian as the first 16 key bytes (the rest
+// of a longer AES key is zero). Returns 0, or -1 for an invalid rounds.
+int AES_rng_init(struct AES_rng* rng, uint64_t key0, uint64_t key1, unsigned rounds);
+
+// Output blocks block .. block + nblocks - 1 of stream, 16 bytes each
+void AES_rng_blocks(const struct AES_rng* rng, uint64_t stream, uint64_t block, uint8_t* out, size_t nblocks);
+
+// count values starting at value index position of stream. Blocks are read as
+// four little-endian uint32 or two uint64, so value i of the u32 sequence is
+// bytes 4i .. 4i+3 of the stream's output. A double takes the top 53 bits of
+// the matching uint64 and is uniform on [0, 1).
+void AES_rng_u32(const struct AES_rng* rng, uint64_t stream, uint64_t position, uint32_t* out, size_t count);
+void AES_rng_u64(const struct AES_rng* rng, uint64_t stream, uint64_t position, uint64_t* out, size_t count);
+void AES_rng_double(const struct AES_rng* rng, uint64_t stream, uint64_t position, double* out, size_t count);
+
+
+#endif // _AES_RNG_H_
@@ -0,0 +1,162 @@
+/*
+
+Built-in statistics counters for the AES kernels.
+
+Every thread that runs a kernel claims a private, cache-line aligned slot on
+first use and from then on only ever writes to that slot. A slot is written by
+its owner with plain relaxed load/store pairs, so counting costs a handful of
+non-atomic instructions per call. AES_stats_snapshot() walks all claimed slots
+and sums them, which is the only place where the per-thread data is combined.
+
+Compile with -DAES_STATS=1 to enable; otherwise only the (all-zero) snapshot
+API is left in this file.
+
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+#include "aes.h"
+#include "aes_stats.h"
+
+#if AES_STATS
+#include <stdatomic.h>
+#include <time.h>
+
+#define STATS_CALLS  0
+#define STATS_BYTES  1
+#define STATS_BLOCKS 2
+#define STATS_NANOS  3
+
+struct stats_slot
+{
+  _Alignas(64) _Atomic uint64_t kernel[AES_STATS_BACKEND_COUNT][AES_STATS_MODE_COUNT][4];
+  _Atomic uint64_t parallel_regions;
+  _Atomic uint64_t threads_used;
+  _Atomic uint64_t max_threads;
+  _Atomic uint64_t tail_fallbacks;
+};
+
+// The last slot is shared by all threads that did not get a private one.
+static struct stats_slot slots[AES_STATS_MAX_THREADS + 1];
+static atomic_uint slots_claimed;
+static _Thread_local struct stats_slot* this_slot;
+
+static struct stats_slot* get_slot(void)
+{
+  if (this_slot == NULL)
+  {
+    unsigned idx = atomic_fetch_add_explicit(&slots_claimed, 1, memory_order_relaxed);
+    this_slot = &slots[(idx < AES_STATS_MAX_THREADS) ? idx : AES_STATS_MAX_THREADS];
+  }
+  return this_slot;
+}
+
+// Private slots have a single writer, so a relaxed load + store is enough and
+// avoids the locked read-modify-write. The shared overflow slot needs the real thing.
+static void add(struct stats_slot* slot, _Atomic uint64_t* counter, uint64_t n)
+{
+  if (slot != &slots[AES_STATS_MAX_THREADS])
+  {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n, memory_order_relaxed);
+  }
+  else
+  {
+    atomic_fetch_add_explicit(counter, n, memory_order_relaxed);
+  }
+}
+
+uint64_t AES_stats_clock(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+void AES_stats_kernel(enum AES_stats_backend backend, enum AES_stats_mode mode, size_t length, uint64_t start)
+{
+  struct stats_slot* slot = get_slot();
+  _Atomic uint64_t* c = slot->kernel[backend][mode];
+
+  add(slot, &c[STATS_CALLS], 1);
+  add(slot, &c[STATS_BYTES], length);
+  add(slot, &c[STATS_BLOCKS], (length + AES_BLOCKLEN - 1) / AES_BLOCKLEN);
+  if (start != 0)
+  {
+    add(slot, &c[STATS_NANOS], AES_stats_clock() - start);
+  }
+}
+
+void AES_stats_parallel(unsigned threads)
+{
+  struct stats_slot* slot = get_slot();
+
+  add(slot, &slot->parallel_regions, 1);
+  add(slot, &slot->threads_used, threads);
+
+  // CAS rather than load/store so the shared overflow slot keeps the true maximum.
+  uint64_t seen = atomic_load_explicit(&slot->max_threads, memory_order_relaxed);
+  while (threads > seen &&
+         !atomic_compare_exchange_weak_explicit(&slot->max_threads, &seen, threads,
+                                                memory_order_relaxed, memory_order_relaxed))
+  {
+  }
+}
+
+void AES_stats_tail(void)
+{
+  struct stats_slot* slot = get_slot();
+  add(slot, &slot->tail_fallbacks, 1);
+}
+#endif // #if AES_STATS
+
+void AES_stats_snapshot(struct AES_stats* stats)
+{
+  memset(stats, 0, sizeof(*stats));
+
+#if AES_STATS
+  unsigned claimed = atomic_load_explicit(&slots_claimed, memory_order_relaxed);
+  unsigned used = (claimed < AES_STATS_MAX_THREADS) ? claimed : AES_STATS_MAX_THREADS + 1;
+  unsigned s, b, m;
+
+  for (s = 0; s < used; ++s)
+  {
+    const struct stats_slot* slot = &slots[s];
+    for (b = 0; b < AES_STATS_BACKEND_COUNT; ++b)
+    {
+      for (m = 0; m < AES_STATS_MODE_COUNT; ++m)
+      {
+        struct AES_stats_counter* out = &stats->kernel[b][m];
+        out->calls       += atomic_load_explicit(&slot->kernel[b][m][STATS_CALLS], memory_order_relaxed);
+        out->bytes       += atomic_load_explicit(&slot->kernel[b][m][STATS_BYTES], memory_order_relaxed);
+        out->blocks      += atomic_load_explicit(&slot->kernel[b][m][STATS_BLOCKS], memory_order_relaxed);
+        out->nanoseconds += atomic_load_explicit(&slot->kernel[b][m][STATS_NANOS], memory_order_relaxed);
+      }
+    }
+    stats->parallel_regions += atomic_load_explicit(&slot->parallel_regions, memory_order_relaxed);
+    stats->threads_used     += atomic_load_explicit(&slot->threads_used, memory_order_relaxed);
+    stats->tail_fallbacks   += atomic_load_explicit(&slot->tail_fallbacks, memory_order_relaxed);
+
+    uint64_t max_threads = atomic_load_explicit(&slot->max_threads, memory_order_relaxed);
+    if (max_threads > stats->max_threads)
+    {
+      stats->max_threads = max_threads;
+    }
+  }
+  stats->threads_seen = claimed;
+#endif
+}
+
+const char* AES_stats_mode_name(enum AES_stats_mode mode)
+{
+  static const char* const names[AES_STATS_MODE_COUNT] = {
+    "ecb_encrypt", "ecb_decrypt", "cbc_encrypt", "cbc_decrypt", "ctr", "gcm",
+    "kw_wrap", "kw_unwrap" };
+  return ((unsigned)mode < AES_STATS_MODE_COUNT) ? names[mode] : "unknown";
+}
+
+const char* AES_stats_backend_name(enum AES_stats_backend backend)
+{
+  static const char* const names[AES_STATS_BACKEND_COUNT] = { "sequential", "openmp", "batch" };
+  return ((unsigned)backend < AES_STATS_BACKEND_COUNT) ? names[backend] : "unknown";
+}
@@ -0,0 +1,93 @@
+#ifndef _AES_STATS_H_
+#define _AES_STATS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// #define AES_STATS to 1 to compile in the built-in statistics counters.
+// With the default of 0 every hook in aes.c and aes_openmp.c expands to nothing
+// and AES_stats_snapshot() reports zeros.
+//
+// Counters are kept per thread and are only summed up when a snapshot is taken,
+// so the hot paths never write to a shared cache line.
+#ifndef AES_STATS
+  #define AES_STATS 0
+#endif
+
+// Number of threads that get a private counter slot. Any threads beyond that
+// share one overflow slot (updated with atomic adds instead of plain stores).
+#ifndef AES_STATS_MAX_THREADS
+  #define AES_STATS_MAX_THREADS 64
+#endif
+
+enum AES_stats_mode
+{
+  AES_STATS_ECB_ENCRYPT,
+  AES_STATS_ECB_DECRYPT,
+  AES_STATS_CBC_ENCRYPT,
+  AES_STATS_CBC_DECRYPT,
+  AES_STATS_CTR,
+  AES_STATS_GCM,
+  AES_STATS_KW_WRAP,
+  AES_STATS_KW_UNWRAP,
+  AES_STATS_MODE_COUNT
+};
+
+enum AES_stats_backend
+{
+  AES_STATS_SEQUENTIAL,  // aes.c
+  AES_STATS_OPENMP,      // aes_openmp.c
+  AES_STATS_BATCH,       // aes_batch.c
+  AES_STATS_BACKEND_COUNT
+};
+
+struct AES_stats_counter
+{
+  uint64_t calls;
+  uint64_t bytes;
+  uint64_t blocks;       // a trailing partial block counts as one block
+  uint64_t nanoseconds;  // wall time spent inside the kernel; single-block ECB calls are not timed
+};
+
+struct AES_stats
+{
+  struct AES_stats_counter kernel[AES_STATS_BACKEND_COUNT][AES_STATS_MODE_COUNT];
+  uint64_t parallel_regions;  // entries into an OpenMP parallel region
+  uint64_t threads_used;      // sum of the team sizes of those regions
+  uint64_t max_threads;       // largest team seen
+  uint64_t tail_fallbacks;    // parallel calls that finished a partial block sequentially
+  uint32_t threads_seen;      // threads that have recorded at least one event
+};
+
+// Sums the per-thread counters into *stats. Counters only ever grow, so export
+// the difference between two snapshots to get rates.
+// Safe to call while other threads are encrypting; the result is then a
+// consistent-enough view for monitoring, not an exact cut.
+void AES_stats_snapshot(struct AES_stats* stats);
+
+const char* AES_stats_mode_name(enum AES_stats_mode mode);
+const char* AES_stats_backend_name(enum AES_stats_backend backend);
+
+
+// Hooks used by the kernels themselves.
+#if AES_STATS
+uint64_t AES_stats_clock(void);
+void AES_stats_kernel(enum AES_stats_backend backend, enum AES_stats_mode mode, size_t length, uint64_t start);
+void AES_stats_parallel(unsigned threads);
+void AES_stats_tail(void);
+
+  #define AES_STATS_BEGIN(start)                     const uint64_t start = AES_stats_clock()
+  #define AES_STATS_END(backend, mode, length, start) AES_stats_kernel((backend), (mode), (length), (start))
+  #define AES_STATS_COUNT(backend, mode, length)      AES_stats_kernel((backend), (mode), (length), 0)
+  #define AES_STATS_PARALLEL(threads)                AES_stats_parallel(threads)
+  #define AES_STATS_TAIL()                           AES_stats_tail()
+#else
+  #define AES_STATS_BEGIN(start)
+  #define AES_STATS_END(backend, mode, length, start)
+  #define AES_STATS_COUNT(backend, mode, length)
+  #define AES_STATS_PARALLEL(threads)
+  #define AES_STATS_TAIL()
+#endif
+
+
+#endif // _AES_STATS_H_
@@ -0,0 +1,136 @@
+/*
+
+Chunked AEAD (aes_stream.h).
+
+Every chunk is an independent AES_GCM_encrypt() under its own nonce, so the
+whole-object functions are just a loop over chunks, and the OpenMP versions in
+aes_openmp.c split the same loop over threads. Chunk i of the plaintext starts
+at i * chunk_size and its sealed form at i * (chunk_size + AES_GCM_TAGLEN).
+
+*/
+
+#include <string.h>
+#include "aes.h"
+#include "aes_gcm.h"
+#include "aes_stream.h"
+
+static void Nonce(const struct AES_stream* stream, uint32_t index, int last, uint8_t* nonce)
+{
+  memcpy(nonce, stream->prefix, AES_STREAM_PREFIXLEN);
+  nonce[7] = (uint8_t)(index >> 24);
+  nonce[8] = (uint8_t)(index >> 16);
+  nonce[9] = (uint8_t)(index >> 8);
+  nonce[10] = (uint8_t)index;
+  nonce[11] = last ? 1 : 0;
+}
+
+
+/*****************************************************************************/
+/* Public functions:                                                         */
+/*****************************************************************************/
+void AES_stream_init(struct AES_stream* stream, const uint8_t* key, const uint8_t* prefix, size_t chunk_size)
+{
+  AES_init_ctx(&stream->ctx, key);
+  memcpy(stream->prefix, prefix, AES_STREAM_PREFIXLEN);
+  stream->chunk_size = chunk_size;
+}
+
+size_t AES_stream_chunks(const struct AES_stream* stream, size_t length)
+{
+  return (length == 0) ? 1 : (length + stream->chunk_size - 1) / stream->chunk_size;
+}
+
+size_t AES_stream_sealed_length(const struct AES_stream* stream, size_t length)
+{
+  return length + AES_stream_chunks(stream, length) * AES_GCM_TAGLEN;
+}
+
+size_t AES_stream_plain_length(const struct AES_stream* stream, size_t sealed_length)
+{
+  const size_t sealed_chunk = stream->chunk_size + AES_GCM_TAGLEN;
+  const size_t full = sealed_length / sealed_chunk;
+  const size_t rest = sealed_length % sealed_chunk;
+
+  if (stream->chunk_size == 0)
+  {
+    return (size_t)-1;
+  }
+  if (rest == 0)
+  {
+    return (full > 0) ? full * stream->chunk_size : (size_t)-1;
+  }
+  // A short last chunk needs its tag and, after full chunks, some data
+  if (rest < AES_GCM_TAGLEN || (rest == AES_GCM_TAGLEN && full > 0))
+  {
+    return (size_t)-1;
+  }
+  return full * stream->chunk_size + rest - AES_GCM_TAGLEN;
+}
+
+void AES_stream_seal_chunk(const struct AES_stream* stream, uint32_t index, int last,
+                           const uint8_t* aad, size_t aad_len,
+                           uint8_t* buf, size_t length, uint8_t* tag)
+{
+  uint8_t nonce[12];
+  Nonce(stream, index, last, nonce);
+  AES_GCM_encrypt(&stream->ctx, nonce, sizeof(nonce), aad, aad_len, buf, length, tag);
+}
+
+int AES_stream_open_chunk(const struct AES_stream* stream, uint32_t index, int last,
+                          const uint8_t* aad, size_t aad_len,
+                          uint8_t* buf, size_t length, const uint8_t* tag)
+{
+  uint8_t nonce[12];
+  Nonce(stream, index, last, nonce);
+  return AES_GCM_decrypt(&stream->ctx, nonce, sizeof(nonce), aad, aad_len, buf, length, tag);
+}
+
+int AES_stream_seal(const struct AES_stream* stream, const uint8_t* aad, size_t aad_len,
+                    const uint8_t* in, size_t length, uint8_t* out)
+{
+  const size_t sealed_chunk = stream->chunk_size + AES_GCM_TAGLEN;
+  size_t chunks, i;
+
+  if (stream->chunk_size == 0 || (chunks = AES_stream_chunks(stream, length)) > AES_STREAM_MAX_CHUNKS)
+  {
+    return -1;
+  }
+  // Last chunk first, so in and out can be the same buffer
+  for (i = chunks; i-- > 0; )
+  {
+    const size_t offset = i * stream->chunk_size;
+    const size_t n = (length - offset < stream->chunk_size) ? (length - offset) : stream->chunk_size;
+    uint8_t* chunk = out + i * sealed_chunk;
+
+    memmove(chunk, in + offset, n);
+    AES_stream_seal_chunk(stream, (uint32_t)i, i + 1 == chunks, aad, aad_len, chunk, n, chunk + n);
+  }
+  return 0;
+}
+
+long AES_stream_open(const struct AES_stream* stream, const uint8_t* aad, size_t aad_len,
+                     const uint8_t* in, size_t sealed_length, uint8_t* out)
+{
+  const size_t sealed_chunk = stream->chunk_size + AES_GCM_TAGLEN;
+  const size_t length = AES_stream_plain_length(stream, sealed_length);
+  size_t chunks, i;
+  long failed = 0;
+
+  if (length == (size_t)-1 || (chunks = AES_stream_chunks(stream, length)) > AES_STREAM_MAX_CHUNKS)
+  {
+    return -1;
+  }
+  for (i = 0; i < chunks; ++i)
+  {
+    const size_t offset = i * stream->chunk_size;
+    const size_t n = (length - offset < stream->chunk_size) ? (length - offset) : stream->chunk_size;
+    const uint8_t* chunk = in + i * sealed_chunk;
+
+    memmove(out + offset, chunk, n);
+    if (AES_stream_open_chunk(stream, (uint32_t)i, i + 1 == chunks, aad, aad_len, out + offset, n, chunk + n) != 0)
+    {
+      ++failed;
+    }
+  }
+  return failed;
+}
@@ -0,0 +1,70 @@
+#ifndef _AES_STREAM_H_
+#define _AES_STREAM_H_
+
+#include <stdint.h>
+#include "aes.h"
+#include "aes_gcm.h"
+
+// Chunked AEAD (the STREAM construction of Hoang, Reyhanitabar, Rogaway and
+// Vizar over AES-GCM, aes_gcm.h), so a large object can be verified and used a
+// chunk at a time instead of only after one tag over all of it.
+//
+// The plaintext is cut into chunks of chunk_size bytes, the last one shorter
+// (an empty object is one empty chunk). Chunk i is sealed on its own with the
+// 12-byte GCM nonce
+//
+//   prefix (7 bytes) || i (4 bytes, big-endian) || last (1 byte, 1 or 0)
+//
+// and its own 16-byte tag, so chunks cannot be reordered, dropped from the
+// middle or cut off at the end without a tag failing, and any chunk can be
+// opened on its own, in any order or in parallel. The sealed object is
+// ciphertext || tag for every chunk in turn.
+//
+// The prefix must be unique per object under one key; a random one from
+// AES_drbg_thread() (aes_drbg.h) is fine for up to about 2^24 objects per key.
+
+#define AES_STREAM_PREFIXLEN 7
+#define AES_STREAM_MAX_CHUNKS 0x100000000ULL
+
+struct AES_stream
+{
+  struct AES_ctx ctx;
+  uint8_t prefix[AES_STREAM_PREFIXLEN];
+  size_t chunk_size;
+};
+
+void AES_stream_init(struct AES_stream* stream, const uint8_t* key, const uint8_t* prefix, size_t chunk_size);
+
+// Chunks in an object of length plaintext bytes, and the sealed size of it
+size_t AES_stream_chunks(const struct AES_stream* stream, size_t length);
+size_t AES_stream_sealed_length(const struct AES_stream* stream, size_t length);
+
+// One chunk, in place: seal writes the tag, open checks it. open returns 0 if
+// the chunk is authentic; otherwise -1, and buf is wiped. aad is bound to
+// every chunk (pass the object's header, or NULL and 0).
+void AES_stream_seal_chunk(const struct AES_stream* stream, uint32_t index, int last,
+                           const uint8_t* aad, size_t aad_len,
+                           uint8_t* buf, size_t length, uint8_t* tag);
+int AES_stream_open_chunk(const struct AES_stream* stream, uint32_t index, int last,
+                          const uint8_t* aad, size_t aad_len,
+                          uint8_t* buf, size_t length, const uint8_t* tag);
+
+// A whole object: in (length bytes) is sealed into out, which must hold
+// AES_stream_sealed_length(); in and out may be the same buffer. Returns -1
+// if the object has more than AES_STREAM_MAX_CHUNKS chunks or chunk_size is 0.
+int AES_stream_seal(const struct AES_stream* stream, const uint8_t* aad, size_t aad_len,
+                    const uint8_t* in, size_t length, uint8_t* out);
+
+// in is a sealed object of sealed_length bytes, opened into out (the
+// plaintext length is what the chunks hold), again possibly in place. Returns
+// the number of chunks that failed (0 if the whole object is authentic) or -1
+// if sealed_length cannot be a sealed object; failed chunks are wiped in out.
+long AES_stream_open(const struct AES_stream* stream, const uint8_t* aad, size_t aad_len,
+                     const uint8_t* in, size_t sealed_length, uint8_t* out);
+
+// The plaintext length of a sealed object, or (size_t)-1 if sealed_length is
+// not a possible one
+size_t AES_stream_plain_length(const struct AES_stream* stream, size_t sealed_length);
+
+
+#endif // _AES_STREAM_H_
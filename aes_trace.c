@@ -0,0 +1,189 @@
+/*
+
+Event recorder for the AES kernels, exported as Chrome trace JSON.
+
+Each thread that records an event gets its own ring buffer on first use. The
+ring is pushed onto a global lock-free list and never freed, so the exporter
+can walk it even after the owning thread has exited. Only the owner writes to
+a ring: it fills in the slot and then publishes it by bumping the ring's head
+with a release store. The exporter reads the head with an acquire load and
+copies out the last AES_TRACE_EVENTS entries.
+
+Compile with -DAES_TRACE=1 to enable; otherwise the export writes an empty
+trace.
+
+*/
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include "aes_trace.h"
+
+#if AES_TRACE
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+#if (AES_TRACE_EVENTS & (AES_TRACE_EVENTS - 1)) != 0
+  #error AES_TRACE_EVENTS must be a power of two
+#endif
+
+struct trace_event
+{
+  const char* name;
+  uint64_t start;
+  uint64_t duration;
+  uint64_t length;
+  int32_t thread;
+  uint8_t kind;
+};
+
+struct trace_ring
+{
+  _Atomic uint64_t head;
+  long tid;
+  struct trace_ring* next;
+  struct trace_event events[AES_TRACE_EVENTS];
+};
+
+static atomic_int recording;
+static _Atomic(struct trace_ring*) rings;
+static _Thread_local struct trace_ring* this_ring;
+#if !defined(__linux__)
+static atomic_long next_tid = 1;
+#endif
+
+static uint64_t clock_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static struct trace_ring* get_ring(void)
+{
+  if (this_ring == NULL)
+  {
+    struct trace_ring* ring = (struct trace_ring*)calloc(1, sizeof(*ring));
+    if (ring == NULL)
+    {
+      return NULL;
+    }
+#if defined(__linux__)
+    ring->tid = (long)syscall(SYS_gettid);
+#else
+    ring->tid = atomic_fetch_add(&next_tid, 1);
+#endif
+    ring->next = atomic_load(&rings);
+    while (!atomic_compare_exchange_weak(&rings, &ring->next, ring))
+    {
+    }
+    this_ring = ring;
+  }
+  return this_ring;
+}
+
+uint64_t AES_trace_begin(void)
+{
+  return atomic_load_explicit(&recording, memory_order_relaxed) ? clock_ns() : 0;
+}
+
+void AES_trace_end(const char* name, enum AES_trace_kind kind, size_t length, int thread, uint64_t start)
+{
+  struct trace_ring* ring;
+
+  if (start == 0 || (ring = get_ring()) == NULL)
+  {
+    return;
+  }
+
+  uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  struct trace_event* ev = &ring->events[head & (AES_TRACE_EVENTS - 1)];
+  ev->name = name;
+  ev->start = start;
+  ev->duration = clock_ns() - start;
+  ev->length = length;
+  ev->thread = thread;
+  ev->kind = (uint8_t)kind;
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+#endif // #if AES_TRACE
+
+void AES_trace_enable(int on)
+{
+#if AES_TRACE
+  atomic_store(&recording, on != 0);
+#else
+  (void)on;
+#endif
+}
+
+int AES_trace_enabled(void)
+{
+#if AES_TRACE
+  return atomic_load(&recording);
+#else
+  return 0;
+#endif
+}
+
+void AES_trace_clear(void)
+{
+#if AES_TRACE
+  struct trace_ring* ring;
+  for (ring = atomic_load(&rings); ring != NULL; ring = ring->next)
+  {
+    atomic_store(&ring->head, 0);
+  }
+#endif
+}
+
+int AES_trace_export_json(FILE* out)
+{
+  int written = 0;
+
+  if (fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", out) < 0)
+  {
+    return -1;
+  }
+
+#if AES_TRACE
+  static const char* const categories[] = {
+    "tiny_aes.kernel", "tiny_aes.parallel", "tiny_aes.chunk", "tiny_aes.wait" };
+  const long pid = (long)getpid();
+  struct trace_ring* ring;
+
+  for (ring = atomic_load(&rings); ring != NULL; ring = ring->next)
+  {
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint64_t first = (head > AES_TRACE_EVENTS) ? (head - AES_TRACE_EVENTS) : 0;
+    uint64_t i;
+
+    for (i = first; i < head; ++i)
+    {
+      const struct trace_event* ev = &ring->events[i & (AES_TRACE_EVENTS - 1)];
+      // Chrome trace timestamps are in microseconds; keep the nanoseconds as decimals
+      if (fprintf(out,
+                  "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%ld,\"tid\":%ld,"
+                  "\"ts\":%llu.%03u,\"dur\":%llu.%03u,\"args\":{\"length\":%llu,\"thread\":%d}}",
+                  (written > 0) ? "," : "", ev->name, categories[ev->kind & 3], pid, ring->tid,
+                  (unsigned long long)(ev->start / 1000), (unsigned)(ev->start % 1000),
+                  (unsigned long long)(ev->duration / 1000), (unsigned)(ev->duration % 1000),
+                  (unsigned long long)ev->length, (int)ev->thread) < 0)
+      {
+        return -1;
+      }
+      ++written;
+    }
+  }
+#endif
+
+  if (fputs("\n]}\n", out) < 0)
+  {
+    return -1;
+  }
+  return written;
+}
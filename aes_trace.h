@@ -0,0 +1,62 @@
+#ifndef _AES_TRACE_H_
+#define _AES_TRACE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// #define AES_TRACE to 1 to compile in the event recorder. Recording then still
+// has to be switched on at run time with AES_trace_enable(1); while it is off
+// every hook costs one relaxed load.
+//
+// Each thread records into its own ring buffer of AES_TRACE_EVENTS entries
+// (oldest events are overwritten), so recording never takes a lock.
+// AES_trace_export_json() writes all rings as Chrome trace JSON, which
+// chrome://tracing and https://ui.perfetto.dev load directly. Timestamps come
+// from CLOCK_MONOTONIC, the clock most tracers use, so the file lines up with
+// traces an application records itself.
+#ifndef AES_TRACE
+  #define AES_TRACE 0
+#endif
+
+// Per-thread ring capacity; must be a power of two
+#ifndef AES_TRACE_EVENTS
+  #define AES_TRACE_EVENTS 4096
+#endif
+
+enum AES_trace_kind
+{
+  AES_TRACE_KERNEL,    // a public mode function call
+  AES_TRACE_PARALLEL,  // an OpenMP parallel region, as seen by the calling thread
+  AES_TRACE_CHUNK,     // the blocks one thread handles inside a parallel region
+  AES_TRACE_WAIT       // a thread waiting at the end of a parallel region for the others
+};
+
+// Switch recording on or off at run time. No effect if AES_TRACE is 0.
+void AES_trace_enable(int on);
+int AES_trace_enabled(void);
+
+// Drop all recorded events
+void AES_trace_clear(void);
+
+// Writes {"traceEvents":[...]} to out. Returns the number of events written,
+// or -1 on a write error. Switch recording off first for an exact dump; events
+// written concurrently with the export may come out garbled or be skipped.
+int AES_trace_export_json(FILE* out);
+
+
+// Hooks used by the kernels themselves. Timestamps are in nanoseconds; a start
+// value of 0 means recording was off when the event began.
+#if AES_TRACE
+uint64_t AES_trace_begin(void);
+void AES_trace_end(const char* name, enum AES_trace_kind kind, size_t length, int thread, uint64_t start);
+
+  #define AES_TRACE_BEGIN(start)                          const uint64_t start = AES_trace_begin()
+  #define AES_TRACE_END(name, kind, length, thread, start) AES_trace_end((name), (kind), (length), (thread), (start))
+#else
+  #define AES_TRACE_BEGIN(start)
+  #define AES_TRACE_END(name, kind, length, thread, start)
+#endif
+
+
+#endif // _AES_TRACE_H_
@@ -0,0 +1,95 @@
+#ifndef _AES_UTIL_H_
+#define _AES_UTIL_H_
+
+// Private to the library: small byte helpers shared by the modules built on
+// the block cipher, so there is one copy of each.
+
+#include <stdint.h>
+#include <stddef.h>
+#include "aes.h"
+
+// Zeroes key material and other secrets. Through a volatile pointer, so the
+// stores are not dropped when the buffer is about to go out of scope.
+static inline void Wipe(void* p, size_t length)
+{
+  volatile uint8_t* v = (volatile uint8_t*)p;
+  while (length-- > 0)
+  {
+    *v++ = 0;
+  }
+}
+
+// Increments the big-endian 128-bit counter block
+static inline void Increment(uint8_t* counter)
+{
+  int bi;
+  for (bi = AES_BLOCKLEN - 1; bi >= 0 && ++counter[bi] == 0; --bi)
+  {
+  }
+}
+
+// Adds blocks to the big-endian 128-bit counter block in one pass
+static inline void IncrementBy(uint8_t* counter, size_t blocks)
+{
+  size_t carry = blocks;
+  int i;
+  for (i = AES_BLOCKLEN - 1; i >= 0 && carry > 0; --i)
+  {
+    size_t sum = counter[i] + (carry & 0xFF);
+    counter[i] = (uint8_t)sum;
+    carry = (carry >> 8) + (sum >> 8);
+  }
+}
+
+// Increments only the last 32 bits of the counter block, big-endian (GCM's inc32)
+static inline void Inc32(uint8_t* counter)
+{
+  int bi;
+  for (bi = AES_BLOCKLEN - 1; bi >= AES_BLOCKLEN - 4 && ++counter[bi] == 0; --bi)
+  {
+  }
+}
+
+static inline uint64_t Load64Be(const uint8_t* p)
+{
+  uint64_t x = 0;
+  int i;
+  for (i = 0; i < 8; ++i)
+  {
+    x = (x << 8) | p[i];
+  }
+  return x;
+}
+
+static inline void Store64Be(uint8_t* p, uint64_t x)
+{
+  int i;
+  for (i = 7; i >= 0; --i)
+  {
+    p[i] = (uint8_t)x;
+    x >>= 8;
+  }
+}
+
+static inline uint64_t Load64Le(const uint8_t* p)
+{
+  uint64_t x = 0;
+  int i;
+  for (i = 7; i >= 0; --i)
+  {
+    x = (x << 8) | p[i];
+  }
+  return x;
+}
+
+static inline void Store64Le(uint8_t* p, uint64_t x)
+{
+  int i;
+  for (i = 0; i < 8; ++i)
+  {
+    p[i] = (uint8_t)(x >> (8 * i));
+  }
+}
+
+
+#endif // _AES_UTIL_H_
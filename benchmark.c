@@ -9,6 +9,8 @@
 #define ECB 1
 #include "aes.h"
 #include "aes_openmp.h"
+#include "aes_backend.h"
+#include "aes_gcm.h"
 
 // CSV output file handle
 static FILE* csv_file = NULL;
@@ -96,6 +98,190 @@ static int test_correctness()
         all_passed = 0;
     }
 
+    // The parallel DRBG fill must give the same bytes as the sequential one
+    uint8_t seed[AES_DRBG_SEEDLEN] = { 0 };
+    struct AES_drbg drbg_seq, drbg_par;
+    uint8_t* random_seq = (uint8_t*)malloc(test_size + 100);
+    uint8_t* random_par = (uint8_t*)malloc(test_size + 100);
+    AES_drbg_instantiate(&drbg_seq, NULL, NULL, seed, NULL, 0);
+    AES_drbg_instantiate(&drbg_par, NULL, NULL, seed, NULL, 0);
+    if (AES_drbg_fill(&drbg_seq, random_seq, test_size + 100) == 0 &&
+        AES_drbg_fill_openmp(&drbg_par, random_par, test_size + 100) == 0 &&
+        memcmp(random_seq, random_par, test_size + 100) == 0 &&
+        memcmp(drbg_seq.V, drbg_par.V, AES_BLOCKLEN) == 0)
+    {
+        printf("✓ OpenMP DRBG fill:      PASSED\n");
+    }
+    else
+    {
+        printf("✗ OpenMP DRBG fill:      FAILED\n");
+        all_passed = 0;
+    }
+    free(random_seq);
+    free(random_par);
+
+    // And the parallel counter-based RNG the same values as the sequential one
+    struct AES_rng rng;
+    const size_t values = test_size / sizeof(uint64_t);
+    uint64_t* values_seq = (uint64_t*)malloc(values * sizeof(uint64_t));
+    uint64_t* values_par = (uint64_t*)malloc(values * sizeof(uint64_t));
+    AES_rng_init(&rng, 1, 2, AES_RNG_ARS_ROUNDS);
+    AES_rng_u64(&rng, 9, 5, values_seq, values);
+    AES_rng_u64_openmp(&rng, 9, 5, values_par, values);
+    if (memcmp(values_seq, values_par, values * sizeof(uint64_t)) == 0)
+    {
+        printf("✓ OpenMP counter RNG:    PASSED\n");
+    }
+    else
+    {
+        printf("✗ OpenMP counter RNG:    FAILED\n");
+        all_passed = 0;
+    }
+    free(values_seq);
+    free(values_par);
+
+    // The parallel fused re-encryption must match the sequential one
+    uint8_t new_key[AES_KEYLEN] = { 0 };
+    struct AES_ctx to_seq, to_par;
+    data_seq = (uint8_t*)malloc(test_size + 5);
+    data_par = (uint8_t*)malloc(test_size + 5);
+    for (size_t i = 0; i < test_size + 5; ++i)
+    {
+        data_seq[i] = data_par[i] = rand() & 0xFF;
+    }
+    AES_init_ctx_iv(&ctx_seq, key, iv);
+    AES_init_ctx_iv(&ctx_par, key, iv);
+    AES_init_ctx_iv(&to_seq, new_key, iv);
+    AES_init_ctx_iv(&to_par, new_key, iv);
+    AES_CTR_reencrypt_buffer(&ctx_seq, &to_seq, data_seq, test_size + 5);
+    AES_CTR_reencrypt_buffer_openmp(&ctx_par, &to_par, data_par, test_size + 5);
+    if (memcmp(data_seq, data_par, test_size + 5) == 0 &&
+        memcmp(ctx_seq.Iv, ctx_par.Iv, AES_BLOCKLEN) == 0 &&
+        memcmp(to_seq.Iv, to_par.Iv, AES_BLOCKLEN) == 0)
+    {
+        printf("✓ OpenMP re-encryption: PASSED\n");
+    }
+    else
+    {
+        printf("✗ OpenMP re-encryption: FAILED\n");
+        all_passed = 0;
+    }
+    free(data_seq);
+    free(data_par);
+
+    // The parallel fused CRC32C must match the sequential one
+    uint32_t crc_seq = 0x1234, crc_par = 0x1234;
+    data_seq = (uint8_t*)malloc(test_size + 5);
+    data_par = (uint8_t*)malloc(test_size + 5);
+    for (size_t i = 0; i < test_size + 5; ++i)
+    {
+        data_seq[i] = data_par[i] = rand() & 0xFF;
+    }
+    AES_init_ctx_iv(&ctx_seq, key, iv);
+    AES_init_ctx_iv(&ctx_par, key, iv);
+    AES_CTR_encrypt_buffer_crc32c(&ctx_seq, data_seq, test_size + 5, &crc_seq);
+    AES_CTR_encrypt_buffer_crc32c_openmp(&ctx_par, data_par, test_size + 5, &crc_par);
+    if (memcmp(data_seq, data_par, test_size + 5) == 0 &&
+        memcmp(ctx_seq.Iv, ctx_par.Iv, AES_BLOCKLEN) == 0 &&
+        crc_seq == crc_par)
+    {
+        printf("✓ OpenMP fused CRC32C: PASSED\n");
+    }
+    else
+    {
+        printf("✗ OpenMP fused CRC32C: FAILED\n");
+        all_passed = 0;
+    }
+    free(data_seq);
+    free(data_par);
+
+    // The parallel chunked AEAD must seal like the sequential one and open it
+    struct AES_stream stream;
+    const uint8_t prefix[AES_STREAM_PREFIXLEN] = { 1, 2, 3, 4, 5, 6, 7 };
+    AES_stream_init(&stream, key, prefix, 4096);
+    const size_t sealed_length = AES_stream_sealed_length(&stream, test_size + 5);
+    uint8_t* plain = (uint8_t*)malloc(test_size + 5);
+    data_seq = (uint8_t*)malloc(sealed_length);
+    data_par = (uint8_t*)malloc(sealed_length);
+    for (size_t i = 0; i < test_size + 5; ++i)
+    {
+        plain[i] = rand() & 0xFF;
+    }
+    AES_stream_seal(&stream, NULL, 0, plain, test_size + 5, data_seq);
+    AES_stream_seal_openmp(&stream, NULL, 0, plain, test_size + 5, data_par);
+    int stream_ok = (memcmp(data_seq, data_par, sealed_length) == 0);
+    stream_ok &= (AES_stream_open_openmp(&stream, NULL, 0, data_par, sealed_length, data_seq) == 0);
+    stream_ok &= (memcmp(data_seq, plain, test_size + 5) == 0);
+    if (stream_ok)
+    {
+        printf("✓ OpenMP chunked AEAD: PASSED\n");
+    }
+    else
+    {
+        printf("✗ OpenMP chunked AEAD: FAILED\n");
+        all_passed = 0;
+    }
+    free(plain);
+    free(data_seq);
+    free(data_par);
+
+    // The tree MAC built in parallel must match the sequential one
+    struct AES_mac_tree tree;
+    uint8_t tag_seq[AES_MAC_LEN], tag_par[AES_MAC_LEN];
+    const size_t tree_size = AES_mac_tree_size(4096, test_size + 5);
+    uint8_t* nodes_seq = (uint8_t*)malloc(tree_size);
+    uint8_t* nodes_par = (uint8_t*)malloc(tree_size);
+    data_seq = (uint8_t*)malloc(test_size + 5);
+    for (size_t i = 0; i < test_size + 5; ++i)
+    {
+        data_seq[i] = rand() & 0xFF;
+    }
+    AES_mac_tree_init(&tree, key, AES_MAC_LEAF_CMAC, 4096, test_size + 5, nodes_seq);
+    AES_mac_tree_build(&tree, data_seq, tag_seq);
+    AES_mac_tree_init(&tree, key, AES_MAC_LEAF_CMAC, 4096, test_size + 5, nodes_par);
+    AES_mac_tree_build_openmp(&tree, data_seq, tag_par);
+    if (memcmp(tag_seq, tag_par, AES_MAC_LEN) == 0 && memcmp(nodes_seq, nodes_par, tree_size) == 0)
+    {
+        printf("✓ OpenMP Merkle-tree MAC: PASSED\n");
+    }
+    else
+    {
+        printf("✗ OpenMP Merkle-tree MAC: FAILED\n");
+        all_passed = 0;
+    }
+    free(nodes_seq);
+    free(nodes_par);
+    free(data_seq);
+
+    // A batch of keys wrapped over threads must match the sequential wrap
+    const size_t kw_keys = 1000;
+    const size_t kw_wrapped = kw_keys * (32 + AES_KW_SEMIBLOCK);
+    uint8_t* kw_plain = (uint8_t*)malloc(kw_keys * 32);
+    data_seq = (uint8_t*)malloc(kw_wrapped);
+    data_par = (uint8_t*)malloc(kw_wrapped);
+    for (size_t i = 0; i < kw_keys * 32; ++i)
+    {
+        kw_plain[i] = rand() & 0xFF;
+    }
+    AES_init_ctx(&ctx_seq, key);
+    AES_KW_wrap_batch(&ctx_seq, kw_plain, 32, kw_keys, data_seq);
+    AES_KW_wrap_batch_openmp(&ctx_seq, kw_plain, 32, kw_keys, data_par);
+    int kw_ok = (memcmp(data_seq, data_par, kw_wrapped) == 0);
+    kw_ok &= (AES_KW_unwrap_batch_openmp(&ctx_seq, data_par, 32 + AES_KW_SEMIBLOCK, kw_keys, data_seq) == 0);
+    kw_ok &= (memcmp(data_seq, kw_plain, kw_keys * 32) == 0);
+    if (kw_ok)
+    {
+        printf("✓ OpenMP key wrap: PASSED\n");
+    }
+    else
+    {
+        printf("✗ OpenMP key wrap: FAILED\n");
+        all_passed = 0;
+    }
+    free(kw_plain);
+    free(data_seq);
+    free(data_par);
+
     return all_passed ? 0 : 1;
 }
 
@@ -153,6 +339,27 @@ static void benchmark_size(size_t size_mb)
         fprintf(csv_file, "%zu,Sequential,1,%lf,%lf\n", size_mb, throughput_seq, avg_time_seq);
     }
 
+    // Single-pass AES-GCM, for comparison with plain CTR
+    double total_time_gcm = 0.0;
+    for (int i = 0; i < iterations; ++i)
+    {
+        struct AES_ctx ctx;
+        uint8_t tag[AES_GCM_TAGLEN];
+        AES_init_ctx(&ctx, key);
+
+        double start = get_time();
+        AES_GCM_encrypt(&ctx, iv, 12, NULL, 0, data, size, tag);
+        double end = get_time();
+
+        total_time_gcm += (end - start);
+    }
+    double avg_time_gcm = total_time_gcm / iterations;
+    print_throughput("AES-GCM (single pass)", size, avg_time_gcm);
+    if (csv_file)
+    {
+        fprintf(csv_file, "%zu,GCM,1,%lf,%lf\n", size_mb, (size / (1024.0 * 1024.0)) / avg_time_gcm, avg_time_gcm);
+    }
+
     // Benchmark parallel version with different thread counts
     int max_threads = omp_get_max_threads();
     printf("\nMaximum available threads: %d\n\n", max_threads);
@@ -190,6 +397,15 @@ static void benchmark_size(size_t size_mb)
                  num_threads, num_threads > 1 ? "s" : "");
         print_throughput(thread_label, size, avg_time_par);
 
+#if AES_OPENMP_IMBALANCE
+        struct AES_openmp_imbalance profile;
+        if (AES_openmp_imbalance(&profile) > 0)
+        {
+            printf("  Load imbalance (max/mean)  : %.2f, straggler thread %u\n",
+                   profile.imbalance, profile.straggler);
+        }
+#endif
+
         // Write parallel result to CSV
         if (csv_file)
         {
@@ -229,6 +445,17 @@ int main(int argc, char* argv[])
 #endif
 
     printf("Block Size: %d bytes\n", AES_BLOCKLEN);
+    for (int p = 0; p < AES_PRIMITIVE_COUNT; ++p)
+    {
+        const char* selected = AES_backend_selected((enum AES_primitive)p);
+        printf("Backend %-6s: %-10s (available:", AES_primitive_name((enum AES_primitive)p),
+               selected ? selected : "none");
+        for (size_t b = 0; b < AES_backend_count((enum AES_primitive)p); ++b)
+        {
+            printf(" %s", AES_backend_name((enum AES_primitive)p, b));
+        }
+        printf(")\n");
+    }
     printf("=======================================================\n");
 
     srand(time(NULL));
@@ -9,6 +9,18 @@
 #define ECB 1
 
 #include "aes.h"
+#include "aes_stats.h"
+#include "aes_trace.h"
+#include "aes_backend.h"
+#include "aes_batch.h"
+#include "aes_drbg.h"
+#include "aes_rng.h"
+#include "aes_hash.h"
+#include "aes_fused.h"
+#include "aes_gcm.h"
+#include "aes_stream.h"
+#include "aes_mac.h"
+#include "aes_kw.h"
 
 
 static void phex(uint8_t* str);
@@ -19,6 +31,20 @@ static int test_decrypt_ctr(void);
 static int test_encrypt_ecb(void);
 static int test_decrypt_ecb(void);
 static void test_encrypt_ecb_verbose(void);
+static int test_stats(void);
+static int test_trace(void);
+static int test_backend(void);
+static int test_batch(void);
+static int test_packets(void);
+static int test_drbg(void);
+static int test_rng(void);
+static int test_hash(void);
+static int test_reencrypt(void);
+static int test_crc32c(void);
+static int test_gcm(void);
+static int test_stream(void);
+static int test_mac_tree(void);
+static int test_key_wrap(void);
 
 
 int main(void)
@@ -38,7 +64,11 @@ int main(void)
 
     exit = test_encrypt_cbc() + test_decrypt_cbc() +
 	test_encrypt_ctr() + test_decrypt_ctr() +
-	test_decrypt_ecb() + test_encrypt_ecb();
+	test_decrypt_ecb() + test_encrypt_ecb() +
+	test_stats() + test_trace() + test_backend() + test_batch() +
+	test_packets() + test_drbg() + test_rng() +
+	test_hash() + test_reencrypt() + test_crc32c() +
+	test_gcm() + test_stream() + test_mac_tree() + test_key_wrap();
     test_encrypt_ecb_verbose();
 
     return exit;
@@ -314,3 +344,1130 @@ static int test_decrypt_ecb(void)
 }
 
 
+
+
+static int test_stats(void)
+{
+    uint8_t key[AES_KEYLEN] = { 0 };
+    uint8_t iv[AES_BLOCKLEN] = { 0 };
+    uint8_t buf[40] = { 0 };
+    uint8_t tag[AES_GCM_TAGLEN];
+    struct AES_stats before, after;
+    struct AES_ctx ctx;
+    int ok;
+
+    AES_stats_snapshot(&before);
+    AES_init_ctx_iv(&ctx, key, iv);
+    AES_CTR_xcrypt_buffer(&ctx, buf, sizeof(buf));
+    AES_ECB_encrypt(&ctx, buf);
+    AES_GCM_encrypt(&ctx, iv, 12, NULL, 0, buf, sizeof(buf), tag);
+    AES_KW_wrap(&ctx, key, 16, buf);
+    AES_stats_snapshot(&after);
+
+#if AES_STATS
+    const struct AES_stats_counter* ctr = &after.kernel[AES_STATS_SEQUENTIAL][AES_STATS_CTR];
+    const struct AES_stats_counter* ecb = &after.kernel[AES_STATS_SEQUENTIAL][AES_STATS_ECB_ENCRYPT];
+    ok = (ctr->calls == before.kernel[AES_STATS_SEQUENTIAL][AES_STATS_CTR].calls + 1)
+      && (ctr->bytes == before.kernel[AES_STATS_SEQUENTIAL][AES_STATS_CTR].bytes + sizeof(buf))
+      && (ctr->blocks == before.kernel[AES_STATS_SEQUENTIAL][AES_STATS_CTR].blocks + 3)
+      && (ecb->calls == before.kernel[AES_STATS_SEQUENTIAL][AES_STATS_ECB_ENCRYPT].calls + 1)
+      && (after.kernel[AES_STATS_SEQUENTIAL][AES_STATS_GCM].bytes ==
+          before.kernel[AES_STATS_SEQUENTIAL][AES_STATS_GCM].bytes + sizeof(buf))
+      && (after.kernel[AES_STATS_SEQUENTIAL][AES_STATS_KW_WRAP].calls ==
+          before.kernel[AES_STATS_SEQUENTIAL][AES_STATS_KW_WRAP].calls + 1)
+      && (after.threads_seen == 1);
+#else
+    ok = (0 == memcmp(&before, &after, sizeof(after))) && (after.kernel[AES_STATS_SEQUENTIAL][AES_STATS_CTR].calls == 0);
+#endif
+
+    printf("Statistics counters: ");
+
+    if (ok) {
+        printf("SUCCESS!\n");
+	return(0);
+    } else {
+        printf("FAILURE!\n");
+	return(1);
+    }
+}
+
+
+static int test_trace(void)
+{
+    uint8_t key[AES_KEYLEN] = { 0 };
+    uint8_t iv[AES_BLOCKLEN] = { 0 };
+    uint8_t buf[64] = { 0 };
+    char json[4096] = { 0 };
+    struct AES_ctx ctx;
+    FILE* f = tmpfile();
+    int events, ok;
+
+    if (f == NULL) {
+        printf("Trace export: FAILURE! (no temporary file)\n");
+        return(1);
+    }
+
+    AES_trace_clear();
+    AES_trace_enable(1);
+    AES_init_ctx_iv(&ctx, key, iv);
+    AES_CTR_xcrypt_buffer(&ctx, buf, sizeof(buf));
+    AES_trace_enable(0);
+    AES_CTR_xcrypt_buffer(&ctx, buf, sizeof(buf));
+
+    events = AES_trace_export_json(f);
+    rewind(f);
+    if (fread(json, 1, sizeof(json) - 1, f) == 0) {
+        json[0] = 0;
+    }
+    fclose(f);
+
+#if AES_TRACE
+    ok = (events == 1) && (strstr(json, "\"name\":\"ctr\"") != NULL) && (strstr(json, "\"length\":64") != NULL);
+#else
+    ok = (events == 0) && (strstr(json, "\"traceEvents\":[") != NULL);
+#endif
+
+    printf("Trace export: ");
+
+    if (ok) {
+        printf("SUCCESS!\n");
+	return(0);
+    } else {
+        printf("FAILURE!\n");
+	return(1);
+    }
+}
+
+
+static int test_backend(void)
+{
+    uint8_t a[37], b[37], key[37];
+    size_t i, n;
+    int ok = 1;
+
+    for (i = 0; i < sizeof(a); ++i)
+    {
+        a[i] = b[i] = (uint8_t)(i * 11);
+        key[i] = (uint8_t)(0xa5 ^ i);
+    }
+
+    // Every XOR kernel must give the same result as the others
+    n = AES_backend_count(AES_PRIMITIVE_XOR);
+    for (i = 0; i < n; ++i)
+    {
+        ok &= (0 == AES_backend_select(AES_PRIMITIVE_XOR, AES_backend_name(AES_PRIMITIVE_XOR, i)));
+        ok &= (0 == strcmp(AES_backend_selected(AES_PRIMITIVE_XOR), AES_backend_name(AES_PRIMITIVE_XOR, i)));
+        AES_backend_xor()((i & 1) ? b : a, key, sizeof(a));
+    }
+    if ((n & 1) == 1)
+    {
+        AES_backend_xor()(b, key, sizeof(a));
+    }
+    ok &= (n >= 1) && (0 == memcmp(a, b, sizeof(a)));
+
+    ok &= (-1 == AES_backend_select(AES_PRIMITIVE_XOR, "no-such-kernel"));
+    ok &= (0 == AES_backend_select(AES_PRIMITIVE_XOR, NULL));
+    ok &= (0 == strcmp(AES_backend_selected(AES_PRIMITIVE_XOR), AES_backend_name(AES_PRIMITIVE_XOR, 0)));
+    ok &= (AES_backend_block() != NULL) && (AES_backend_selected(AES_PRIMITIVE_BLOCK) != NULL);
+
+    // Every block kernel must match the reference cipher, over whole groups
+    // of blocks and a tail
+    {
+        uint8_t blocks[19 * AES_BLOCKLEN], expected[19 * AES_BLOCKLEN];
+        struct AES_ctx ctx;
+
+        AES_init_ctx(&ctx, key);
+        for (i = 0; i < sizeof(expected); ++i)
+        {
+            expected[i] = (uint8_t)(i * 7 + 1);
+        }
+        for (i = 0; i < sizeof(expected); i += AES_BLOCKLEN)
+        {
+            AES_block_encrypt(&ctx, expected + i);
+        }
+        n = AES_backend_count(AES_PRIMITIVE_BLOCK);
+        for (i = 0; i < n; ++i)
+        {
+            size_t j;
+            if (0 != AES_backend_select(AES_PRIMITIVE_BLOCK, AES_backend_name(AES_PRIMITIVE_BLOCK, i)))
+            {
+                continue;  // needs a CPU feature this machine lacks
+            }
+            for (j = 0; j < sizeof(blocks); ++j)
+            {
+                blocks[j] = (uint8_t)(j * 7 + 1);
+            }
+            AES_backend_block()(&ctx, blocks, sizeof(blocks) / AES_BLOCKLEN);
+            ok &= (0 == memcmp(blocks, expected, sizeof(blocks)));
+        }
+        ok &= (0 == AES_backend_select(AES_PRIMITIVE_BLOCK, NULL));
+    }
+
+    printf("Backend selection: ");
+
+    if (ok) {
+        printf("SUCCESS!\n");
+	return(0);
+    } else {
+        printf("FAILURE!\n");
+	return(1);
+    }
+}
+
+
+static int test_batch(void)
+{
+    enum { N = 21, LONGEST = 77 };
+    static uint8_t memory[(AES_BATCH_ROUND_KEYS + 1) * AES_BLOCKLEN * 32];
+    struct AES_batch table;
+    struct AES_ctx ctx[N], stored;
+    uint8_t key[AES_KEYLEN], iv[AES_BLOCKLEN];
+    uint8_t blocks[N * AES_BLOCKLEN], expected[N * AES_BLOCKLEN];
+    uint8_t data[N][LONGEST], reference[N][LONGEST];
+    uint8_t* bufs[N];
+    size_t lengths[N];
+    size_t i, j;
+    int ok = (AES_batch_size(N) <= sizeof(memory));
+
+    AES_batch_init(&table, memory, N);
+    for (i = 0; i < N; ++i)
+    {
+        for (j = 0; j < AES_KEYLEN; ++j)
+        {
+            key[j] = (uint8_t)(i * 31 + j * 7);
+        }
+        for (j = 0; j < AES_BLOCKLEN; ++j)
+        {
+            // Some counters sit just below a carry into the upper bytes
+            iv[j] = (j >= 12 && (i % 3) == 0) ? 0xff : (uint8_t)(i + j * 13);
+        }
+        AES_init_ctx_iv(&ctx[i], key, iv);
+        if (i & 1)
+        {
+            AES_batch_load(&table, i, &ctx[i]);
+        }
+        else
+        {
+            AES_batch_set_key(&table, i, key);
+            AES_batch_set_iv(&table, i, iv);
+        }
+        for (j = 0; j < AES_BLOCKLEN; ++j)
+        {
+            blocks[i * AES_BLOCKLEN + j] = expected[i * AES_BLOCKLEN + j] = (uint8_t)(i ^ (j * 29));
+        }
+        AES_ECB_encrypt(&ctx[i], expected + i * AES_BLOCKLEN);
+    }
+
+    AES_batch_ECB_encrypt(&table, 0, N, blocks);
+    ok &= (0 == memcmp(blocks, expected, sizeof(blocks)));
+
+    // Twice, so the second pass starts from the IVs the first one left behind
+    for (j = 0; j < 2; ++j)
+    {
+        for (i = 0; i < N; ++i)
+        {
+            size_t k;
+            lengths[i] = (i * 11 + j * 5) % LONGEST;
+            bufs[i] = data[i];
+            for (k = 0; k < LONGEST; ++k)
+            {
+                data[i][k] = reference[i][k] = (uint8_t)(k * 3 + i);
+            }
+            AES_CTR_xcrypt_buffer(&ctx[i], reference[i], lengths[i]);
+        }
+        AES_batch_CTR_xcrypt(&table, 0, N, bufs, lengths);
+        ok &= (0 == memcmp(data, reference, sizeof(data)));
+    }
+
+    // A sub-range leaves the contexts around it alone
+    AES_batch_CTR_xcrypt(&table, 5, 3, bufs + 5, lengths + 5);
+    for (i = 0; i < N; ++i)
+    {
+        if (i >= 5 && i < 8)
+        {
+            AES_CTR_xcrypt_buffer(&ctx[i], reference[i], lengths[i]);
+        }
+        AES_batch_store(&table, i, &stored);
+        ok &= (0 == memcmp(stored.RoundKey, ctx[i].RoundKey, AES_keyExpSize));
+        ok &= (0 == memcmp(stored.Iv, ctx[i].Iv, AES_BLOCKLEN));
+    }
+    ok &= (0 == memcmp(data, reference, sizeof(data)));
+
+    printf("Batch context table: ");
+
+    if (ok) {
+        printf("SUCCESS!\n");
+	return(0);
+    } else {
+        printf("FAILURE!\n");
+	return(1);
+    }
+}
+
+
+static int test_packets(void)
+{
+    enum { N = 37, LONGEST = 70 };
+    uint8_t key[AES_KEYLEN], ivs[N][AES_BLOCKLEN];
+    uint8_t data[N][LONGEST], reference[N][LONGEST];
+    const uint8_t* iv_ptrs[N];
+    uint8_t* bufs[N];
+    size_t lengths[N];
+    struct AES_ctx ctx, one;
+    size_t i, j;
+    int ok;
+
+    for (j = 0; j < AES_KEYLEN; ++j)
+    {
+        key[j] = (uint8_t)(j * 5 + 1);
+    }
+    AES_init_ctx(&ctx, key);
+
+    // Lengths from empty to several blocks, most ending in a partial block
+    for (i = 0; i < N; ++i)
+    {
+        lengths[i] = (i * 13) % LONGEST;
+        for (j = 0; j < AES_BLOCKLEN; ++j)
+        {
+            ivs[i][j] = (j >= 14 && (i % 4) == 1) ? 0xff : (uint8_t)(i * 3 + j);
+        }
+        for (j = 0; j < LONGEST; ++j)
+        {
+            data[i][j] = reference[i][j] = (uint8_t)(i + j * 7);
+        }
+        iv_ptrs[i] = ivs[i];
+        bufs[i] = data[i];
+
+        one = ctx;
+        AES_ctx_set_iv(&one, ivs[i]);
+        AES_CTR_xcrypt_buffer(&one, reference[i], lengths[i]);
+    }
+
+    AES_batch_CTR_packets(&ctx, N, iv_ptrs, bufs, lengths);
+    ok = (0 == memcmp(data, reference, sizeof(data)));
+
+    printf("Packet-vector CTR: ");
+
+    if (ok) {
+        printf("SUCCESS!\n");
+	return(0);
+    } else {
+        printf("FAILURE!\n");
+	return(1);
+    }
+}
+
+
+// Entropy source for test_drbg: a counter, so reseeds are visible
+static int counting_entropy(void* arg, uint8_t* out, size_t length)
+{
+    unsigned* calls = (unsigned*)arg;
+    memset(out, (int)(++*calls), length);
+    return 0;
+}
+
+static int test_drbg(void)
+{
+    enum { LENGTH = 3 * AES_DRBG_MAX_REQUEST + 1000 };
+    static uint8_t filled[LENGTH], generated[LENGTH];
+    struct AES_drbg a, b, snapshot;
+    uint8_t seed[AES_DRBG_SEEDLEN], out[64];
+    unsigned calls = 0;
+    size_t i;
+    int ok = 1;
+
+#if AES_KEYLEN == 16
+    // CAVP CTR_DRBG AES-128 without derivation function, no reseed, first vector:
+    // the second 64-byte generate is the expected output
+    uint8_t entropy[32] = { 0xce, 0x50, 0xf3, 0x3d, 0xa5, 0xd4, 0xc1, 0xd3, 0xd4, 0x00, 0x4e, 0xb3, 0x52, 0x44, 0xb7, 0xf2,
+                            0xcd, 0x7f, 0x2e, 0x50, 0x76, 0xfb, 0xf6, 0x78, 0x0a, 0x7f, 0xf6, 0x34, 0xb2, 0x49, 0xa5, 0xfc };
+    uint8_t returned[64] = { 0x65, 0x45, 0xc0, 0x52, 0x9d, 0x37, 0x24, 0x43, 0xb3, 0x92, 0xce, 0xb3, 0xae, 0x3a, 0x99, 0xa3,
+                             0x0f, 0x96, 0x3e, 0xaf, 0x31, 0x32, 0x80, 0xf1, 0xd1, 0xa1, 0xe8, 0x7f, 0x9d, 0xb3, 0x73, 0xd3,
+                             0x61, 0xe7, 0x5d, 0x18, 0x01, 0x82, 0x66, 0x49, 0x9c, 0xcc, 0xd6, 0x4d, 0x9b, 0xbb, 0x8d, 0xe0,
+                             0x18, 0x5f, 0x21, 0x33, 0x83, 0x08, 0x0f, 0xad, 0xde, 0xc4, 0x6b, 0xae, 0x1f, 0x78, 0x4e, 0x5a };
+    ok &= (0 == AES_drbg_instantiate(&a, NULL, NULL, entropy, NULL, 0));
+    ok &= (0 == AES_drbg_generate(&a, out, sizeof(out), NULL, 0));
+    ok &= (0 == AES_drbg_generate(&a, out, sizeof(out), NULL, 0));
+    ok &= (0 == memcmp(out, returned, sizeof(out)));
+#endif
+
+    // A fill is a chain of maximum-size requests, and reserve + output is a request
+    for (i = 0; i < sizeof(seed); ++i)
+    {
+        seed[i] = (uint8_t)(i * 9 + 4);
+    }
+    ok &= (0 == AES_drbg_instantiate(&a, NULL, NULL, seed, (const uint8_t*)"fill", 4));
+    ok &= (0 == AES_drbg_instantiate(&b, NULL, NULL, seed, (const uint8_t*)"fill", 4));
+    ok &= (0 == AES_drbg_fill(&a, filled, LENGTH));
+    for (i = 0; i + AES_DRBG_MAX_REQUEST <= LENGTH; i += AES_DRBG_MAX_REQUEST)
+    {
+        ok &= (0 == AES_drbg_generate(&b, generated + i, AES_DRBG_MAX_REQUEST, NULL, 0));
+    }
+    ok &= (0 == AES_drbg_reserve(&b, &snapshot, LENGTH - i));
+    AES_drbg_output(&snapshot, generated + i, LENGTH - i);
+    ok &= (0 == memcmp(filled, generated, LENGTH));
+    ok &= (0 == memcmp(a.V, b.V, AES_BLOCKLEN)) && (a.reseed_counter == b.reseed_counter);
+
+    // Reseed policy: from the source when the interval has passed, else refuse
+    ok &= (0 == AES_drbg_instantiate(&a, counting_entropy, &calls, NULL, NULL, 0));
+    a.reseed_interval = 2;
+    for (i = 0; i < 5; ++i)
+    {
+        ok &= (0 == AES_drbg_generate(&a, out, sizeof(out), (const uint8_t*)"extra", 5));
+    }
+    ok &= (calls == 3);
+    b.reseed_interval = b.reseed_counter;
+    ok &= (0 == AES_drbg_generate(&b, out, 16, NULL, 0));
+    ok &= (-1 == AES_drbg_generate(&b, out, 16, NULL, 0));
+    ok &= (0 == AES_drbg_reseed(&b, seed, NULL, 0)) && (0 == AES_drbg_generate(&b, out, 16, NULL, 0));
+    ok &= (-1 == AES_drbg_generate(&b, filled, AES_DRBG_MAX_REQUEST + 1, NULL, 0));
+
+    ok &= (AES_drbg_thread() != NULL) && (AES_drbg_thread() == AES_drbg_thread());
+    AES_drbg_uninstantiate(&a);
+    AES_drbg_uninstantiate(&b);
+
+    printf("CTR_DRBG: ");
+
+    if (ok) {
+        printf("SUCCESS!\n");
+	return(0);
+    } else {
+        printf("FAILURE!\n");
+	return(1);
+    }
+}
+
+
+static int test_rng(void)
+{
+    enum { N = 100 };
+    struct AES_rng rng;
+    struct AES_ctx ctx;
+    uint8_t key[AES_KEYLEN] = { 0 };
+    uint8_t block[AES_BLOCKLEN], expected[AES_BLOCKLEN];
+    uint32_t u32[2 * N], part32[N];
+    uint64_t u64[N], part64[N];
+    double d[N];
+    unsigned rounds, r;
+    size_t i;
+    int ok = (-1 == AES_rng_init(&rng, 1, 2, AES_RNG_MAX_ROUNDS + 1));
+
+    // The full cipher through the round functions, and the full-cipher RNG
+    key[0] = 0x01;
+    key[8] = 0x02;
+    AES_init_ctx(&ctx, key);
+    ok &= (0 == AES_rng_init(&rng, 1, 2, AES_RNG_FULL));
+    AES_rng_blocks(&rng, 7, 5, block, 1);
+    memset(expected, 0, sizeof(expected));
+    expected[0] = 5;
+    expected[8] = 7;
+    AES_block_encrypt(&ctx, expected);
+    ok &= (0 == memcmp(block, expected, sizeof(block)));
+    memset(block, 0, sizeof(block));
+    block[0] = 5;
+    block[8] = 7;
+    for (i = 0; i < AES_BLOCKLEN; ++i)
+    {
+        block[i] ^= ctx.RoundKey[i];
+    }
+    for (r = 1; r < AES_keyExpSize / AES_BLOCKLEN - 1; ++r)
+    {
+        AES_block_round(block, ctx.RoundKey + r * AES_BLOCKLEN);
+    }
+    AES_block_last_round(block, ctx.RoundKey + r * AES_BLOCKLEN);
+    ok &= (0 == memcmp(block, expected, sizeof(block)));
+
+    for (rounds = AES_RNG_FULL; rounds <= AES_RNG_ARS_ROUNDS; rounds += AES_RNG_ARS_ROUNDS)
+    {
+        ok &= (0 == AES_rng_init(&rng, 0x0123456789abcdefULL, 42, rounds));
+        AES_rng_u32(&rng, 3, 0, u32, 2 * N);
+        AES_rng_u64(&rng, 3, 0, u64, N);
+        AES_rng_double(&rng, 3, 0, d, N);
+        for (i = 0; i < N; ++i)
+        {
+            ok &= (u64[i] == (u32[2 * i] | ((uint64_t)u32[2 * i + 1] << 32)));
+            ok &= (d[i] >= 0.0) && (d[i] < 1.0) && (d[i] == (double)(u64[i] >> 11) / 9007199254740992.0);
+        }
+
+        // Jumping in at any position gives the same values
+        AES_rng_u32(&rng, 3, 37, part32, N);
+        AES_rng_u64(&rng, 3, 13, part64, N - 13);
+        ok &= (0 == memcmp(part32, u32 + 37, N * sizeof(uint32_t)));
+        ok &= (0 == memcmp(part64, u64 + 13, (N - 13) * sizeof(uint64_t)));
+
+        // Streams are distinct
+        AES_rng_u64(&rng, 4, 0, part64, N);
+        ok &= (0 != memcmp(part64, u64, N * sizeof(uint64_t)));
+    }
+
+    printf("Counter-based RNG: ");
+
+    if (ok) {
+        printf("SUCCESS!\n");
+	return(0);
+    } else {
+        printf("FAILURE!\n");
+	return(1);
+    }
+}
+
+
+static int test_hash(void)
+{
+    enum { LONGEST = 100, FLIPS = 64, VALUES = 19 };
+    struct AES_hash_key key, other;
+    uint8_t data[LONGEST], le[8];
+    uint64_t hashes[LONGEST + 1 + FLIPS];
+    uint64_t values[VALUES], bulk[VALUES];
+    uint32_t values32[VALUES];
+    const void* ptrs[VALUES];
+    size_t lengths[VALUES];
+    size_t i, j;
+    int ok = 1;
+
+    AES_hash_init(&key, 1, 2);
+    AES_hash_init(&other, 1, 3);
+    memset(data, 0, sizeof(data));
+
+    // Zero runs of every length (short, two-lane and multi-step paths) and
+    // one-bit changes in every byte of a 64-byte input all hash differently
+    for (i = 0; i <= LONGEST; ++i)
+    {
+        hashes[i] = AES_hash(&key, data, i);
+    }
+    for (i = 0; i < FLIPS; ++i)
+    {
+        data[i] ^= (uint8_t)(1u << (i % 8));
+        hashes[LONGEST + 1 + i] = AES_hash(&key, data, 64);
+        data[i] ^= (uint8_t)(1u << (i % 8));
+    }
+    for (i = 0; i < LONGEST + 1 + FLIPS; ++i)
+    {
+        for (j = 0; j < i; ++j)
+        {
+            ok &= (hashes[i] != hashes[j]);
+        }
+    }
+    ok &= (AES_hash(&key, data, 7) != AES_hash(&other, data, 7));
+    ok &= (AES_hash(&key, data, 40) != AES_hash(&other, data, 40));
+
+    // The bulk forms agree with the byte-string hash
+    for (i = 0; i < VALUES; ++i)
+    {
+        values[i] = 0x0102030405060708ULL * i;
+        values32[i] = (uint32_t)values[i];
+        ptrs[i] = data + i;
+        lengths[i] = i * 5;
+    }
+    AES_hash_u64(&key, values, bulk, VALUES);
+    for (i = 0; i < VALUES; ++i)
+    {
+        for (j = 0; j < 8; ++j)
+        {
+            le[j] = (uint8_t)(values[i] >> (8 * j));
+        }
+        ok &= (bulk[i] == AES_hash(&key, le, 8));
+    }
+    AES_hash_u32(&key, values32, bulk, VALUES);
+    for (i = 0; i < VALUES; ++i)
+    {
+        for (j = 0; j < 4; ++j)
+        {
+            le[j] = (uint8_t)(values32[i] >> (8 * j));
+        }
+        ok &= (bulk[i] == AES_hash(&key, le, 4));
+    }
+    AES_hash_many(&key, ptrs, lengths, bulk, VALUES);
+    for (i = 0; i < VALUES; ++i)
+    {
+        ok &= (bulk[i] == AES_hash(&key, data + i, i * 5));
+    }
+
+    ok &= (AES_hash_default() == AES_hash_default());
+
+    printf("AES-round hash: ");
+
+    if (ok) {
+        printf("SUCCESS!\n");
+	return(0);
+    } else {
+        printf("FAILURE!\n");
+	return(1);
+    }
+}
+
+
+static int test_reencrypt(void)
+{
+    enum { LENGTH = 5 * AES_BLOCKLEN + 7 };
+    uint8_t old_key[AES_KEYLEN], new_key[AES_KEYLEN];
+    uint8_t old_iv[AES_BLOCKLEN], new_iv[AES_BLOCKLEN];
+    uint8_t fused[LENGTH], twice[LENGTH];
+    struct AES_ctx from, to, from2, to2;
+    size_t i;
+    int ok = 1;
+
+    for (i = 0; i < AES_KEYLEN; ++i)
+    {
+        old_key[i] = (uint8_t)(i + 1);
+        new_key[i] = (uint8_t)(0xf0 - i);
+    }
+    for (i = 0; i < AES_BLOCKLEN; ++i)
+    {
+        // The new counter is about to carry into its upper bytes
+        old_iv[i] = (uint8_t)(i * 17);
+        new_iv[i] = (i < 12) ? (uint8_t)i : 0xff;
+    }
+    for (i = 0; i < LENGTH; ++i)
+    {
+        fused[i] = twice[i] = (uint8_t)(i * 5 + 3);
+    }
+
+    // CTR, twice in a row so the second call starts mid-stream
+    AES_init_ctx_iv(&from, old_key, old_iv);
+    AES_init_ctx_iv(&to, new_key, new_iv);
+    from2 = from;
+    to2 = to;
+    for (i = 0; i < 2; ++i)
+    {
+        AES_CTR_reencrypt_buffer(&from, &to, fused, LENGTH);
+        AES_CTR_xcrypt_buffer(&from2, twice, LENGTH);
+        AES_CTR_xcrypt_buffer(&to2, twice, LENGTH);
+    }
+    ok &= (0 == memcmp(fused, twice, LENGTH));
+    ok &= (0 == memcmp(from.Iv, from2.Iv, AES_BLOCKLEN)) && (0 == memcmp(to.Iv, to2.Iv, AES_BLOCKLEN));
+
+    // CBC
+    AES_init_ctx_iv(&from, old_key, old_iv);
+    AES_init_ctx_iv(&to, new_key, new_iv);
+    from2 = from;
+    to2 = to;
+    for (i = 0; i < 2; ++i)
+    {
+        AES_CBC_reencrypt_buffer(&from, &to, fused, LENGTH - 7);
+        AES_CBC_decrypt_buffer(&from2, twice, LENGTH - 7);
+        AES_CBC_encrypt_buffer(&to2, twice, LENGTH - 7);
+    }
+    ok &= (0 == memcmp(fused, twice, LENGTH));
+    ok &= (0 == memcmp(from.Iv, from2.Iv, AES_BLOCKLEN)) && (0 == memcmp(to.Iv, to2.Iv, AES_BLOCKLEN));
+
+    printf("Fused re-encryption: ");
+
+    if (ok) {
+        printf("SUCCESS!\n");
+	return(0);
+    } else {
+        printf("FAILURE!\n");
+	return(1);
+    }
+}
+
+static int test_crc32c(void)
+{
+    // Longer than a tile, and not a whole number of blocks
+    enum { LENGTH = 9 * AES_BLOCKLEN + 7, SPLIT = 2 * AES_BLOCKLEN + 5,
+           CBC_LENGTH = 9 * AES_BLOCKLEN, CBC_SPLIT = 3 * AES_BLOCKLEN };
+    uint8_t key[AES_KEYLEN], iv[AES_BLOCKLEN];
+    uint8_t plain[LENGTH], fused[LENGTH], separate[LENGTH];
+    struct AES_ctx ctx, ctx2;
+    uint32_t crc, expected;
+    size_t i;
+    int ok = 1;
+
+    ok &= (AES_crc32c(0, "123456789", 9) == 0xe3069283);
+    ok &= (AES_crc32c(AES_crc32c(0, "1234", 4), "56789", 5) == 0xe3069283);
+    ok &= (AES_crc32c_combine(AES_crc32c(0, "1234", 4), AES_crc32c(0, "56789", 5), 5) == 0xe3069283);
+
+    for (i = 0; i < AES_KEYLEN; ++i)
+    {
+        key[i] = (uint8_t)(i * 3 + 1);
+    }
+    for (i = 0; i < AES_BLOCKLEN; ++i)
+    {
+        iv[i] = (uint8_t)(0xa0 + i);
+    }
+    for (i = 0; i < LENGTH; ++i)
+    {
+        plain[i] = fused[i] = separate[i] = (uint8_t)(i * 7 + 11);
+    }
+
+    // CTR, in two calls so the checksum carries over from the first
+    AES_init_ctx_iv(&ctx, key, iv);
+    ctx2 = ctx;
+    crc = 0;
+    AES_CTR_encrypt_buffer_crc32c(&ctx, fused, SPLIT, &crc);
+    AES_CTR_encrypt_buffer_crc32c(&ctx, fused + SPLIT, LENGTH - SPLIT, &crc);
+    AES_CTR_xcrypt_buffer(&ctx2, separate, SPLIT);
+    AES_CTR_xcrypt_buffer(&ctx2, separate + SPLIT, LENGTH - SPLIT);
+    expected = AES_crc32c(0, separate, LENGTH);
+    ok &= (0 == memcmp(fused, separate, LENGTH)) && (crc == expected);
+    ok &= (0 == memcmp(ctx.Iv, ctx2.Iv, AES_BLOCKLEN));
+
+    AES_init_ctx_iv(&ctx, key, iv);
+    crc = 0;
+    AES_CTR_decrypt_buffer_crc32c(&ctx, fused, SPLIT, &crc);
+    AES_CTR_decrypt_buffer_crc32c(&ctx, fused + SPLIT, LENGTH - SPLIT, &crc);
+    ok &= (0 == memcmp(fused, plain, LENGTH)) && (crc == expected);
+
+    // CBC
+    memcpy(separate, plain, LENGTH);
+    AES_init_ctx_iv(&ctx, key, iv);
+    ctx2 = ctx;
+    crc = 0;
+    AES_CBC_encrypt_buffer_crc32c(&ctx, fused, CBC_SPLIT, &crc);
+    AES_CBC_encrypt_buffer_crc32c(&ctx, fused + CBC_SPLIT, CBC_LENGTH - CBC_SPLIT, &crc);
+    AES_CBC_encrypt_buffer(&ctx2, separate, CBC_LENGTH);
+    expected = AES_crc32c(0, separate, CBC_LENGTH);
+    ok &= (0 == memcmp(fused, separate, CBC_LENGTH)) && (crc == expected);
+    ok &= (0 == memcmp(ctx.Iv, ctx2.Iv, AES_BLOCKLEN));
+
+    AES_init_ctx_iv(&ctx, key, iv);
+    crc = 0;
+    AES_CBC_decrypt_buffer_crc32c(&ctx, fused, CBC_SPLIT, &crc);
+    AES_CBC_decrypt_buffer_crc32c(&ctx, fused + CBC_SPLIT, CBC_LENGTH - CBC_SPLIT, &crc);
+    ok &= (0 == memcmp(fused, plain, CBC_LENGTH)) && (crc == expected);
+
+    printf("Fused CRC32C: ");
+
+    if (ok) {
+        printf("SUCCESS!\n");
+	return(0);
+    } else {
+        printf("FAILURE!\n");
+	return(1);
+    }
+}
+
+// a * b in GF(2^128), GCM bit order: one GHASH step from zero
+static void gf_mul(uint8_t* out, const uint8_t* a, const uint8_t* b)
+{
+    uint8_t y[AES_BLOCKLEN] = { 0 };
+    AES_backend_ghash()(y, a, b, 1);
+    memcpy(out, y, AES_BLOCKLEN);
+}
+
+static int test_gcm(void)
+{
+    // Several stitched tiles and a partial tail
+    enum { LENGTH = 20 * AES_BLOCKLEN + 5 };
+    uint8_t key[AES_KEYLEN], iv[12], aad[20];
+    uint8_t plain[LENGTH], stitched[LENGTH], portable[LENGTH];
+    uint8_t tag[AES_GCM_TAGLEN], tag2[AES_GCM_TAGLEN];
+    struct AES_ctx ctx;
+    size_t i;
+    int ok = 1;
+
+#if (AES_KEYLEN == 16)
+    // Test cases 4 and 5 of the GCM specification
+    uint8_t k4[]  = { 0xfe, 0xff, 0xe9, 0x92, 0x86, 0x65, 0x73, 0x1c, 0x6d, 0x6a, 0x8f, 0x94, 0x67, 0x30, 0x83, 0x08 };
+    uint8_t iv4[] = { 0xca, 0xfe, 0xba, 0xbe, 0xfa, 0xce, 0xdb, 0xad, 0xde, 0xca, 0xf8, 0x88 };
+    uint8_t a4[]  = { 0xfe, 0xed, 0xfa, 0xce, 0xde, 0xad, 0xbe, 0xef, 0xfe, 0xed, 0xfa, 0xce, 0xde, 0xad, 0xbe, 0xef,
+                      0xab, 0xad, 0xda, 0xd2 };
+    uint8_t p4[]  = { 0xd9, 0x31, 0x32, 0x25, 0xf8, 0x84, 0x06, 0xe5, 0xa5, 0x59, 0x09, 0xc5, 0xaf, 0xf5, 0x26, 0x9a,
+                      0x86, 0xa7, 0xa9, 0x53, 0x15, 0x34, 0xf7, 0xda, 0x2e, 0x4c, 0x30, 0x3d, 0x8a, 0x31, 0x8a, 0x72,
+                      0x1c, 0x3c, 0x0c, 0x95, 0x95, 0x68, 0x09, 0x53, 0x2f, 0xcf, 0x0e, 0x24, 0x49, 0xa6, 0xb5, 0x25,
+                      0xb1, 0x6a, 0xed, 0xf5, 0xaa, 0x0d, 0xe6, 0x57, 0xba, 0x63, 0x7b, 0x39 };
+    uint8_t c4[]  = { 0x42, 0x83, 0x1e, 0xc2, 0x21, 0x77, 0x74, 0x24, 0x4b, 0x72, 0x21, 0xb7, 0x84, 0xd0, 0xd4, 0x9c,
+                      0xe3, 0xaa, 0x21, 0x2f, 0x2c, 0x02, 0xa4, 0xe0, 0x35, 0xc1, 0x7e, 0x23, 0x29, 0xac, 0xa1, 0x2e,
+                      0x21, 0xd5, 0x14, 0xb2, 0x54, 0x66, 0x93, 0x1c, 0x7d, 0x8f, 0x6a, 0x5a, 0xac, 0x84, 0xaa, 0x05,
+                      0x1b, 0xa3, 0x0b, 0x39, 0x6a, 0x0a, 0xac, 0x97, 0x3d, 0x58, 0xe0, 0x91 };
+    uint8_t t4[]  = { 0x5b, 0xc9, 0x4f, 0xbc, 0x32, 0x21, 0xa5, 0xdb, 0x94, 0xfa, 0xe9, 0x5a, 0xe7, 0x12, 0x1a, 0x47 };
+    uint8_t c5[]  = { 0x61, 0x35, 0x3b, 0x4c, 0x28, 0x06, 0x93, 0x4a, 0x77, 0x7f, 0xf5, 0x1f, 0xa2, 0x2a, 0x47, 0x55,
+                      0x69, 0x9b, 0x2a, 0x71, 0x4f, 0xcd, 0xc6, 0xf8, 0x37, 0x66, 0xe5, 0xf9, 0x7b, 0x6c, 0x74, 0x23,
+                      0x73, 0x80, 0x69, 0x00, 0xe4, 0x9f, 0x24, 0xb2, 0x2b, 0x09, 0x75, 0x44, 0xd4, 0x89, 0x6b, 0x42,
+                      0x49, 0x89, 0xb5, 0xe1, 0xeb, 0xac, 0x0f, 0x07, 0xc2, 0x3f, 0x45, 0x98 };
+    uint8_t t5[]  = { 0x36, 0x12, 0xd2, 0xe7, 0x9e, 0x3b, 0x07, 0x85, 0x56, 0x1b, 0xe1, 0x4a, 0xac, 0xa2, 0xfc, 0xcb };
+
+    AES_init_ctx(&ctx, k4);
+    memcpy(stitched, p4, sizeof(p4));
+    AES_GCM_encrypt(&ctx, iv4, sizeof(iv4), a4, sizeof(a4), stitched, sizeof(p4), tag);
+    ok &= (0 == memcmp(stitched, c4, sizeof(c4))) && (0 == memcmp(tag, t4, sizeof(t4)));
+    ok &= (0 == AES_GCM_decrypt(&ctx, iv4, sizeof(iv4), a4, sizeof(a4), stitched, sizeof(p4), tag));
+    ok &= (0 == memcmp(stitched, p4, sizeof(p4)));
+
+    // 8-byte IV
+    memcpy(stitched, p4, sizeof(p4));
+    AES_GCM_encrypt(&ctx, iv4, 8, a4, sizeof(a4), stitched, sizeof(p4), tag);
+    ok &= (0 == memcmp(stitched, c5, sizeof(c5))) && (0 == memcmp(tag, t5, sizeof(t5)));
+#endif
+
+    for (i = 0; i < AES_KEYLEN; ++i)
+    {
+        key[i] = (uint8_t)(i * 11 + 2);
+    }
+    for (i = 0; i < sizeof(iv); ++i)
+    {
+        iv[i] = (uint8_t)(i * 7 + 3);
+    }
+    for (i = 0; i < sizeof(aad); ++i)
+    {
+        aad[i] = (uint8_t)(0x80 + i);
+    }
+    for (i = 0; i < LENGTH; ++i)
+    {
+        plain[i] = stitched[i] = portable[i] = (uint8_t)(i * 13 + 1);
+    }
+    AES_init_ctx(&ctx, key);
+
+    // The default kernels and the portable GHASH agree
+    AES_GCM_encrypt(&ctx, iv, sizeof(iv), aad, sizeof(aad), stitched, LENGTH, tag);
+    ok &= (0 == AES_backend_select(AES_PRIMITIVE_GHASH, "portable"));
+    AES_GCM_encrypt(&ctx, iv, sizeof(iv), aad, sizeof(aad), portable, LENGTH, tag2);
+    ok &= (0 == AES_backend_select(AES_PRIMITIVE_GHASH, NULL));
+    ok &= (0 == memcmp(stitched, portable, LENGTH)) && (0 == memcmp(tag, tag2, sizeof(tag)));
+
+    // So does the portable block kernel, which also takes GCM off the stitched path
+    memcpy(portable, plain, LENGTH);
+    ok &= (0 == AES_backend_select(AES_PRIMITIVE_BLOCK, "portable"));
+    AES_GCM_encrypt(&ctx, iv, sizeof(iv), aad, sizeof(aad), portable, LENGTH, tag2);
+    ok &= (0 == AES_backend_select(AES_PRIMITIVE_BLOCK, NULL));
+    ok &= (0 == memcmp(stitched, portable, LENGTH)) && (0 == memcmp(tag, tag2, sizeof(tag)));
+
+    ok &= (0 == AES_GCM_decrypt(&ctx, iv, sizeof(iv), aad, sizeof(aad), stitched, LENGTH, tag));
+    ok &= (0 == memcmp(stitched, plain, LENGTH));
+
+    // A wrong tag is rejected and the output wiped
+    tag2[0] ^= 1;
+    ok &= (-1 == AES_GCM_decrypt(&ctx, iv, sizeof(iv), aad, sizeof(aad), portable, LENGTH, tag2));
+    for (i = 0; i < LENGTH; ++i)
+    {
+        ok &= (portable[i] == 0);
+    }
+
+    // The 32-bit counter wraps in the first tile. For a 16-byte IV
+    // J0 = IV * H^2 + [len(IV)] * H, so IV = (J0 + [len(IV)] * H) * H^-2 gives
+    // a J0 ending in ff ff ff fc, and the counter blocks run fffffffd, fffffffe,
+    // ffffffff, 00000000, ... without carrying into the IV part.
+    {
+        uint8_t H[AES_BLOCKLEN] = { 0 }, H2[AES_BLOCKLEN], inv[AES_BLOCKLEN] = { 0x80 };
+        uint8_t J0[AES_BLOCKLEN], L[AES_BLOCKLEN] = { 0 }, iv16[AES_BLOCKLEN];
+        uint8_t counter[AES_BLOCKLEN], block[AES_BLOCKLEN];
+
+        AES_block_encrypt(&ctx, H);
+        gf_mul(H2, H, H);
+        // H^-2 = (H^2)^(2^128 - 2): 127 one bits, then a zero
+        for (i = 0; i < 127; ++i)
+        {
+            gf_mul(inv, inv, inv);
+            gf_mul(inv, inv, H2);
+        }
+        gf_mul(inv, inv, inv);
+
+        for (i = 0; i < AES_BLOCKLEN; ++i)
+        {
+            J0[i] = (i < 12) ? (uint8_t)(0xa0 + i) : 0xff;
+        }
+        J0[AES_BLOCKLEN - 1] = 0xfc;
+        L[AES_BLOCKLEN - 1] = 8 * AES_BLOCKLEN;
+        gf_mul(L, L, H);
+        for (i = 0; i < AES_BLOCKLEN; ++i)
+        {
+            L[i] ^= J0[i];
+        }
+        gf_mul(iv16, L, inv);
+
+        for (i = 0; i < LENGTH; ++i)
+        {
+            stitched[i] = portable[i] = plain[i];
+        }
+        AES_GCM_encrypt(&ctx, iv16, sizeof(iv16), aad, sizeof(aad), stitched, LENGTH, tag);
+        ok &= (0 == AES_backend_select(AES_PRIMITIVE_GHASH, "portable"));
+        AES_GCM_encrypt(&ctx, iv16, sizeof(iv16), aad, sizeof(aad), portable, LENGTH, tag2);
+        ok &= (0 == AES_backend_select(AES_PRIMITIVE_GHASH, NULL));
+        ok &= (0 == memcmp(stitched, portable, LENGTH)) && (0 == memcmp(tag, tag2, sizeof(tag)));
+
+        // Against inc32 one block at a time
+        memcpy(counter, J0, AES_BLOCKLEN);
+        for (i = 0; i < LENGTH; ++i)
+        {
+            if (i % AES_BLOCKLEN == 0)
+            {
+                size_t bi;
+                for (bi = AES_BLOCKLEN - 1; bi >= AES_BLOCKLEN - 4 && ++counter[bi] == 0; --bi)
+                {
+                }
+                memcpy(block, counter, AES_BLOCKLEN);
+                AES_block_encrypt(&ctx, block);
+            }
+            ok &= (stitched[i] == (plain[i] ^ block[i % AES_BLOCKLEN]));
+        }
+        ok &= (0 == AES_GCM_decrypt(&ctx, iv16, sizeof(iv16), aad, sizeof(aad), stitched, LENGTH, tag));
+        ok &= (0 == memcmp(stitched, plain, LENGTH));
+    }
+
+    printf("AES-GCM: ");
+
+    if (ok) {
+        printf("SUCCESS!\n");
+	return(0);
+    } else {
+        printf("FAILURE!\n");
+	return(1);
+    }
+}
+
+static int test_stream(void)
+{
+    enum { CHUNK = 40, LENGTH = 3 * CHUNK + 9 };
+    uint8_t key[AES_KEYLEN], prefix[AES_STREAM_PREFIXLEN], header[5] = { 'h', 'e', 'a', 'd', 0 };
+    uint8_t plain[LENGTH], sealed[LENGTH + 4 * AES_GCM_TAGLEN], opened[LENGTH + 4 * AES_GCM_TAGLEN];
+    uint8_t* chunk;
+    struct AES_stream stream;
+    size_t i, sealed_length;
+    int ok = 1;
+
+    for (i = 0; i < AES_KEYLEN; ++i)
+    {
+        key[i] = (uint8_t)(0x33 * i);
+    }
+    for (i = 0; i < AES_STREAM_PREFIXLEN; ++i)
+    {
+        prefix[i] = (uint8_t)(i + 100);
+    }
+    for (i = 0; i < LENGTH; ++i)
+    {
+        plain[i] = (uint8_t)(i * 3);
+    }
+    AES_stream_init(&stream, key, prefix, CHUNK);
+
+    sealed_length = AES_stream_sealed_length(&stream, LENGTH);
+    ok &= (AES_stream_chunks(&stream, LENGTH) == 4) && (sealed_length == sizeof(sealed));
+    ok &= (AES_stream_plain_length(&stream, sealed_length) == LENGTH);
+    ok &= (AES_stream_chunks(&stream, 0) == 1) && (AES_stream_plain_length(&stream, AES_GCM_TAGLEN) == 0);
+    ok &= (AES_stream_plain_length(&stream, CHUNK + 2 * AES_GCM_TAGLEN) == (size_t)-1);
+
+    // The whole object, and back
+    ok &= (0 == AES_stream_seal(&stream, header, sizeof(header), plain, LENGTH, sealed));
+    ok &= (0 == AES_stream_open(&stream, header, sizeof(header), sealed, sealed_length, opened));
+    ok &= (0 == memcmp(opened, plain, LENGTH));
+
+    // Chunk 2 on its own: ciphertext and tag at 2 * (CHUNK + tag)
+    chunk = sealed + 2 * (CHUNK + AES_GCM_TAGLEN);
+    memcpy(opened, chunk, CHUNK);
+    ok &= (0 == AES_stream_open_chunk(&stream, 2, 0, header, sizeof(header), opened, CHUNK, chunk + CHUNK));
+    ok &= (0 == memcmp(opened, plain + 2 * CHUNK, CHUNK));
+
+    // Nor as another index, nor as the last chunk
+    memcpy(opened, chunk, CHUNK);
+    ok &= (-1 == AES_stream_open_chunk(&stream, 1, 0, header, sizeof(header), opened, CHUNK, chunk + CHUNK));
+    memcpy(opened, chunk, CHUNK);
+    ok &= (-1 == AES_stream_open_chunk(&stream, 2, 1, header, sizeof(header), opened, CHUNK, chunk + CHUNK));
+
+    // A truncated object fails: its new last chunk was not sealed as last
+    ok &= (1 == AES_stream_open(&stream, header, sizeof(header), sealed, 3 * (CHUNK + AES_GCM_TAGLEN), opened));
+
+    // A damaged chunk fails alone; the others still open
+    sealed[CHUNK + AES_GCM_TAGLEN + 3] ^= 0x20;
+    ok &= (1 == AES_stream_open(&stream, header, sizeof(header), sealed, sealed_length, opened));
+    ok &= (0 == memcmp(opened, plain, CHUNK)) && (0 == memcmp(opened + 2 * CHUNK, plain + 2 * CHUNK, LENGTH - 2 * CHUNK));
+    for (i = CHUNK; i < 2 * CHUNK; ++i)
+    {
+        ok &= (opened[i] == 0);
+    }
+
+    // In place
+    memcpy(sealed, plain, LENGTH);
+    ok &= (0 == AES_stream_seal(&stream, NULL, 0, sealed, LENGTH, sealed));
+    ok &= (0 == AES_stream_open(&stream, NULL, 0, sealed, sealed_length, sealed));
+    ok &= (0 == memcmp(sealed, plain, LENGTH));
+
+    printf("Chunked AEAD stream: ");
+
+    if (ok) {
+        printf("SUCCESS!\n");
+	return(0);
+    } else {
+        printf("FAILURE!\n");
+	return(1);
+    }
+}
+
+static int test_mac_tree(void)
+{
+    // 14 leaves, the last one short: the tree has carried nodes
+    enum { CHUNK = 32, LENGTH = 13 * CHUNK + 5, LEAVES = 14 };
+    uint8_t key[AES_KEYLEN], data[LENGTH], tag[AES_MAC_LEN], tag2[AES_MAC_LEN];
+    uint8_t nodes[2 * LEAVES * AES_MAC_LEN], nodes2[2 * LEAVES * AES_MAC_LEN];
+    uint8_t proof[16 * AES_MAC_LEN];
+    struct AES_mac_tree tree, reader;
+    size_t i, first, count, n;
+    int leaf, ok = 1;
+
+#if (AES_KEYLEN == 16)
+    // RFC 4493 examples 1, 2 and 4
+    uint8_t k[] = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c };
+    uint8_t m[] = { 0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+                    0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+                    0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+                    0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10 };
+    uint8_t t0[] = { 0xbb, 0x1d, 0x69, 0x29, 0xe9, 0x59, 0x37, 0x28, 0x7f, 0xa3, 0x7d, 0x12, 0x9b, 0x75, 0x67, 0x46 };
+    uint8_t t16[] = { 0x07, 0x0a, 0x16, 0xb4, 0x6b, 0x4d, 0x41, 0x44, 0xf7, 0x9b, 0xdd, 0x9d, 0xd0, 0x4a, 0x28, 0x7c };
+    uint8_t t64[] = { 0x51, 0xf0, 0xbe, 0xbf, 0x7e, 0x3b, 0x9d, 0x92, 0xfc, 0x49, 0x74, 0x17, 0x79, 0x36, 0x3c, 0xfe };
+    struct AES_ctx ctx;
+
+    AES_init_ctx(&ctx, k);
+    AES_CMAC(&ctx, m, 0, tag);
+    ok &= (0 == memcmp(tag, t0, sizeof(t0)));
+    AES_CMAC(&ctx, m, 16, tag);
+    ok &= (0 == memcmp(tag, t16, sizeof(t16)));
+    AES_CMAC(&ctx, m, 64, tag);
+    ok &= (0 == memcmp(tag, t64, sizeof(t64)));
+#endif
+
+    for (i = 0; i < AES_KEYLEN; ++i)
+    {
+        key[i] = (uint8_t)(i ^ 0x5a);
+    }
+    for (i = 0; i < LENGTH; ++i)
+    {
+        data[i] = (uint8_t)(i * 7);
+    }
+    ok &= (AES_mac_tree_size(CHUNK, LENGTH) <= sizeof(nodes));
+
+    for (leaf = AES_MAC_LEAF_CMAC; leaf <= AES_MAC_LEAF_GMAC; ++leaf)
+    {
+        AES_mac_tree_init(&tree, key, (enum AES_mac_leaf)leaf, CHUNK, LENGTH, nodes);
+        AES_mac_tree_build(&tree, data, tag);
+        ok &= (tree.leaves == LEAVES) && (AES_mac_tree_proof_max(&tree) <= sizeof(proof) / AES_MAC_LEN);
+
+        // Leaves in two ranges, as threads would do them
+        AES_mac_tree_init(&tree, key, (enum AES_mac_leaf)leaf, CHUNK, LENGTH, nodes2);
+        AES_mac_tree_leaves(&tree, data + 5 * CHUNK, 5, LEAVES - 5);
+        AES_mac_tree_leaves(&tree, data, 0, 5);
+        AES_mac_tree_finish(&tree, tag2);
+        ok &= (0 == memcmp(tag, tag2, AES_MAC_LEN));
+
+        // Every range checks with its proof alone
+        AES_mac_tree_init(&reader, key, (enum AES_mac_leaf)leaf, CHUNK, LENGTH, NULL);
+        for (first = 0; first < LEAVES; ++first)
+        {
+            for (count = 1; first + count <= LEAVES; ++count)
+            {
+                n = AES_mac_tree_proof(&tree, first, count, proof);
+                ok &= (n <= AES_mac_tree_proof_max(&tree));
+                ok &= (0 == AES_mac_tree_verify(&reader, tag, first, count, data + first * CHUNK, proof, n));
+            }
+        }
+
+        // Damaged data, a damaged proof node or a short proof fail
+        n = AES_mac_tree_proof(&tree, 6, 3, proof);
+        data[7 * CHUNK] ^= 1;
+        ok &= (-1 == AES_mac_tree_verify(&reader, tag, 6, 3, data + 6 * CHUNK, proof, n));
+        data[7 * CHUNK] ^= 1;
+        proof[0] ^= 1;
+        ok &= (-1 == AES_mac_tree_verify(&reader, tag, 6, 3, data + 6 * CHUNK, proof, n));
+        proof[0] ^= 1;
+        ok &= (-1 == AES_mac_tree_verify(&reader, tag, 6, 3, data + 6 * CHUNK, proof, n - 1));
+        ok &= (0 == AES_mac_tree_verify(&reader, tag, 6, 3, data + 6 * CHUNK, proof, n));
+    }
+
+    printf("Merkle-tree MAC: ");
+
+    if (ok) {
+        printf("SUCCESS!\n");
+	return(0);
+    } else {
+        printf("FAILURE!\n");
+	return(1);
+    }
+}
+
+static int test_key_wrap(void)
+{
+    // More keys than a tile, so the batch takes several
+    enum { KEYS = AES_KW_TILE_KEYS + 3, KEYLEN = 24, PADLEN = 13 };
+    uint8_t kek_key[AES_KEYLEN], keys[KEYS * KEYLEN], one[KEYLEN + AES_KW_SEMIBLOCK];
+    uint8_t wrapped[KEYS * (KEYLEN + AES_KW_SEMIBLOCK)], unwrapped[KEYS * KEYLEN];
+    size_t lengths[KEYS];
+    struct AES_ctx kek;
+    size_t i, k;
+    int ok = 1;
+
+#if (AES_KEYLEN == 16)
+    // RFC 3394 4.1
+    uint8_t k1[] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f };
+    uint8_t p1[] = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff };
+    uint8_t c1[] = { 0x1f, 0xa6, 0x8b, 0x0a, 0x81, 0x12, 0xb4, 0x47, 0xae, 0xf3, 0x4b, 0xd8, 0xfb, 0x5a, 0x7b, 0x82,
+                     0x9d, 0x3e, 0x86, 0x23, 0x71, 0xd2, 0xcf, 0xe5 };
+    AES_init_ctx(&kek, k1);
+    ok &= (0 == AES_KW_wrap(&kek, p1, sizeof(p1), one)) && (0 == memcmp(one, c1, sizeof(c1)));
+#elif (AES_KEYLEN == 24)
+    // RFC 5649 section 6
+    uint8_t k2[] = { 0x58, 0x40, 0xdf, 0x6e, 0x29, 0xb0, 0x2a, 0xf1, 0xab, 0x49, 0x3b, 0x70,
+                     0x5b, 0xf1, 0x6e, 0xa1, 0xae, 0x83, 0x38, 0xf4, 0xdc, 0xc1, 0x76, 0xa8 };
+    uint8_t p20[] = { 0xc3, 0x7b, 0x7e, 0x64, 0x92, 0x58, 0x43, 0x40, 0xbe, 0xd1, 0x22, 0x07, 0x80, 0x89, 0x41, 0x15,
+                      0x50, 0x68, 0xf7, 0x38 };
+    uint8_t c20[] = { 0x13, 0x8b, 0xde, 0xaa, 0x9b, 0x8f, 0xa7, 0xfc, 0x61, 0xf9, 0x77, 0x42, 0xe7, 0x22, 0x48, 0xee,
+                      0x5a, 0xe6, 0xae, 0x53, 0x60, 0xd1, 0xae, 0x6a, 0x5f, 0x54, 0xf3, 0x73, 0xfa, 0x54, 0x3b, 0x6a };
+    uint8_t p7[] = { 0x46, 0x6f, 0x72, 0x50, 0x61, 0x73, 0x69 };
+    uint8_t c7[] = { 0xaf, 0xbe, 0xb0, 0xf0, 0x7d, 0xfb, 0xf5, 0x41, 0x92, 0x00, 0xf2, 0xcc, 0xb5, 0x0b, 0xb2, 0x4f };
+    uint8_t w20[sizeof(c20)];
+    AES_init_ctx(&kek, k2);
+    ok &= (0 == AES_KWP_wrap(&kek, p20, sizeof(p20), w20)) && (0 == memcmp(w20, c20, sizeof(c20)));
+    ok &= (0 == AES_KWP_wrap(&kek, p7, sizeof(p7), one)) && (0 == memcmp(one, c7, sizeof(c7)));
+#endif
+
+    for (i = 0; i < AES_KEYLEN; ++i)
+    {
+        kek_key[i] = (uint8_t)(0xc0 + i);
+    }
+    for (i = 0; i < sizeof(keys); ++i)
+    {
+        keys[i] = (uint8_t)(i * 29 + 7);
+    }
+    AES_init_ctx(&kek, kek_key);
+
+    ok &= (-1 == AES_KW_wrap(&kek, keys, 8, one)) && (-1 == AES_KW_wrap(&kek, keys, 20, one));
+
+    // A batch wraps every key as the single-key call does
+    ok &= (0 == AES_KW_wrap_batch(&kek, keys, KEYLEN, KEYS, wrapped));
+    for (k = 0; k < KEYS; ++k)
+    {
+        AES_KW_wrap(&kek, keys + k * KEYLEN, KEYLEN, one);
+        ok &= (0 == memcmp(one, wrapped + k * (KEYLEN + AES_KW_SEMIBLOCK), KEYLEN + AES_KW_SEMIBLOCK));
+    }
+
+#if (defined(CBC) && (CBC == 1)) || (defined(ECB) && (ECB == 1))
+    ok &= (0 == AES_KW_unwrap_batch(&kek, wrapped, KEYLEN + AES_KW_SEMIBLOCK, KEYS, unwrapped));
+    ok &= (0 == memcmp(unwrapped, keys, sizeof(keys)));
+
+    // One damaged key fails alone and is wiped
+    wrapped[3 * (KEYLEN + AES_KW_SEMIBLOCK) + 5] ^= 0x10;
+    ok &= (1 == AES_KW_unwrap_batch(&kek, wrapped, KEYLEN + AES_KW_SEMIBLOCK, KEYS, unwrapped));
+    ok &= (0 == memcmp(unwrapped, keys, 3 * KEYLEN));
+    ok &= (0 == memcmp(unwrapped + 4 * KEYLEN, keys + 4 * KEYLEN, (KEYS - 4) * KEYLEN));
+    for (i = 3 * KEYLEN; i < 4 * KEYLEN; ++i)
+    {
+        ok &= (unwrapped[i] == 0);
+    }
+
+    // KWP, padded and as a single block
+    ok &= (AES_KWP_wrapped_length(PADLEN) == 24) && (AES_KWP_wrapped_length(5) == 16);
+    ok &= (0 == AES_KWP_wrap_batch(&kek, keys, PADLEN, KEYS, wrapped));
+    ok &= (0 == AES_KWP_unwrap_batch(&kek, wrapped, 24, KEYS, unwrapped, lengths));
+    for (k = 0; k < KEYS; ++k)
+    {
+        ok &= (lengths[k] == PADLEN) && (0 == memcmp(unwrapped + k * 16, keys + k * PADLEN, PADLEN));
+    }
+    ok &= (0 == AES_KWP_wrap_batch(&kek, keys, 5, KEYS, wrapped));
+    ok &= (0 == AES_KWP_unwrap_batch(&kek, wrapped, 16, KEYS, unwrapped, lengths));
+    for (k = 0; k < KEYS; ++k)
+    {
+        ok &= (lengths[k] == 5) && (0 == memcmp(unwrapped + k * 8, keys + k * 5, 5));
+    }
+
+    // A KW key does not unwrap as KWP
+    AES_KW_wrap(&kek, keys, 16, one);
+    ok &= (-1 == AES_KWP_unwrap(&kek, one, 24, unwrapped, lengths));
+#endif
+
+    printf("AES key wrap: ");
+
+    if (ok) {
+        printf("SUCCESS!\n");
+	return(0);
+    } else {
+        printf("FAILURE!\n");
+	return(1);
+    }
+}
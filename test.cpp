@@ -1,2 +1,639 @@
 #include "aes.hpp"
+
+// Run the C test suite through the C++ header, then the template API on top
+#define main test_c_main
 #include "test.c"
+#undef main
+
+#include <array>
+#include <coroutine>
+#include <future>
+#include <memory_resource>
+#include <cstddef>
+#include <span>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static int test_cpp_fips197(void);
+static int test_cpp_modes(void);
+static int test_cpp_ranges(void);
+static int test_cpp_constexpr(void);
+static int test_cpp_streams(void);
+static int test_cpp_coroutines(void);
+static int test_cpp_parallel_stl(void);
+static int test_cpp_view(void);
+static int test_cpp_pmr(void);
+static int test_cpp_unique(void);
+
+
+int main(void)
+{
+    int exit = test_c_main();
+    if (exit != 0)
+    {
+        return exit;
+    }
+
+    printf("\nTesting C++ templates\n\n");
+    return test_cpp_fips197() + test_cpp_modes() + test_cpp_ranges() + test_cpp_constexpr() + test_cpp_streams() + test_cpp_coroutines() + test_cpp_parallel_stl() + test_cpp_view() + test_cpp_pmr() + test_cpp_unique();
+}
+
+
+// FIPS-197 appendix C: one plaintext, the three key sizes in one program
+static int test_cpp_fips197(void)
+{
+    static const uint8_t key[32] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+                                     0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f };
+    static const uint8_t pt[16]  = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff };
+    static const uint8_t ct128[16] = { 0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a };
+    static const uint8_t ct192[16] = { 0xdd, 0xa9, 0x7c, 0xa4, 0x86, 0x4c, 0xdf, 0xe0, 0x6e, 0xaf, 0x70, 0xa0, 0xec, 0x0d, 0x71, 0x91 };
+    static const uint8_t ct256[16] = { 0x8e, 0xa2, 0xb7, 0xca, 0x51, 0x67, 0x45, 0xbf, 0xea, 0xfc, 0x49, 0x90, 0x4b, 0x49, 0x60, 0x89 };
+
+    const tiny_aes::Aes128 aes128(key);
+    const tiny_aes::Aes192 aes192(key);
+    const tiny_aes::Aes256 aes256(key);
+    const uint8_t* expected[3] = { ct128, ct192, ct256 };
+    uint8_t block[3][16];
+    int fail = 0;
+    int i;
+
+    for (i = 0; i < 3; ++i)
+    {
+        memcpy(block[i], pt, 16);
+    }
+    aes128.encrypt_block(block[0]);
+    aes192.encrypt_block(block[1]);
+    aes256.encrypt_block(block[2]);
+    for (i = 0; i < 3; ++i)
+    {
+        fail |= (0 != memcmp(block[i], expected[i], 16));
+    }
+
+    aes128.decrypt_block(block[0]);
+    aes192.decrypt_block(block[1]);
+    aes256.decrypt_block(block[2]);
+    for (i = 0; i < 3; ++i)
+    {
+        fail |= (0 != memcmp(block[i], pt, 16));
+    }
+
+    printf("C++ FIPS-197: %s\n", fail ? "FAILURE!" : "SUCCESS!");
+    return fail;
+}
+
+// The templates against the C API, for the key size the C library was built with
+static int test_cpp_modes(void)
+{
+#if defined(AES256)
+    using Bits = std::integral_constant<unsigned, 256>;
+#elif defined(AES192)
+    using Bits = std::integral_constant<unsigned, 192>;
+#else
+    using Bits = std::integral_constant<unsigned, 128>;
+#endif
+    enum { length = 16 * 21 + 7 };
+    uint8_t key[32], iv[16];
+    std::vector<uint8_t> plain(length), c_out, cpp_out;
+    struct AES_ctx ctx;
+    size_t i;
+    int fail = 0;
+
+    for (i = 0; i < sizeof(key); ++i) key[i] = (uint8_t)(i * 7 + 1);
+    for (i = 0; i < sizeof(iv); ++i)  iv[i] = (uint8_t)(0xf0 + i);
+    for (i = 0; i < length; ++i)      plain[i] = (uint8_t)(i * 13);
+
+    // CTR: one call, and the same message split at odd byte offsets
+    c_out = plain;
+    AES_init_ctx_iv(&ctx, key, iv);
+    AES_CTR_xcrypt_buffer(&ctx, c_out.data(), length);
+    {
+        tiny_aes::Ctr<Bits::value> ctr(key, iv);
+        cpp_out = plain;
+        ctr.xcrypt(cpp_out.data(), length);
+        fail |= (cpp_out != c_out) || (0 != memcmp(ctr.iv(), ctx.Iv, 16));
+
+        static const size_t cuts[] = { 0, 3, 19, 20, 64, 150, 151, length };
+        ctr.set_iv(iv);
+        cpp_out = plain;
+        for (i = 0; i + 1 < sizeof(cuts) / sizeof(cuts[0]); ++i)
+        {
+            ctr.xcrypt(cpp_out.data() + cuts[i], cuts[i + 1] - cuts[i]);
+        }
+        fail |= (cpp_out != c_out);
+    }
+
+    // CBC and ECB on the whole blocks
+    const size_t blocks_len = length & ~(size_t)15;
+    c_out.assign(plain.begin(), plain.begin() + blocks_len);
+    AES_init_ctx_iv(&ctx, key, iv);
+    AES_CBC_encrypt_buffer(&ctx, c_out.data(), blocks_len);
+    {
+        tiny_aes::Cbc<Bits::value> cbc(key, iv);
+        cpp_out.assign(plain.begin(), plain.begin() + blocks_len);
+        cbc.encrypt(cpp_out.data(), blocks_len);
+        fail |= (cpp_out != c_out);
+
+        cbc.set_iv(iv);
+        cbc.decrypt(cpp_out.data(), blocks_len);
+        fail |= (0 != memcmp(cpp_out.data(), plain.data(), blocks_len));
+    }
+
+    c_out.assign(plain.begin(), plain.begin() + blocks_len);
+    AES_init_ctx(&ctx, key);
+    for (i = 0; i < blocks_len; i += 16)
+    {
+        AES_ECB_encrypt(&ctx, c_out.data() + i);
+    }
+    {
+        const tiny_aes::Ecb<Bits::value> ecb(key);
+        cpp_out.assign(plain.begin(), plain.begin() + blocks_len);
+        ecb.encrypt(cpp_out.data(), blocks_len);
+        fail |= (cpp_out != c_out);
+        fail |= (0 != memcmp(ecb.cipher().round_keys(), ctx.RoundKey, sizeof(ctx.RoundKey)));
+
+        ecb.decrypt(cpp_out.data(), blocks_len);
+        fail |= (0 != memcmp(cpp_out.data(), plain.data(), blocks_len));
+    }
+
+    printf("C++ modes: %s\n", fail ? "FAILURE!" : "SUCCESS!");
+    return fail;
+}
+
+// Range overloads: vectors, arrays of std::byte and spans, in and out of place
+static int test_cpp_ranges(void)
+{
+    enum { length = 16 * 9 + 5 };
+    uint8_t key[32], iv[16];
+    std::vector<uint8_t> plain(length), expected;
+    struct AES_ctx ctx;
+    size_t i;
+    int fail = 0;
+
+    for (i = 0; i < sizeof(key); ++i) key[i] = (uint8_t)(i + 0x40);
+    for (i = 0; i < sizeof(iv); ++i)  iv[i] = (uint8_t)(0xff - i);
+    for (i = 0; i < length; ++i)      plain[i] = (uint8_t)(i * 29 + 3);
+
+    expected = plain;
+    AES_init_ctx_iv(&ctx, key, iv);
+    AES_CTR_xcrypt_buffer(&ctx, expected.data(), length);
+
+    // C context: in place on a vector, out of place from a span into std::byte storage
+    {
+        std::vector<uint8_t> v = plain;
+        AES_init_ctx_iv(&ctx, key, iv);
+        tiny_aes::ctr_xcrypt(ctx, v);
+        fail |= (v != expected);
+
+        std::array<std::byte, length> out;
+        AES_init_ctx_iv(&ctx, key, iv);
+        size_t n = tiny_aes::ctr_xcrypt(ctx, std::span<const uint8_t>(plain), out);
+        fail |= (n != length) || (0 != memcmp(out.data(), expected.data(), length));
+
+        // A short output range bounds the call
+        std::vector<uint8_t> small(20);
+        AES_init_ctx_iv(&ctx, key, iv);
+        n = tiny_aes::ctr_xcrypt(ctx, plain, small);
+        fail |= (n != 20) || (0 != memcmp(small.data(), expected.data(), 20));
+    }
+
+    // Templates: out of place, then in place on a sub-span
+    {
+#if defined(AES256)
+        tiny_aes::Ctr<256> ctr(key, iv);
+#elif defined(AES192)
+        tiny_aes::Ctr<192> ctr(key, iv);
+#else
+        tiny_aes::Ctr<128> ctr(key, iv);
+#endif
+        std::vector<uint8_t> out(length);
+        fail |= (ctr.xcrypt(plain, out) != length) || (out != expected);
+
+        ctr.set_iv(iv);
+        out = plain;
+        std::span<uint8_t> all(out);
+        ctr.xcrypt(all.first(37));
+        ctr.xcrypt(all.subspan(37));
+        fail |= (out != expected);
+    }
+
+    printf("C++ ranges: %s\n", fail ? "FAILURE!" : "SUCCESS!");
+    return fail;
+}
+
+// Compile-time key expansion, block cipher and CTR
+static constexpr std::array<uint8_t, 16> constexpr_key = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c };
+static constexpr std::array<uint8_t, 16> constexpr_iv  = { 0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff };
+static constexpr std::array<uint8_t, 20> constexpr_plain = { 0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d,
+                                                             0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a, 0xae, 0x2d, 0x8a, 0x57 };
+
+static constexpr std::array<uint8_t, 16> constexpr_ecb(void)
+{
+    std::array<uint8_t, 16> block = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff };
+    const std::array<uint8_t, 32> key = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+                                          0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f };
+    tiny_aes::Aes256(key.data()).encrypt_block(block.data());
+    return block;
+}
+
+static int test_cpp_constexpr(void)
+{
+    // FIPS-197 C.3, evaluated by the compiler
+    constexpr std::array<uint8_t, 16> ecb = constexpr_ecb();
+    static_assert(ecb[0] == 0x8e && ecb[1] == 0xa2 && ecb[14] == 0x60 && ecb[15] == 0x89, "constexpr AES-256");
+
+    // NIST SP 800-38A F.5.1, first block and a partial second one
+    constexpr auto blob = tiny_aes::ctr_encrypt_constant(constexpr_key, constexpr_iv, constexpr_plain);
+    static_assert(blob[0] == 0x87 && blob[1] == 0x4d && blob[15] == 0xce && blob[16] == 0x98 && blob[19] == 0x6b, "constexpr CTR");
+
+    // The same bytes at run time
+    int fail = 0;
+    std::array<uint8_t, 20> runtime = constexpr_plain;
+    tiny_aes::Ctr128(constexpr_key.data(), constexpr_iv.data()).xcrypt(runtime.data(), runtime.size());
+    fail |= (runtime != blob);
+#if AES_KEYLEN == 16
+    struct AES_ctx ctx;
+    AES_init_ctx_iv(&ctx, constexpr_key.data(), constexpr_iv.data());
+    AES_CTR_xcrypt_buffer(&ctx, runtime.data(), runtime.size());
+    fail |= (runtime != constexpr_plain);
+#endif
+
+    printf("C++ constexpr: %s\n", fail ? "FAILURE!" : "SUCCESS!");
+    return fail;
+}
+
+// Streambuf filters: odd-sized writes and a flush mid-block, against one C call
+static int test_cpp_streams(void)
+{
+    enum { length = 16 * 40 + 9 };
+    uint8_t key[AES_KEYLEN], iv[16];
+    std::string plain(length, '\0'), expected;
+    struct AES_ctx ctx;
+    size_t i;
+    int fail = 0;
+
+    for (i = 0; i < sizeof(key); ++i) key[i] = (uint8_t)(i * 3);
+    for (i = 0; i < sizeof(iv); ++i)  iv[i] = (uint8_t)(i << 4);
+    for (i = 0; i < length; ++i)      plain[i] = (char)(i * 11);
+
+    expected = plain;
+    AES_init_ctx_iv(&ctx, key, iv);
+    AES_CTR_xcrypt_buffer(&ctx, (uint8_t*)&expected[0], length);
+
+    // A 100-byte buffer rounds up to 112, so data crosses several refills
+    std::ostringstream sink;
+    {
+        tiny_aes::EncryptingStreambuf<tiny_aes::CtrContext> buf(sink.rdbuf(), tiny_aes::CtrContext(key, iv), 100);
+        std::ostream out(&buf);
+        out.write(plain.data(), 5);
+        out << std::flush;
+        out.write(plain.data() + 5, 300);
+        out.put(plain[305]);
+        out.write(plain.data() + 306, length - 306);
+    }
+    fail |= (sink.str() != expected);
+
+    std::istringstream source(expected);
+    tiny_aes::DecryptingStreambuf<tiny_aes::CtrContext> buf(source.rdbuf(), tiny_aes::CtrContext(key, iv), 64);
+    std::istream in(&buf);
+    std::string decrypted(length, '\0');
+    in.read(&decrypted[0], 7);
+    in.read(&decrypted[7], length - 7);
+    fail |= (in.gcount() != length - 7) || (decrypted != plain) || (in.get() != EOF);
+
+    printf("C++ streams: %s\n", fail ? "FAILURE!" : "SUCCESS!");
+    return fail;
+}
+
+// The smallest coroutine type that runs to completion on its own
+struct detached
+{
+    struct promise_type
+    {
+        detached get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+static detached encrypt_file(tiny_aes::WorkerPool& pool, int in_fd, int out_fd, const uint8_t* key, const uint8_t* iv, std::promise<ssize_t>& done)
+{
+    tiny_aes::FdSource in(in_fd, pool);
+    tiny_aes::FdSink out(out_fd, pool);
+    tiny_aes::CtrContext ctr(key, iv);
+    std::vector<uint8_t> chunk(100);  // not a whole number of blocks
+    ssize_t total = 0;
+
+    for (ssize_t n; (n = co_await in.read(chunk)) > 0; )
+    {
+        std::span<uint8_t> data(chunk.data(), (size_t)n);
+        co_await tiny_aes::async_xcrypt(pool, ctr, data);
+        if (co_await out.write(data) != n)
+        {
+            total = -1;
+            break;
+        }
+        total += n;
+    }
+    done.set_value(total);
+}
+
+// A file encrypted chunk by chunk through the pool, against one C call
+static int test_cpp_coroutines(void)
+{
+    enum { length = 16 * 70 + 3 };
+    uint8_t key[AES_KEYLEN], iv[16];
+    std::vector<uint8_t> plain(length), expected, encrypted(length);
+    struct AES_ctx ctx;
+    size_t i;
+    int fail = 0;
+
+    for (i = 0; i < sizeof(key); ++i) key[i] = (uint8_t)(0x80 | i);
+    for (i = 0; i < sizeof(iv); ++i)  iv[i] = (uint8_t)(i * 17);
+    for (i = 0; i < length; ++i)      plain[i] = (uint8_t)(i * 5 + 1);
+
+    expected = plain;
+    AES_init_ctx_iv(&ctx, key, iv);
+    AES_CTR_xcrypt_buffer(&ctx, expected.data(), length);
+
+    FILE* in = tmpfile();
+    FILE* out = tmpfile();
+    if (in == NULL || out == NULL || fwrite(plain.data(), 1, length, in) != length || fflush(in) != 0)
+    {
+        printf("C++ coroutines: FAILURE!\n");
+        return 1;
+    }
+    rewind(in);
+
+    {
+        tiny_aes::WorkerPool pool(2);
+        std::promise<ssize_t> done;
+        std::future<ssize_t> result = done.get_future();
+        encrypt_file(pool, fileno(in), fileno(out), key, iv, done);
+        fail |= (result.get() != length);
+    }
+
+    rewind(out);
+    fail |= (fread(encrypted.data(), 1, length, out) != length) || (encrypted != expected);
+    fclose(in);
+    fclose(out);
+
+    printf("C++ coroutines: %s\n", fail ? "FAILURE!" : "SUCCESS!");
+    return fail;
+}
+
+// Parallel-algorithm overloads against the C functions, over several chunks
+// and a partial last block
+static int test_cpp_parallel_stl(void)
+{
+#if AES_HPP_PARALLEL_STL
+    const size_t length = 3 * AES_HPP_PARALLEL_STL_CHUNK * AES_BLOCKLEN + 21;
+    const size_t blocks_len = length & ~(size_t)15;
+    uint8_t key[AES_KEYLEN], iv[16];
+    std::vector<uint8_t> plain(length), expected, parallel;
+    struct AES_ctx c_ctx, p_ctx;
+    size_t i;
+    int fail = 0;
+
+    for (i = 0; i < sizeof(key); ++i) key[i] = (uint8_t)(i * 9);
+    // Low counter bytes near wrap-around, so chunk offsets carry
+    for (i = 0; i < sizeof(iv); ++i)  iv[i] = (uint8_t)((i < 13) ? i : 0xff - i);
+    for (i = 0; i < length; ++i)      plain[i] = (uint8_t)(i ^ (i >> 8));
+
+    expected = plain;
+    parallel = plain;
+    AES_init_ctx_iv(&c_ctx, key, iv);
+    AES_init_ctx_iv(&p_ctx, key, iv);
+    AES_CTR_xcrypt_buffer(&c_ctx, expected.data(), length);
+    tiny_aes::ctr_xcrypt(std::execution::par_unseq, p_ctx, parallel);
+    fail |= (parallel != expected) || (0 != memcmp(c_ctx.Iv, p_ctx.Iv, 16));
+
+    // CBC: encrypt with the C function, decrypt in parallel
+    expected.assign(plain.begin(), plain.begin() + blocks_len);
+    AES_init_ctx_iv(&c_ctx, key, iv);
+    AES_CBC_encrypt_buffer(&c_ctx, expected.data(), blocks_len);
+    parallel = expected;
+    AES_init_ctx_iv(&p_ctx, key, iv);
+    tiny_aes::cbc_decrypt(std::execution::par_unseq, p_ctx, parallel);
+    fail |= (0 != memcmp(parallel.data(), plain.data(), blocks_len)) || (0 != memcmp(c_ctx.Iv, p_ctx.Iv, 16));
+
+    expected.assign(plain.begin(), plain.begin() + blocks_len);
+    AES_init_ctx(&c_ctx, key);
+    for (i = 0; i < blocks_len; i += 16)
+    {
+        AES_ECB_encrypt(&c_ctx, expected.data() + i);
+    }
+    parallel.assign(plain.begin(), plain.begin() + blocks_len);
+    tiny_aes::ecb_encrypt(std::execution::par, c_ctx, parallel);
+    fail |= (parallel != expected);
+    tiny_aes::ecb_decrypt(std::execution::par_unseq, c_ctx, parallel);
+    fail |= (0 != memcmp(parallel.data(), plain.data(), blocks_len));
+
+    printf("C++ parallel algorithms: %s\n", fail ? "FAILURE!" : "SUCCESS!");
+    return fail;
+#else
+    return 0;
+#endif
+}
+
+// Lazy CTR view: sequential iteration, jumps and read() against a full decryption
+static int test_cpp_view(void)
+{
+    enum { length = 16 * 150 + 11 };
+    uint8_t key[16], iv[16];
+    std::vector<uint8_t> plain(length), ciphertext;
+    size_t i;
+    int fail = 0;
+
+    for (i = 0; i < sizeof(key); ++i) key[i] = (uint8_t)(i * 21);
+    for (i = 0; i < sizeof(iv); ++i)  iv[i] = (uint8_t)((i < 15) ? 0 : 0xfe);
+    for (i = 0; i < length; ++i)      plain[i] = (uint8_t)(i * 7 + (i >> 5));
+
+    ciphertext = plain;
+    tiny_aes::Ctr128(key, iv).xcrypt(ciphertext.data(), length);
+
+    const auto view = tiny_aes::ctr_view(tiny_aes::Aes128(key), iv, ciphertext);
+    static_assert(std::ranges::random_access_range<decltype(view)>);
+    static_assert(std::ranges::view<std::remove_const_t<decltype(view)>>);
+
+    fail |= (view.size() != length) || !std::ranges::equal(view, plain);
+
+    // Backwards, then random jumps across tiles
+    for (i = length; i-- > 0; )
+    {
+        fail |= (view[i] != plain[i]);
+    }
+    auto it = view.begin() + 2000;
+    fail |= (*it != plain[2000]) || (it[-1999] != plain[1]) || (*(it + 401) != plain[2401]);
+    fail |= (view.end() - view.begin() != length);
+
+    // A range starting mid-block
+    std::vector<uint8_t> part(300);
+    fail |= (view.read(1037, part) != 300) || (0 != memcmp(part.data(), plain.data() + 1037, 300));
+    fail |= (view.read(length - 5, part) != 5) || (view.read(length, part) != 0);
+
+    // Ctr::discard() lands on the same keystream position as processing the bytes
+    tiny_aes::Ctr128 ctr(key, iv);
+    ctr.discard(5);
+    ctr.discard(16 * 3 + 2);
+    std::vector<uint8_t> tail(ciphertext.begin() + 55, ciphertext.end());
+    ctr.xcrypt(tail.data(), tail.size());
+    fail |= (0 != memcmp(tail.data(), plain.data() + 55, tail.size()));
+
+    printf("C++ view: %s\n", fail ? "FAILURE!" : "SUCCESS!");
+    return fail;
+}
+
+// Counts what is allocated through it
+class counting_resource : public std::pmr::memory_resource
+{
+public:
+    explicit counting_resource(std::pmr::memory_resource* upstream) : upstream_(upstream) {}
+    size_t allocations = 0;
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override
+    {
+        ++allocations;
+        void* p = upstream_->allocate(bytes, alignment);
+        if (((uintptr_t)p % alignment) != 0)
+        {
+            misaligned = true;
+        }
+        return p;
+    }
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override { upstream_->deallocate(p, bytes, alignment); }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    std::pmr::memory_resource* upstream_;
+
+public:
+    bool misaligned = false;
+};
+
+// Streams and views allocate from a request arena only; the default resource
+// is switched to one that fails on any use while they run
+static int test_cpp_pmr(void)
+{
+    enum { length = 16 * 20 + 3 };
+    alignas(64) static uint8_t arena[16384];
+    std::pmr::monotonic_buffer_resource request(arena, sizeof(arena), std::pmr::null_memory_resource());
+    counting_resource counted(&request);
+    tiny_aes::allocator_type alloc(&counted);
+    std::pmr::memory_resource* previous = std::pmr::set_default_resource(std::pmr::null_memory_resource());
+
+    uint8_t key[16], iv[16];
+    std::string plain(length, '\0');
+    size_t i;
+    int fail = 0;
+
+    for (i = 0; i < sizeof(key); ++i) key[i] = (uint8_t)(i + 1);
+    for (i = 0; i < sizeof(iv); ++i)  iv[i] = (uint8_t)(i + 2);
+    for (i = 0; i < length; ++i)      plain[i] = (char)i;
+
+    std::string expected = plain;
+    tiny_aes::Ctr128(key, iv).xcrypt((uint8_t*)&expected[0], length);
+
+    try
+    {
+        std::string encrypted(length, '\0');
+        {
+            std::ostringstream sink;
+            tiny_aes::EncryptingStreambuf<tiny_aes::Ctr128> buf(sink.rdbuf(), tiny_aes::Ctr128(key, iv), 4096, alloc);
+            fail |= (buf.get_allocator().resource() != &counted);
+            std::ostream out(&buf);
+            out.write(plain.data(), length);
+            out.flush();
+            encrypted = sink.str();
+        }
+        fail |= (encrypted != expected);
+
+        // A pmr vector hands its resource to the views it holds
+        std::pmr::vector<tiny_aes::CtrView<128>> views(&counted);
+        views.push_back(tiny_aes::ctr_view(tiny_aes::Aes128(key), iv, encrypted, alloc));
+        fail |= (views[0].get_allocator().resource() != &counted);
+        fail |= !std::ranges::equal(views[0], std::span<const uint8_t>((const uint8_t*)plain.data(), length));
+    }
+    catch (const std::bad_alloc&)
+    {
+        fail = 1;
+    }
+
+    std::pmr::set_default_resource(previous);
+    fail |= (counted.allocations < 3) || counted.misaligned;
+
+    printf("C++ pmr: %s\n", fail ? "FAILURE!" : "SUCCESS!");
+    return fail;
+}
+
+// Move-only aligned owners and the lock-free pool behind them
+static int test_cpp_unique(void)
+{
+    static const uint8_t key[16] = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c };
+    int fail = 0;
+
+    tiny_aes::Pool<tiny_aes::Aes128> pool(2);
+    {
+        tiny_aes::UniqueAes<128> a(pool, key);
+        tiny_aes::UniqueAes<128> b(pool, key);
+        tiny_aes::UniqueAes<128> c(pool, key);  // pool is empty: heap
+        fail |= !a.pooled() || !b.pooled() || c.pooled() || (pool.available() != 0);
+        fail |= ((uintptr_t)a->round_keys() % 64 != 0) || ((uintptr_t)c->round_keys() % 64 != 0);
+
+        // Moving hands over the pointer; the object stays where it is
+        const tiny_aes::Aes128* where = a.get();
+        tiny_aes::UniqueAes<128> moved(std::move(a));
+        fail |= (moved.get() != where) || (bool)a;
+
+        uint8_t x[16] = { 0 }, y[16] = { 0 };
+        moved->encrypt_block(x);
+        tiny_aes::Aes128(key).encrypt_block(y);
+        fail |= (0 != memcmp(x, y, 16));
+
+        b = std::move(c);  // b's slot goes back to the pool
+        fail |= (pool.available() != 1) || b.pooled();
+    }
+    fail |= (pool.available() != 2);
+
+    // A C context and a CTR stream
+#if AES_KEYLEN == 16
+    static const uint8_t iv[16] = { 0 };
+    tiny_aes::UniqueContext ctx(std::in_place);
+    AES_init_ctx_iv(ctx.get(), key, iv);
+    fail |= ((uintptr_t)ctx->RoundKey % 64 != 0);
+    tiny_aes::UniqueCtr<128> ctr(std::in_place, key, iv);
+    uint8_t a1[37] = { 0 }, a2[37] = { 0 };
+    AES_CTR_xcrypt_buffer(ctx.get(), a1, sizeof(a1));
+    ctr->xcrypt(a2, sizeof(a2));
+    fail |= (0 != memcmp(a1, a2, sizeof(a1)));
+#endif
+
+    // Several threads taking and returning slots
+    tiny_aes::Pool<tiny_aes::Aes128> shared(8);
+    std::atomic<int> errors(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&shared, &errors] {
+            for (int i = 0; i < 20000; ++i)
+            {
+                tiny_aes::UniqueAes<128> k1(shared, key), k2(shared, key);
+                if (k1.get() == k2.get() || memcmp(k1->round_keys(), k2->round_keys(), tiny_aes::Aes128::schedule_size) != 0)
+                {
+                    ++errors;
+                }
+            }
+        });
+    }
+    for (std::thread& t : threads)
+    {
+        t.join();
+    }
+    fail |= (errors != 0) || (shared.available() != 8);
+
+    printf("C++ unique: %s\n", fail ? "FAILURE!" : "SUCCESS!");
+    return fail;
+}